@@ -3,6 +3,11 @@
 #include "DarkMark.hpp"
 
 
+static const auto fontface		= cv::FONT_HERSHEY_PLAIN;
+static const auto fontscale		= 1.0;
+static const auto fontthickness	= 1;
+
+
 dm::DMCanvas::DMCanvas(DMContent & c) :
 	CrosshairComponent(c),
 	content(c)
@@ -28,10 +33,6 @@ void dm::DMCanvas::rebuild_cache_image()
 {
 //	Log("redrawing layers...");
 
-	//						blue   green red
-	const cv::Scalar black	(0x00, 0x00, 0x00);
-	const cv::Scalar white	(0xff, 0xff, 0xff);
-
 	if (content.images_are_loading or content.original_image.empty())
 	{
 		// nothing we can do
@@ -46,31 +47,252 @@ void dm::DMCanvas::rebuild_cache_image()
 		);
 #endif
 
-	cv::Mat image_to_use;
+	if (content.user_specified_zoom_factor <= 0.0)
+	{
+		zoom_image_offset = cv::Point(0, 0);
+	}
+	else
+	{
+		// figure out what zoom offset we need to apply to the image
+
+		const int h = content.canvas.getHeight();
+		const int w = content.canvas.getWidth();
+		const cv::Size & scaled_image_size = content.scaled_image_size;
 
-	if (content.black_and_white_mode_enabled)
+#if 0
+		Log(std::string(__PRETTY_FUNCTION__) + ": need to find a RoI because we're zooming " + std::to_string(content.user_specified_zoom_factor) +
+			", original image measures " +
+			std::to_string(content.original_image.cols) +
+			" x " +
+			std::to_string(content.original_image.rows) +
+			", scaled image measures " +
+			std::to_string(scaled_image_size.width) +
+			" x " +
+			std::to_string(scaled_image_size.height) +
+			" canvas measures"
+			" w=" + std::to_string(w) +
+			" h=" + std::to_string(h)
+			);
+#endif
+
+		cv::Rect r(
+			content.user_specified_zoom_factor * content.zoom_point_of_interest.x - w / 2,
+			content.user_specified_zoom_factor * content.zoom_point_of_interest.y - h / 2,
+			w, h);
+
+		if (r.width < std::min(scaled_image_size.width, w))
+		{
+			// our rectangle can be made wider to include more of the image
+			const double delta = (std::min(scaled_image_size.width, w) - r.width) / 2.0;
+			r.x -= delta;
+			r.width += std::round(delta * 2.0);
+		}
+		if (r.height < std::min(scaled_image_size.height, h))
+		{
+			const double delta = (std::min(scaled_image_size.height, h) - r.height) / 2.0;
+			r.y -= delta;
+			r.height += std::round(delta * 2.0);
+		}
+		if (r.x > 0 and r.x < 100)
+		{
+			// near the left border...we may as well stick to the border
+			r.x = 0;
+		}
+		if (r.y > 0 and r.y < 100)
+		{
+			// near the top border...we may as well stick to the border
+			r.y = 0;
+		}
+		if (r.x < 0)
+		{
+			r.width -= r.x;
+			r.x = 0;
+		}
+		if (r.y < 0)
+		{
+			r.height -= r.y;
+			r.y = 0;
+		}
+
+		// we now have a rectangle that would fit the canvas -- but is the image large enough to accomodate this rectangle?
+
+		if (r.x + r.width > scaled_image_size.width)
+		{
+			r.x = std::max(0, scaled_image_size.width - r.width);
+			r.width = scaled_image_size.width - r.x;
+		}
+		if (r.y + r.height > scaled_image_size.height)
+		{
+			r.y = std::max(0, scaled_image_size.height - r.height);
+			r.height = scaled_image_size.height - r.y;
+		}
+
+#if 0
+		Log(std::string(__PRETTY_FUNCTION__) + ": zoom=" + std::to_string(content.user_specified_zoom_factor) +
+			" r.x=" + std::to_string(r.x) +
+			" r.y=" + std::to_string(r.y) +
+			" r.w=" + std::to_string(r.width) +
+			" r.h=" + std::to_string(r.height) +
+			" canvas.width=" + std::to_string(w) +
+			" canvas.height=" + std::to_string(h));
+#endif
+
+		// this next line is what tells the crosshair component what portion of the image we want to show on the screen
+		zoom_image_offset = r.tl();
+	}
+
+//	Log(std::string(__PRETTY_FUNCTION__) + ": zoom image offset: x=" + std::to_string(zoom_image_offset.x) + " y=" + std::to_string(zoom_image_offset.y));
+
+	// only the portion of the image which is visible in the canvas needs to be drawn
+	const cv::Rect roi = cv::Rect(zoom_image_offset, cv::Size(getWidth(), getHeight())) & cv::Rect(cv::Point(0, 0), content.scaled_image_size);
+	const cv::Rect image_rect(cv::Point(0, 0), roi.size());
+
+	// the base layer only needs to be resampled when the image, the zoom, or the visible region has changed
+	const cv::Mat & source = set_pyramid_image();
+	bool full_redraw = false;
+	if (base_image.empty() or source.data != base_source.data or roi != base_roi or content.scaled_image_size != base_scaled_image_size)
 	{
-		content.create_threshold_image();
+		base_image				= pyramid.render(content.scaled_image_size, roi);
+		base_source				= source;
+		base_roi				= roi;
+		base_scaled_image_size	= content.scaled_image_size;
+		full_redraw				= true;
+	}
+
+	std::vector<MarkLayout> layouts;
+	VStr status_text;
+	layout_marks(layouts, status_text);
 
-		image_to_use = content.black_and_white_image;
+	if (full_redraw or cached_image.isNull() or content.scaled_image.size() != base_image.size())
+	{
+		content.scaled_image = base_image.clone();
+		draw_layers(content.scaled_image, roi.tl(), layouts, status_text);
+		cached_image = convert_opencv_mat_to_juce_image(content.scaled_image);
 	}
 	else
 	{
-		image_to_use = content.original_image;
+		// find the marks which have changed since the last time the image was drawn
+		std::vector<cv::Rect> dirty_rects;
+		for (size_t idx = 0; idx < std::max(layouts.size(), drawn_layouts.size()); idx ++)
+		{
+			const MarkLayout * old_layout = (idx < drawn_layouts.size()	? &drawn_layouts[idx]	: nullptr);
+			const MarkLayout * new_layout = (idx < layouts.size()		? &layouts[idx]			: nullptr);
+
+			if (old_layout and new_layout and *old_layout == *new_layout)
+			{
+				continue;
+			}
+			if (old_layout)
+			{
+				dirty_rects.push_back(old_layout->footprint);
+			}
+			if (new_layout)
+			{
+				dirty_rects.push_back(new_layout->footprint);
+			}
+		}
+		if (status_text != drawn_status_text)
+		{
+			dirty_rects.push_back(get_status_text_rect(drawn_status_text));
+			dirty_rects.push_back(get_status_text_rect(status_text));
+		}
+
+		// only the pixels within the dirty rectangles are restored from the base layer and redrawn
+		for (auto & r : dirty_rects)
+		{
+			r = (r - roi.tl()) & image_rect;
+			if (r.empty())
+			{
+				continue;
+			}
+
+			base_image(r).copyTo(content.scaled_image(r));
+			cv::Mat mat = content.scaled_image(r);
+			draw_layers(mat, roi.tl() + r.tl(), layouts, status_text);
+			copy_opencv_mat_to_juce_image(content.scaled_image, cached_image, r);
+		}
 	}
 
-	if (image_to_use.size() != content.scaled_image_size)
+	drawn_layouts.swap(layouts);
+	drawn_status_text.swap(status_text);
+	cached_image_origin = roi.tl();
+	rebuild_mark_index();
+	need_to_rebuild_cache_image = false;
+
+	return;
+}
+
+
+void dm::DMCanvas::rebuild_mark_index()
+{
+	std::vector<cv::Rect> rects;
+	rects.reserve(content.marks.size());
+	for (auto & m : content.marks)
 	{
-		content.scaled_image = DarkHelp::resize_keeping_aspect_ratio(image_to_use, content.scaled_image_size);
+		rects.push_back(m.get_bounding_rect(content.scaled_image_size));
 	}
-	else
+	mark_index.build(rects);
+	mark_index_image_size = content.scaled_image_size;
+
+	return;
+}
+
+
+cv::Mat dm::DMCanvas::render_image(const cv::Rect & roi)
+{
+	set_pyramid_image();
+	cv::Mat mat = pyramid.render(content.scaled_image_size, roi);
+
+	if (mat.empty() == false)
 	{
-		content.scaled_image = image_to_use.clone();
+		std::vector<MarkLayout> layouts;
+		VStr status_text;
+		layout_marks(layouts, status_text);
+		draw_layers(mat, roi.tl(), layouts, status_text);
 	}
 
-	const auto fontface			= cv::FONT_HERSHEY_PLAIN;
-	const auto fontscale		= 1.0;
-	const auto fontthickness	= 1;
+	return mat;
+}
+
+
+const cv::Mat & dm::DMCanvas::set_pyramid_image()
+{
+	if (content.black_and_white_mode_enabled)
+	{
+		content.create_threshold_image();
+
+		pyramid.set_image(content.black_and_white_image);
+
+		return content.black_and_white_image;
+	}
+
+	pyramid.set_image(content.original_image);
+
+	return content.original_image;
+}
+
+
+bool dm::DMCanvas::MarkLayout::operator==(const MarkLayout & rhs) const
+{
+	return
+		rect			== rhs.rect			and
+		label_rect		== rhs.label_rect	and
+		colour			== rhs.colour		and
+		name			== rhs.name			and
+		is_prediction	== rhs.is_prediction	and
+		show_corners	== rhs.show_corners	and
+		thickness		== rhs.thickness		and
+		alpha			== rhs.alpha			and
+		shade_alpha		== rhs.shade_alpha;
+}
+
+
+void dm::DMCanvas::layout_marks(std::vector<MarkLayout> & layouts, VStr & status_text)
+{
+	layouts.clear();
+	status_text.clear();
+
+	const cv::Size & scaled_image_size = content.scaled_image_size;
 
 	content.marks_are_shown			= content.show_marks;
 	content.predictions_are_shown	= content.show_predictions != EToggle::kOff;
@@ -146,58 +368,35 @@ void dm::DMCanvas::rebuild_cache_image()
 		}
 
 		const bool is_selected	= (static_cast<int>(idx) == content.selected_mark);
-		const std::string name	= m.description;
-		const cv::Rect r		= m.get_bounding_rect(content.scaled_image.size());
-		const cv::Scalar colour	= m.get_colour();
-		const int thickness		= (mouse_drag_is_active == false and (is_selected or content.all_marks_are_bold) ? 2 : 1);
-
-		cv::Mat tmp = content.scaled_image(r).clone();
+		const bool is_bold		= (mouse_drag_is_active == false and (is_selected or content.all_marks_are_bold));
 
-		if (content.shade_rectangles)
-		{
-			const double shade_divider = (is_selected ? 4.0 : 2.0);
-			cv::rectangle(tmp, cv::Rect(0, 0, tmp.cols, tmp.rows), colour, CV_FILLED);
-			const double alpha = content.alpha_blend_percentage / shade_divider;
-			const double beta = 1.0 - alpha;
-			cv::addWeighted(tmp, alpha, content.scaled_image(r), beta, 0, tmp);
-		}
-
-		cv::rectangle(tmp, cv::Rect(0, 0, tmp.cols, tmp.rows), colour, thickness, cv::LINE_8);
+		MarkLayout layout;
+		layout.rect				= m.get_bounding_rect(scaled_image_size);
+		layout.colour			= m.get_colour();
+		layout.name				= m.description;
+		layout.is_prediction	= m.is_prediction;
+		layout.thickness		= (is_bold ? 2 : 1);
+		layout.alpha			= (is_bold ? 1.0 : content.alpha_blend_percentage);
+		layout.shade_alpha		= (content.shade_rectangles ? content.alpha_blend_percentage / (is_selected ? 4.0 : 2.0) : 0.0);
 
-		if (m.is_prediction)
-		{
-			// draw an "X" through the middle of the rectangle
-			cv::line(tmp, cv::Point(0, 0), cv::Point(tmp.cols, tmp.rows), colour, 1, cv::LINE_8);
-			cv::line(tmp, cv::Point(0, tmp.rows), cv::Point(tmp.cols, 0), colour, 1, cv::LINE_8);
-		}
-
-		const double alpha = (mouse_drag_is_active == false and (is_selected or content.all_marks_are_bold) ? 1.0 : content.alpha_blend_percentage);
-		const double beta = 1.0 - alpha;
-		cv::addWeighted(tmp, alpha, content.scaled_image(r), beta, 0, content.scaled_image(r));
+		const cv::Rect & r = layout.rect;
 
 		// draw the drag corners (only if the annotation is large enough to accomodate them)
-		if (mouse_drag_is_active == false and is_selected and tmp.cols > content.corner_size * 2 and tmp.rows > content.corner_size * 2)
-		{
-			tmp = content.scaled_image(r);
-			cv::circle(tmp, cv::Point(0				, 0				), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
-			cv::circle(tmp, cv::Point(tmp.cols - 1	, 0				), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
-			cv::circle(tmp, cv::Point(tmp.cols - 1	, tmp.rows - 1	), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
-			cv::circle(tmp, cv::Point(0				, tmp.rows - 1	), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
-		}
+		layout.show_corners = (mouse_drag_is_active == false and is_selected and r.width > content.corner_size * 2 and r.height > content.corner_size * 2);
 
 		// We calculate the width and height of the text compared to the mark rectangle to determine if the label
 		// would end up being bigger than the mark.  If the label is >= the size of the mark rectangle, then
 		// we'll skip displaying the label when the mode is set to "auto".
 		int baseline = 0;
-		const auto text_size = cv::getTextSize(name, fontface, fontscale, fontthickness, &baseline);
+		const auto text_size = cv::getTextSize(layout.name, fontface, fontscale, fontthickness, &baseline);
 
 		// draw the label (if the area is large enough to warrant a label)
 		if	(mouse_drag_is_active == false and
 				(content.show_labels == EToggle::kOn	or
 				(content.show_labels == EToggle::kAuto	and
 					(is_selected or
-						(	text_size.width		<= tmp.cols and
-							text_size.height	<= tmp.rows
+						(	text_size.width		<= r.width and
+							text_size.height	<= r.height
 						)
 					)
 				)))
@@ -208,15 +407,15 @@ void dm::DMCanvas::rebuild_cache_image()
 			// Rectangle for the label needs the TL and BR coordinates.
 			// But putText() needs the BL point where to start writing the text, and we want to add a 1x1 pixel border
 			cv::Rect text_rect = cv::Rect(x_offset + r.x, r.y, text_size.width + 2, text_size.height + baseline + 2);
-			if (is_selected or content.all_marks_are_bold or text_rect.br().y >= content.scaled_image.rows)
+			if (is_selected or content.all_marks_are_bold or text_rect.br().y >= scaled_image_size.height)
 			{
 				// move the text label above the rectangle
 				text_rect.y = r.y - text_size.height - baseline;
 			}
 
 #if 0
-			Log("scaled image cols=" + std::to_string(content.scaled_image.cols) + " rows=" + std::to_string(content.scaled_image.rows));
-			Log("text size for " + name + ": w=" + std::to_string(text_size.width) + " h=" + std::to_string(text_size.height) + " baseline=" + std::to_string(baseline));
+			Log("scaled image cols=" + std::to_string(scaled_image_size.width) + " rows=" + std::to_string(scaled_image_size.height));
+			Log("text size for " + layout.name + ": w=" + std::to_string(text_size.width) + " h=" + std::to_string(text_size.height) + " baseline=" + std::to_string(baseline));
 			Log("mark rectangle:  "
 				" x=" + std::to_string(r.x) +
 				" y=" + std::to_string(r.y) +
@@ -230,15 +429,15 @@ void dm::DMCanvas::rebuild_cache_image()
 #endif
 			// check to see if the label is going to be off-screen, and if so slide it to a better position
 			if (text_rect.x < 0) text_rect.x = r.x;				// first attempt to fix this is to make it left-aligned
-			if (text_rect.x + text_rect.width >= content.scaled_image.cols)	text_rect.x = content.scaled_image.cols - text_rect.width;
+			if (text_rect.x + text_rect.width >= scaled_image_size.width)	text_rect.x = scaled_image_size.width - text_rect.width;
 			if (text_rect.x < 0) text_rect.x = 0;				// ...and if that didn't work, slide it to the left edge
-			if (text_rect.x + text_rect.width >= content.scaled_image.cols) text_rect.width = content.scaled_image.cols - text_rect.x;
+			if (text_rect.x + text_rect.width >= scaled_image_size.width) text_rect.width = scaled_image_size.width - text_rect.x;
 
 			if (text_rect.y < 0) text_rect.y = r.y + r.height;	// vertically, we need to place the label underneath instead of above
 
 			// if the mark is from the top of the image to the bottom of the image, then we still haven't
 			// found a good place to put the label, in which case we'll move it to a spot inside the mark
-			if (text_rect.y + r.height >= content.scaled_image.rows) text_rect.y = r.y + 2;
+			if (text_rect.y + r.height >= scaled_image_size.height) text_rect.y = r.y + 2;
 
 #if 0
 			Log("text_rect after: "
@@ -248,130 +447,133 @@ void dm::DMCanvas::rebuild_cache_image()
 				" h=" + std::to_string(text_rect.height));
 #endif
 
-			tmp = cv::Mat(text_rect.size(), CV_8UC3, colour);
-			cv::putText(tmp, name, cv::Point(1, tmp.rows - 5), fontface, fontscale, black, fontthickness, cv::LINE_AA);
-			cv::addWeighted(tmp, alpha, content.scaled_image(text_rect), beta, 0, content.scaled_image(text_rect));
+			layout.label_rect = text_rect;
 		}
+
+		layout.footprint = (layout.label_rect.empty() ? r : (r | layout.label_rect));
+		layouts.push_back(layout);
 	}
 
-	if (content.user_specified_zoom_factor <= 0.0)
+	if (content.predictions_are_shown and content.show_processing_time and content.darknet_image_processing_time.empty() == false)
 	{
-		zoom_image_offset = cv::Point(0, 0);
+		status_text.push_back(content.darknet_image_processing_time);
+		status_text.push_back("predictions: " + std::to_string(content.number_of_predictions));
+		if (number_of_hidden_marks)
+		{
+			status_text.push_back("user marks: " + std::to_string(number_of_hidden_marks));
+		}
 	}
-	else
+
+	if (content.user_specified_zoom_factor > 0.0)
 	{
-		// figure out what zoom offset we need to apply to the image
+		const int percentage = std::round(content.user_specified_zoom_factor * 100.0);
+		status_text.push_back("zoom: " + std::to_string(percentage) + "%");
+	}
 
-		const int h = content.canvas.getHeight();
-		const int w = content.canvas.getWidth();
+	return;
+}
 
-#if 0
-		Log(std::string(__PRETTY_FUNCTION__) + ": need to find a RoI because we're zooming " + std::to_string(content.user_specified_zoom_factor) +
-			", original image measures " +
-			std::to_string(content.original_image.cols) +
-			" x " +
-			std::to_string(content.original_image.rows) +
-			", scaled image measures " +
-			std::to_string(content.scaled_image.cols) +
-			" x " +
-			std::to_string(content.scaled_image.rows) +
-			" canvas measures"
-			" w=" + std::to_string(w) +
-			" h=" + std::to_string(h)
-			);
-#endif
 
-		cv::Rect r(
-			content.user_specified_zoom_factor * content.zoom_point_of_interest.x - w / 2,
-			content.user_specified_zoom_factor * content.zoom_point_of_interest.y - h / 2,
-			w, h);
+cv::Rect dm::DMCanvas::get_status_text_rect(const VStr & status_text) const
+{
+	if (status_text.empty())
+	{
+		return cv::Rect();
+	}
 
-		if (r.width < std::min(content.scaled_image.cols, w))
-		{
-			// our rectangle can be made wider to include more of the image
-			const double delta = (std::min(content.scaled_image.cols, w) - r.width) / 2.0;
-			r.x -= delta;
-			r.width += std::round(delta * 2.0);
-		}
-		if (r.height < std::min(content.scaled_image.rows, h))
-		{
-			const double delta = (std::min(content.scaled_image.rows, h) - r.height) / 2.0;
-			r.y -= delta;
-			r.height += std::round(delta * 2.0);
-		}
-		if (r.x > 0 and r.x < 100)
-		{
-			// near the left border...we may as well stick to the border
-			r.x = 0;
-		}
-		if (r.y > 0 and r.y < 100)
-		{
-			// near the top border...we may as well stick to the border
-			r.y = 0;
-		}
-		if (r.x < 0)
-		{
-			r.width -= r.x;
-			r.x = 0;
-		}
-		if (r.y < 0)
-		{
-			r.height -= r.y;
-			r.y = 0;
-		}
+	int width = 0;
+	for (const auto & line : status_text)
+	{
+		int baseline = 0;
+		width = std::max(width, cv::getTextSize(line, fontface, fontscale, fontthickness, &baseline).width);
+	}
+
+	// the text is always drawn in the top-left corner of the canvas, starting at row 25 and then every 15 pixels
+	return cv::Rect(zoom_image_offset.x, zoom_image_offset.y, 10 + width + 5, 25 + 15 * status_text.size());
+}
 
-		// we now have a rectangle that would fit the canvas -- but is the image large enough to accomodate this rectangle?
 
-		if (r.x + r.width > content.scaled_image.cols)
+void dm::DMCanvas::draw_layers(cv::Mat & mat, const cv::Point & offset, const std::vector<MarkLayout> & layouts, const VStr & status_text)
+{
+	//						blue   green red
+	const cv::Scalar black	(0x00, 0x00, 0x00);
+	const cv::Scalar white	(0xff, 0xff, 0xff);
+
+	const cv::Rect image_rect(offset, mat.size());
+
+	for (const auto & layout : layouts)
+	{
+		if ((layout.footprint & image_rect).empty())
 		{
-			r.x = std::max(0, content.scaled_image.cols - r.width);
-			r.width = content.scaled_image.cols - r.x;
+			// nothing from this mark would be visible
+			continue;
 		}
-		if (r.y + r.height > content.scaled_image.rows)
+
+		const cv::Rect & r		= layout.rect;
+		const cv::Scalar colour	= layout.colour;
+		const double alpha		= layout.alpha;
+		const double beta		= 1.0 - alpha;
+
+		// the mark might only be partially visible (though the label might still be visible)
+		const cv::Rect visible_rect = r & image_rect;
+		if (visible_rect.empty() == false)
 		{
-			r.y = std::max(0, content.scaled_image.rows - r.height);
-			r.height = content.scaled_image.rows - r.y;
-		}
+			cv::Mat dst = mat(visible_rect - offset);
+			cv::Mat tmp = dst.clone();
 
-#if 0
-		Log(std::string(__PRETTY_FUNCTION__) + ": zoom=" + std::to_string(content.user_specified_zoom_factor) +
-			" r.x=" + std::to_string(r.x) +
-			" r.y=" + std::to_string(r.y) +
-			" r.w=" + std::to_string(r.width) +
-			" r.h=" + std::to_string(r.height) +
-			" canvas.width=" + std::to_string(w) +
-			" canvas.height=" + std::to_string(h));
-#endif
+			// location of the mark relative to the visible portion, which may have negative coordinates
+			const cv::Rect mark_rect(r.tl() - visible_rect.tl(), r.size());
 
-		// this next line is what tells the crosshair component what portion of the image we want to show on the screen
-		zoom_image_offset = r.tl();
-	}
+			if (layout.shade_alpha > 0.0)
+			{
+				cv::rectangle(tmp, cv::Rect(0, 0, tmp.cols, tmp.rows), colour, CV_FILLED);
+				cv::addWeighted(tmp, layout.shade_alpha, dst, 1.0 - layout.shade_alpha, 0, tmp);
+			}
 
-//	Log(std::string(__PRETTY_FUNCTION__) + ": zoom image offset: x=" + std::to_string(zoom_image_offset.x) + " y=" + std::to_string(zoom_image_offset.y));
+			cv::rectangle(tmp, mark_rect, colour, layout.thickness, cv::LINE_8);
 
-	int next_text_row = 25;
-	if (content.predictions_are_shown and content.show_processing_time and content.darknet_image_processing_time.empty() == false)
-	{
-		cv::putText(content.scaled_image, content.darknet_image_processing_time, zoom_image_offset + cv::Point(10, next_text_row), fontface, fontscale, white, fontthickness, cv::LINE_AA);
-		next_text_row += 15;
-		cv::putText(content.scaled_image, "predictions: " + std::to_string(content.number_of_predictions), zoom_image_offset + cv::Point(10, next_text_row), fontface, fontscale, white, fontthickness, cv::LINE_AA);
-		next_text_row += 15;
-		if (number_of_hidden_marks)
+			if (layout.is_prediction)
+			{
+				// draw an "X" through the middle of the rectangle
+				cv::line(tmp, mark_rect.tl(), mark_rect.br(), colour, 1, cv::LINE_8);
+				cv::line(tmp, cv::Point(mark_rect.x, mark_rect.y + mark_rect.height), cv::Point(mark_rect.x + mark_rect.width, mark_rect.y), colour, 1, cv::LINE_8);
+			}
+
+			cv::addWeighted(tmp, alpha, dst, beta, 0, dst);
+
+			if (layout.show_corners)
+			{
+				const cv::Point tl = mark_rect.tl();
+				cv::circle(dst, tl + cv::Point(0				, 0				), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
+				cv::circle(dst, tl + cv::Point(r.width - 1	, 0				), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
+				cv::circle(dst, tl + cv::Point(r.width - 1	, r.height - 1	), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
+				cv::circle(dst, tl + cv::Point(0				, r.height - 1	), content.corner_size, colour, CV_FILLED, cv::LINE_AA);
+			}
+		}
+
+		const cv::Rect visible_text_rect = layout.label_rect & image_rect;
+		if (visible_text_rect.empty() == false)
 		{
-			cv::putText(content.scaled_image, "user marks: " + std::to_string(number_of_hidden_marks), zoom_image_offset + cv::Point(10, next_text_row), fontface, fontscale, white, fontthickness, cv::LINE_AA);
-			next_text_row += 15;
+			cv::Mat label(layout.label_rect.size(), CV_8UC3, colour);
+			cv::putText(label, layout.name, cv::Point(1, label.rows - 5), fontface, fontscale, black, fontthickness, cv::LINE_AA);
+			label = label(visible_text_rect - layout.label_rect.tl());
+			cv::Mat dst = mat(visible_text_rect - offset);
+			cv::addWeighted(label, alpha, dst, beta, 0, dst);
 		}
 	}
 
-	if (content.user_specified_zoom_factor > 0.0)
+	if ((get_status_text_rect(status_text) & image_rect).empty() == false)
 	{
-		const int percentage = std::round(content.user_specified_zoom_factor * 100.0);
-		cv::putText(content.scaled_image, "zoom: " + std::to_string(percentage) + "%", zoom_image_offset + cv::Point(10, next_text_row), fontface, fontscale, white, fontthickness, cv::LINE_AA);
-		next_text_row += 15;
-	}
+		// the text is always drawn in the top-left corner of the canvas
+		const cv::Point text_offset = zoom_image_offset - offset;
 
-	cached_image = convert_opencv_mat_to_juce_image(content.scaled_image);
-	need_to_rebuild_cache_image = false;
+		int next_text_row = 25;
+		for (const auto & line : status_text)
+		{
+			cv::putText(mat, line, text_offset + cv::Point(10, next_text_row), fontface, fontscale, white, fontthickness, cv::LINE_AA);
+			next_text_row += 15;
+		}
+	}
 
 	return;
 }
@@ -393,11 +595,19 @@ void dm::DMCanvas::mouseDown(const MouseEvent & event)
 	content.selected_mark	= -1;
 	int index_to_delete		= -1;
 
+	if (need_to_rebuild_cache_image or mark_index.size() != content.marks.size() or mark_index_image_size != content.scaled_image_size)
+	{
+		// the marks have been modified since the last time the image was drawn
+		rebuild_mark_index();
+	}
+
 	// find all of the marks beneath the mouse location, and remember the one with the *smallest* area so
 	// that if we have a tiny mark within a larger mark, this will select the smaller (harder to click) mark
 	int smallest_area = INT_MAX;
-	for (size_t idx = 0; index_to_delete == -1 and idx < content.marks.size(); idx ++)
+	const auto marks_beneath_mouse = mark_index.find(p);
+	for (size_t i = 0; index_to_delete == -1 and i < marks_beneath_mouse.size(); i ++)
 	{
+		const size_t idx = marks_beneath_mouse[i];
 		Mark & m = content.marks.at(idx);
 		cv::Rect r = m.get_bounding_rect(content.scaled_image_size);
 #if 0
@@ -500,8 +710,8 @@ void dm::DMCanvas::mouseDoubleClick(const MouseEvent & event)
 	}
 #endif
 
-	double x = double(event.x + zoom_image_offset.x) / cached_image.getWidth();
-	double y = double(event.y + zoom_image_offset.y) / cached_image.getHeight();
+	double x = double(event.x + zoom_image_offset.x) / content.scaled_image_size.width;
+	double y = double(event.y + zoom_image_offset.y) / content.scaled_image_size.height;
 
 	Mark m(	cv::Point2d(x, y), content.most_recent_size, content.original_image.size(), content.most_recent_class_idx);
 	m.name			= content.names.at(content.most_recent_class_idx);
@@ -527,8 +737,8 @@ void dm::DMCanvas::mouseDragFinished(juce::Rectangle<int> drag_rect)
 	double midy			= drag_rect.getCentreY() + zoom_image_offset.y;
 	double width		= drag_rect.getWidth();
 	double height		= drag_rect.getHeight();
-	double image_width	= cached_image.getWidth();
-	double image_height	= cached_image.getHeight();
+	double image_width	= content.scaled_image_size.width;
+	double image_height	= content.scaled_image_size.height;
 
 #if 0
 	Log("mouse drag rectangle:"
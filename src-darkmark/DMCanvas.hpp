@@ -8,9 +8,15 @@
 namespace dm
 {
 	/** This is the actual class that draws the current image and all of the annotations/marks.  Most of the work is performed
-	 * in @ref rebuild_cache_image().  Also of importance is the mouse event handling to ensure that marks are created and
+	 * in @ref render_image().  Also of importance is the mouse event handling to ensure that marks are created and
 	 * stretched correctly.
 	 *
+	 * Only the portion of the image which is visible in the canvas is drawn, so zooming into very large images doesn't
+	 * require the entire image to be resized.  See @ref ImagePyramid.
+	 *
+	 * The resampled image is kept as a base layer, and the marks are drawn over a copy of it.  When marks change, only the
+	 * pixels of the marks which changed are restored from the base layer and redrawn.
+	 *
 	 * This class is one of the children of @ref DMContent.
 	 */
 	class DMCanvas : public CrosshairComponent
@@ -23,11 +29,75 @@ namespace dm
 
 			virtual void rebuild_cache_image();
 
+			/** Draw the portion @p roi of the scaled image (see @ref DMContent::scaled_image_size) including the marks and
+			 * the text in the top-left corner of the canvas.  This is also used to save the annotated image to disk.
+			 */
+			cv::Mat render_image(const cv::Rect & roi);
+
 			virtual void mouseDown(const MouseEvent & event) override;
 			virtual void mouseDoubleClick(const MouseEvent & event) override;
 			virtual void mouseDragFinished(juce::Rectangle<int> drag_rect) override;
 
 			/// Link to the parent which manages the content, including all the marks.
 			DMContent & content;
+
+			/// Used to quickly resample the visible portion of the image.
+			ImagePyramid pyramid;
+
+		private:
+
+			/// Everything needed to draw one mark.  Comparing these is how we know which marks need to be redrawn.
+			struct MarkLayout
+			{
+				cv::Rect	rect;			///< The mark, in scaled image coordinates.
+				cv::Rect	label_rect;		///< The label, in scaled image coordinates.  Empty if the label is not shown.
+				cv::Rect	footprint;		///< Every pixel touched when drawing this mark.
+				cv::Scalar	colour;
+				std::string	name;
+				bool		is_prediction;
+				bool		show_corners;
+				int			thickness;
+				double		alpha;
+				double		shade_alpha;	///< Zero if the rectangle is not shaded.
+
+				bool operator==(const MarkLayout & rhs) const;
+			};
+
+			/// Rebuild @ref mark_index from the current marks and the current scaled image size.
+			void rebuild_mark_index();
+
+			/// Give the pyramid either the colour or the black-and-white image.  @returns the image that was used.
+			const cv::Mat & set_pyramid_image();
+
+			/// Determine how each visible mark needs to be drawn, and the text to show in the top-left corner.
+			void layout_marks(std::vector<MarkLayout> & layouts, VStr & status_text);
+
+			/// The area covered by the text in the top-left corner, in scaled image coordinates.
+			cv::Rect get_status_text_rect(const VStr & status_text) const;
+
+			/** Draw the marks and text onto @p mat.  The top-left corner of @p mat is located at @p offset in the scaled
+			 * image, and nothing is drawn outside of @p mat.
+			 */
+			void draw_layers(cv::Mat & mat, const cv::Point & offset, const std::vector<MarkLayout> & layouts, const VStr & status_text);
+
+			/// The visible portion of the image without any marks.  @{
+			cv::Mat base_image;
+			cv::Mat base_source;
+			cv::Rect base_roi;
+			cv::Size base_scaled_image_size;
+			/// @}
+
+			/** The bounding rectangle of every mark in scaled image coordinates, used to find the marks beneath the mouse.
+			 * The ID of each rectangle is the index of the mark.  Rebuilt every time the marks are drawn.
+			 */
+			SpatialIndex mark_index;
+
+			/// The scaled image size used to create @ref mark_index.
+			cv::Size mark_index_image_size;
+
+			/// What was drawn the last time @ref rebuild_cache_image() was called.  @{
+			std::vector<MarkLayout> drawn_layouts;
+			VStr drawn_status_text;
+			/// @}
 	};
 }
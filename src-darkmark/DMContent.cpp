@@ -8,7 +8,7 @@ using json = nlohmann::json;
 
 dm::DMContent::DMContent(const std::string & prefix) :
 	cfg_prefix(prefix),
-	show_window(not (dmapp().cli_options.count("editor") and dmapp().cli_options.at("editor") == "gen-darknet")),
+	show_window(not (dmapp().cli_options.count("editor") and (dmapp().cli_options.at("editor") == "gen-darknet" or dmapp().cli_options.at("editor") == "predict-all"))),
 	canvas(*this),
 	scrollfield(*this),
 	scrollfield_width(cfg().get_int("scrollfield_width")),
@@ -45,6 +45,13 @@ dm::DMContent::DMContent(const std::string & prefix) :
 	most_recent_class_idx(0),
 	image_filename_index(0),
 	project_info(cfg_prefix),
+	annotation_index(project_info.project_dir),
+	thumbnail_cache(project_info.project_dir),
+	prediction_cache(project_info.project_dir),
+	prediction_thread(*this),
+	prefetch_image_count(cfg().get_int("prefetch_image_count")),
+	darknet_threshold(cfg().get_int("darknet_threshold") / 100.0f),
+	darknet_nms_threshold(cfg().get_int("darknet_nms_threshold") / 100.0f),
 	user_specified_zoom_factor(-1.0),
 	previous_zoom_factor(5.0),
 	current_zoom_factor(1.0)
@@ -59,12 +66,20 @@ dm::DMContent::DMContent(const std::string & prefix) :
 
 	setWantsKeyboardFocus(true);
 
+	annotation_index.load();
+	prediction_cache.set_max_entries(std::max(1, cfg().get_int("prediction_cache_max_entries")));
+	prediction_cache.load();
+	image_prefetcher.set_memory_budget(static_cast<size_t>(std::max(0, cfg().get_int("prefetch_memory_budget_mb"))) * 1024 * 1024);
+
 	VStr json_filenames;
 	images_without_json.clear();
 	std::atomic<bool> done = false;
 	find_files(File(project_info.project_dir), image_filenames, json_filenames, images_without_json, done);
 	Log("number of images found in " + project_info.project_dir + ": " + std::to_string(image_filenames.size()));
 
+	// this uses every image (before the regex filters are applied) so the thumbnails of filtered images are kept
+	thumbnail_cache.prune(image_filenames);
+
 	const auto & action = dmapp().cli_options["editor"];
 
 	try
@@ -126,6 +141,9 @@ dm::DMContent::~DMContent(void)
 		save_text();
 	}
 
+	annotation_index.save();
+	prediction_cache.save();
+
 	return;
 }
 
@@ -244,18 +262,26 @@ void dm::DMContent::start_darknet()
 		try
 		{
 			Log("attempting to load neural network " + darknet_cfg + " / " + darknet_weights + " / " + darknet_names);
+			std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
 			dmapp().darkhelp_nn.reset(new DarkHelp::NN(darknet_cfg, darknet_weights, darknet_names));
 			Log("neural network loaded in " + darkhelp_nn().duration_string());
 
-			darkhelp_nn().config.threshold							= cfg().get_int("darknet_threshold")			/ 100.0f;
+			// get_predictions() calls the neural network with a low threshold and without NMS; see apply_prediction_thresholds()
+			darkhelp_nn().config.threshold							= darknet_threshold;
 			darkhelp_nn().config.hierarchy_threshold				= cfg().get_int("darknet_hierarchy_threshold")	/ 100.0f;
-			darkhelp_nn().config.non_maximal_suppression_threshold	= cfg().get_int("darknet_nms_threshold")		/ 100.0f;
+			darkhelp_nn().config.non_maximal_suppression_threshold	= darknet_nms_threshold;
 			darkhelp_nn().config.enable_tiles						= cfg().get_bool("darknet_image_tiling");
 			names = darkhelp_nn().names;
+
+			prediction_cache.set_network(darknet_cfg, darknet_weights, darknet_names);
 		}
 		catch (const std::exception & e)
 		{
-			dmapp().darkhelp_nn.reset(nullptr);
+			if (true)
+			{
+				std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
+				dmapp().darkhelp_nn.reset(nullptr);
+			}
 			Log("failed to load darknet (cfg=" + darknet_cfg + ", weights=" + darknet_weights + ", names=" + darknet_names + "): " + e.what());
 			if (show_window)
 			{
@@ -270,7 +296,11 @@ void dm::DMContent::start_darknet()
 	}
 	else
 	{
-		dmapp().darkhelp_nn.reset(nullptr);
+		if (true)
+		{
+			std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
+			dmapp().darkhelp_nn.reset(nullptr);
+		}
 		Log("skipped loading darknet due to missing or invalid .cfg or .weights filenames");
 #if 0
 		if (show_window)
@@ -563,15 +593,16 @@ bool dm::DMContent::keyPressed(const KeyPress & key)
 	{
 		if (dmapp().darkhelp_nn)
 		{
-			float threshold = dmapp().darkhelp_nn->config.threshold;
+			float threshold = darknet_threshold;
 
 			threshold += (keycode == KeyPress::upKey ? 0.05f : -0.05f);
 			threshold = std::min(std::max(threshold, 0.05f), 0.95f);
 
-			if (threshold != dmapp().darkhelp_nn->config.threshold)
+			if (threshold != darknet_threshold)
 			{
-				dmapp().darkhelp_nn->config.threshold = threshold;
-				load_image(image_filename_index);
+				// no need to call the neural network again, the raw predictions are filtered using the new threshold
+				darknet_threshold = threshold;
+				apply_prediction_thresholds();
 				show_message("darknet threshold: " + std::to_string((int)std::round(100.0 * threshold)) + "%");
 			}
 		}
@@ -873,10 +904,17 @@ bool dm::DMContent::keyPressed(const KeyPress & key)
 	{
 		if (dmapp().darkhelp_nn)
 		{
-			dmapp().darkhelp_nn->config.enable_tiles = ! dmapp().darkhelp_nn->config.enable_tiles;
-			show_message("image tiling: " + std::string(dmapp().darkhelp_nn->config.enable_tiles ? "enable" : "disable"));
+			bool enable_tiles = false;
+			if (true)
+			{
+				// this waits for any inference which is currently running on the prediction thread
+				std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
+				enable_tiles = ! dmapp().darkhelp_nn->config.enable_tiles;
+				dmapp().darkhelp_nn->config.enable_tiles = enable_tiles;
+			}
+			show_message("image tiling: " + std::string(enable_tiles ? "enable" : "disable"));
+			cfg().setValue("darknet_image_tiling", enable_tiles);
 			load_image(image_filename_index);
-			cfg().setValue("darknet_image_tiling", dmapp().darkhelp_nn->config.enable_tiles);
 		}
 		return true;
 	}
@@ -978,6 +1016,9 @@ dm::DMContent & dm::DMContent::set_sort_order(const dm::ESort new_sort_order)
 		return *this;
 	}
 
+	// whatever images were about to be prefetched are no longer the neighbours of the current image
+	image_prefetcher.cancel();
+
 	// remember the current image filename so we can scroll back to the same one once we're done sorting
 	const std::string old_filename = image_filenames.at(image_filename_index);
 
@@ -1026,7 +1067,8 @@ dm::DMContent & dm::DMContent::set_sort_order(const dm::ESort new_sort_order)
 
 	if (scrollfield_width > 0)
 	{
-		scrollfield.rebuild_entire_field_on_thread();
+		// the annotations haven't changed, so the existing rows can be re-used
+		scrollfield.rebuild_entire_field_on_thread(true);
 	}
 
 	return *this;
@@ -1127,8 +1169,12 @@ dm::DMContent & dm::DMContent::load_image(const size_t new_idx, const bool full_
 		save_text();
 	}
 
+	// any predictions still being calculated are for the previous image
+	prediction_thread.cancel();
+
 	zoom_review_marks_remaining.clear();
 	darknet_image_processing_time = "";
+	raw_predictions.clear();
 	selected_mark	= -1;
 	original_image	= cv::Mat();
 	black_and_white_image = cv::Mat();
@@ -1161,7 +1207,22 @@ dm::DMContent & dm::DMContent::load_image(const size_t new_idx, const bool full_
 	{
 		task = "loading image file " + long_filename;
 //		Log("loading image " + long_filename);
-		original_image = cv::imread(long_filename);
+		if (image_prefetcher.get(long_filename, original_image) == false)
+		{
+			if (full_load == false and display_immediately and canvas.getWidth() > 0 and canvas.getHeight() > 0)
+			{
+				// this is a quick preview such as when dragging the jump slider, so there is no need to decode the full image
+				const int long_side = std::max(canvas.getWidth(), canvas.getHeight());
+				if (thumbnail_cache.get(long_filename, long_side, original_image, false) == false)
+				{
+					original_image = imread_reduced(long_filename, cv::Size(canvas.getWidth(), canvas.getHeight()), annotation_index.get_image_size(long_filename));
+				}
+			}
+			else
+			{
+				original_image = cv::imread(long_filename);
+			}
+		}
 		if (original_image.empty())
 		{
 			// something has gone *very* wrong if we cannot read the image
@@ -1186,54 +1247,28 @@ dm::DMContent & dm::DMContent::load_image(const size_t new_idx, const bool full_
 				need_to_save = true;
 			}
 
-			if (show_predictions != EToggle::kOff)
+			if (show_predictions != EToggle::kOff and dmapp().darkhelp_nn)
 			{
-				if (dmapp().darkhelp_nn)
+				// the bulk tools call load_image() from their own threads, where the marks must be complete when we return
+				if (show_window and MessageManager::existsAndIsCurrentThread())
+				{
+					// show the image right away, the predictions will be added once inference has finished
+					task = "queueing predictions";
+					prediction_thread.request(long_filename, original_image);
+				}
+				else
 				{
 					task = "getting predictions";
-					darkhelp_nn().predict(original_image);
-					darknet_image_processing_time = darkhelp_nn().duration_string();
-					Log("darkhelp processed " + short_filename + " in " + darknet_image_processing_time);
-
-//					std::cout << darkhelp_nn().prediction_results << std::endl;
+					std::string duration;
+					const auto predictions = get_predictions(long_filename, original_image, duration);
 
-					// convert the predictions into marks
 					task = "converting predictions";
-					for (auto prediction : darkhelp_nn().prediction_results)
-					{
-						Mark m(prediction.original_point, prediction.original_size, original_image.size(), prediction.best_class);
-						m.name = names.at(m.class_idx);
-						m.description = prediction.name;
-						m.is_prediction = true;
-						marks.push_back(m);
-					}
+					add_predictions(predictions, duration);
 				}
 			}
 
-			// Sort the marks based on a gross (rounded) X and Y position of the midpoint.  This way when
-			// the user presses TAB or SHIFT+TAB the marks appear in a consistent and predictable order.
 			task = "sorting marks";
-			std::sort(marks.begin(), marks.end(),
-					[](auto & lhs, auto & rhs)
-					{
-						const auto & p1 = lhs.get_normalized_midpoint();
-						const auto & p2 = rhs.get_normalized_midpoint();
-
-						const int y1 = std::round(15.0 * p1.y);
-						const int y2 = std::round(15.0 * p2.y);
-
-						if (y1 < y2) return true;
-						if (y2 < y1) return false;
-
-						// if we get here then y1 and y2 are the same, so now we compare x1 and x2
-
-						const int x1 = std::round(15.0 * p1.x);
-						const int x2 = std::round(15.0 * p2.x);
-
-						if (x1 < x2) return true;
-
-						return false;
-					} );
+			sort_marks();
 		}
 	}
 	catch(const std::exception & e)
@@ -1274,6 +1309,192 @@ dm::DMContent & dm::DMContent::load_image(const size_t new_idx, const bool full_
 		rebuild_image_and_repaint();
 	}
 
+	if (full_load and show_window and MessageManager::existsAndIsCurrentThread())
+	{
+		prefetch_neighbouring_images();
+	}
+
+	return *this;
+}
+
+
+dm::DMContent & dm::DMContent::sort_marks()
+{
+	// remember which mark was selected so we can find it again once the marks have been sorted
+	const bool has_selection = (selected_mark >= 0 and static_cast<size_t>(selected_mark) < marks.size());
+	const Mark selection = (has_selection ? marks[selected_mark] : Mark());
+
+	// Sort the marks based on a gross (rounded) X and Y position of the midpoint.  This way when
+	// the user presses TAB or SHIFT+TAB the marks appear in a consistent and predictable order.
+	std::sort(marks.begin(), marks.end(),
+			[](auto & lhs, auto & rhs)
+			{
+				const auto & p1 = lhs.get_normalized_midpoint();
+				const auto & p2 = rhs.get_normalized_midpoint();
+
+				const int y1 = std::round(15.0 * p1.y);
+				const int y2 = std::round(15.0 * p2.y);
+
+				if (y1 < y2) return true;
+				if (y2 < y1) return false;
+
+				// if we get here then y1 and y2 are the same, so now we compare x1 and x2
+
+				const int x1 = std::round(15.0 * p1.x);
+				const int x2 = std::round(15.0 * p2.x);
+
+				if (x1 < x2) return true;
+
+				return false;
+			} );
+
+	if (has_selection)
+	{
+		selected_mark = -1;
+		for (size_t idx = 0; idx < marks.size(); idx ++)
+		{
+			const Mark & m = marks[idx];
+			if (m.is_prediction				== selection.is_prediction		and
+				m.class_idx					== selection.class_idx			and
+				m.normalized_all_points		== selection.normalized_all_points)
+			{
+				selected_mark = idx;
+				break;
+			}
+		}
+	}
+
+	return *this;
+}
+
+
+DarkHelp::PredictionResults dm::DMContent::get_predictions(const std::string & filename, cv::Mat image, std::string & duration)
+{
+	DarkHelp::PredictionResults predictions;
+
+	// this is called from the prediction thread while the message thread may be changing the DarkHelp configuration
+	std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
+	if (dmapp().darkhelp_nn == nullptr)
+	{
+		return predictions;
+	}
+
+	// Only go back to the neural network if the user wants a lower threshold than what was used to get the raw predictions.
+	// The non-maximal suppression is always done by DarkMark.  @see apply_prediction_thresholds()
+	// These overrides are only for this request; the shared configuration keeps the values chosen by the user.
+	DarkHelp::Config config = darkhelp_nn().config;
+	config.threshold = std::min(raw_prediction_threshold, darknet_threshold.load());
+	config.non_maximal_suppression_threshold = 1.0f;
+
+	const std::string key = prediction_cache.key_for(filename, config);
+	if (prediction_cache.get(key, predictions))
+	{
+		duration = "(cached)";
+		return predictions;
+	}
+
+	// DarkHelp only reads the configuration stored in the network, so swap in the snapshot while holding the lock
+	const DarkHelp::Config original_config = darkhelp_nn().config;
+	darkhelp_nn().config = config;
+	try
+	{
+		predictions	= darkhelp_nn().predict(image);
+		duration	= darkhelp_nn().duration_string();
+	}
+	catch (...)
+	{
+		darkhelp_nn().config = original_config;
+		throw;
+	}
+	darkhelp_nn().config = original_config;
+	Log("darkhelp processed " + File(filename).getFileName().toStdString() + " in " + duration);
+
+	prediction_cache.put(key, predictions);
+
+	return predictions;
+}
+
+
+dm::DMContent & dm::DMContent::add_predictions(const DarkHelp::PredictionResults & predictions, const std::string & duration)
+{
+	darknet_image_processing_time	= duration;
+	raw_predictions					= predictions;
+
+	return apply_prediction_thresholds();
+}
+
+
+dm::DMContent & dm::DMContent::apply_prediction_thresholds()
+{
+	if (original_image.empty())
+	{
+		return *this;
+	}
+
+	// remove the previous predictions, but keep track of which mark was selected since the indexes are about to change
+	int new_selected_mark = -1;
+	for (int idx = 0; idx < static_cast<int>(marks.size()) and idx <= selected_mark; idx ++)
+	{
+		if (marks[idx].is_prediction == false)
+		{
+			new_selected_mark ++;
+		}
+		else if (idx == selected_mark)
+		{
+			new_selected_mark = -1;
+		}
+	}
+	marks.erase(std::remove_if(marks.begin(), marks.end(), [](const Mark & m) { return m.is_prediction; }), marks.end());
+	selected_mark = new_selected_mark;
+
+	const auto predictions = filter_predictions(raw_predictions, darknet_threshold, darknet_nms_threshold);
+
+	// convert the predictions into marks
+	for (const auto & prediction : predictions)
+	{
+		Mark m(prediction.original_point, prediction.original_size, original_image.size(), prediction.best_class);
+		m.name = names.at(m.class_idx);
+		m.description = m.name + " " + std::to_string(static_cast<int>(std::round(100.0f * prediction.best_probability))) + "%";
+		m.is_prediction = true;
+		marks.push_back(m);
+	}
+
+	if (images_are_loading == false)
+	{
+		// the image is already displayed, so the marks need to be sorted and the image redrawn
+		sort_marks();
+		rebuild_image_and_repaint();
+	}
+
+	return *this;
+}
+
+
+dm::DMContent & dm::DMContent::prefetch_neighbouring_images()
+{
+	if (prefetch_image_count <= 0 or image_filenames.size() < 2)
+	{
+		return *this;
+	}
+
+	// alternate between the next and previous images, since the user is most likely to continue in the same direction
+	// but it is also common to go back one image
+	VStr filenames;
+	const size_t count = std::min(static_cast<size_t>(prefetch_image_count), image_filenames.size());
+	for (size_t offset = 1; offset <= count; offset ++)
+	{
+		if (image_filename_index + offset < image_filenames.size())
+		{
+			filenames.push_back(image_filenames.at(image_filename_index + offset));
+		}
+		if (image_filename_index >= offset)
+		{
+			filenames.push_back(image_filenames.at(image_filename_index - offset));
+		}
+	}
+
+	image_prefetcher.prefetch(filenames);
+
 	return *this;
 }
 
@@ -1326,6 +1547,7 @@ dm::DMContent & dm::DMContent::save_json()
 	if (json_filename.empty() == false)
 	{
 		json root;
+		AnnotationSummary summary;
 		size_t next_id = 0;
 		for (auto & m : marks)
 		{
@@ -1350,6 +1572,11 @@ dm::DMContent & dm::DMContent::save_json()
 			root["mark"][next_id]["rect"]["int_w"]	= r2.width;
 			root["mark"][next_id]["rect"]["int_h"]	= r2.height;
 
+			MarkSummary ms;
+			ms.class_idx	= m.class_idx;
+			ms.rect			= r2;
+			summary.marks.push_back(ms);
+
 			for (size_t point_idx = 0; point_idx < m.normalized_all_points.size(); point_idx ++)
 			{
 				const cv::Point2d & p = m.normalized_all_points.at(point_idx);
@@ -1383,11 +1610,18 @@ dm::DMContent & dm::DMContent::save_json()
 		{
 			std::ofstream fs(json_filename);
 			fs << root.dump(1, '\t') << std::endl;
+			fs.close();
+
+			summary.completely_empty	= root["completely_empty"];
+			summary.timestamp			= root["timestamp"];
+			summary.image_size			= original_image.size();
+			annotation_index.update(File(json_filename), summary);
 		}
 		else
 		{
 			// image has no markup -- delete the .json file if it existed
 			std::remove(json_filename.c_str());
+			annotation_index.remove(File(json_filename));
 		}
 
 		if (scrollfield_width > 0)
@@ -1417,42 +1651,20 @@ dm::DMContent & dm::DMContent::import_text_annotations(const VStr & images_fn)
 
 size_t dm::DMContent::count_marks_in_json(File & f, const bool for_sorting_purposes)
 {
-	size_t result = 0;
+	const AnnotationSummary summary = annotation_index.get(f);
 
-	if (f.existsAsFile())
+	if (summary.exists and summary.is_valid == false)
 	{
-		try
-		{
-			json root = json::parse(f.loadFileAsString().toStdString());
-			result = root["mark"].size();
-
-			if (result > 0 and for_sorting_purposes)
-			{
-				// add 1 when we're counting for sorting purposes, that way
-				// empty images wont be mixed up with images that have 1 mark
-				result ++;
-			}
-
-			if (result == 0 and root.value("completely_empty", false))
-			{
-				// if there are zero marks, then see if the image has been identified
-				// as completely empty, and if so count that as if it was a mark
-				result = 1;
-			}
-		}
-		catch (const std::exception & e)
-		{
-			Log("Error parsing " + f.getFullPathName().toStdString() + ": " + e.what());
-			AlertWindow::showMessageBox(
-				AlertWindow::AlertIconType::WarningIcon,
-				"DarkMark",
-				"Failed to read or parse the .json file " + f.getFullPathName().toStdString() + ":\n"
-				"\n" +
-				e.what());
-		}
+		Log("Error parsing " + f.getFullPathName().toStdString() + ": " + summary.error);
+		AlertWindow::showMessageBox(
+			AlertWindow::AlertIconType::WarningIcon,
+			"DarkMark",
+			"Failed to read or parse the .json file " + f.getFullPathName().toStdString() + ":\n"
+			"\n" +
+			summary.error);
 	}
 
-	return result;
+	return summary.count_marks(for_sorting_purposes);
 }
 
 
@@ -1585,13 +1797,14 @@ dm::DMContent & dm::DMContent::delete_current_image()
 		File f(image_filenames[image_filename_index]);
 		Log("deleting the file at index #" + std::to_string(image_filename_index) + ": " + f.getFullPathName().toStdString());
 
+		image_prefetcher.invalidate(f.getFullPathName().toStdString());
 		f.moveToTrash();
 		f.withFileExtension(".txt"	).moveToTrash();
 		f.withFileExtension(".json"	).moveToTrash();
 
 		image_filenames.erase(image_filenames.begin() + image_filename_index);
 		load_image(image_filename_index);
-		scrollfield.rebuild_entire_field_on_thread();
+		scrollfield.rebuild_entire_field_on_thread(true);
 	}
 
 	return *this;
@@ -1977,6 +2190,7 @@ PopupMenu dm::DMContent::create_popup_menu()
 	image.addSeparator();
 	image.addItem("move empty images..."																						, std::function<void()>( [&]{ move_empty_images();			} ));
 	image.addItem("re-load and re-save every image"																				, std::function<void()>( [&]{ reload_resave_every_image();	} ));
+	image.addItem("predict all images..."																, (dmapp().darkhelp_nn != nullptr), false	, std::function<void()>( [&]{ predict_all_images();			} ));
 	image.addSeparator();
 	image.addItem("flip images..."																								, std::function<void()>( [&]{ flip_images();				} ));
 	image.addItem("rotate images..."																							, std::function<void()>( [&]{ rotate_every_image();			} ));
@@ -2278,6 +2492,18 @@ dm::DMContent & dm::DMContent::reload_resave_every_image()
 }
 
 
+dm::DMContent & dm::DMContent::predict_all_images()
+{
+	// make sure the editor isn't using the prediction cache while the workers are running
+	prediction_thread.cancel();
+
+	DMContentPredictAll helper(*this);
+	helper.runThread();
+
+	return *this;
+}
+
+
 dm::DMContent & dm::DMContent::show_jump_wnd()
 {
 	if (not dmapp().jump_wnd)
@@ -2342,26 +2568,21 @@ dm::DMContent & dm::DMContent::save_screenshot(const bool full_size, const std::
 
 		if (full_size) // uppercase 'S' means we should use the full-size image
 		{
-			// we want to save the full-size image, not the resized one we're currently viewing,
-			// so swap out a few things, re-build the annotated image, and save *those* results
+			// we want to save the full-size image, not the resized one we're currently viewing
 			scaled_image_size = original_image.size();
-			canvas.rebuild_cache_image();
 		}
 
+		// the canvas only draws the visible portion of the image, so render the entire image for saving
+		const cv::Mat mat = canvas.render_image(cv::Rect(cv::Point(0, 0), scaled_image_size));
+		scaled_image_size = old_scaled_image_size;
+
 		if (f.hasFileExtension(".png"))
 		{
-			cv::imwrite(f.getFullPathName().toStdString(), scaled_image, {CV_IMWRITE_PNG_COMPRESSION, 9});
+			cv::imwrite(f.getFullPathName().toStdString(), mat, {CV_IMWRITE_PNG_COMPRESSION, 9});
 		}
 		else
 		{
-			cv::imwrite(f.getFullPathName().toStdString(), scaled_image, {CV_IMWRITE_JPEG_QUALITY, 75});
-		}
-
-		if (scaled_image_size != old_scaled_image_size)
-		{
-			// now put back the scaled image we expect to be there
-			scaled_image_size = old_scaled_image_size;
-			canvas.rebuild_cache_image();
+			cv::imwrite(f.getFullPathName().toStdString(), mat, {CV_IMWRITE_JPEG_QUALITY, 75});
 		}
 	}
 
@@ -65,6 +65,28 @@ namespace dm
 
 			DMContent & load_image(const size_t new_idx, const bool full_load = true, const bool display_immediately = false);
 
+			/// Sort the marks by position so TAB and SHIFT+TAB visit them in a predictable order.
+			DMContent & sort_marks();
+
+			/** Get the predictions for the given image, either from @ref prediction_cache or by calling DarkHelp.  This is
+			 * called from @ref prediction_thread, so it must not touch anything other than the cache and the neural network.
+			 */
+			DarkHelp::PredictionResults get_predictions(const std::string & filename, cv::Mat image, std::string & duration);
+
+			/** Remember the raw DarkHelp results and convert them into prediction marks.  This is called by @ref load_image()
+			 * when there is no window or when called from a thread other than the message thread, otherwise by @ref
+			 * prediction_thread once inference has finished on the current image.
+			 */
+			DMContent & add_predictions(const DarkHelp::PredictionResults & predictions, const std::string & duration);
+
+			/** Filter @ref raw_predictions using @ref darknet_threshold and @ref darknet_nms_threshold, and replace the
+			 * prediction marks with the results.  This is how the thresholds can be changed without calling darknet again.
+			 */
+			DMContent & apply_prediction_thresholds();
+
+			/// Start decoding the images on either side of the current image.  @see @ref image_prefetcher
+			DMContent & prefetch_neighbouring_images();
+
 			DMContent & save_text();
 
 			DMContent & save_json();
@@ -117,6 +139,9 @@ namespace dm
 
 			DMContent & reload_resave_every_image();
 
+			/// Run the neural network on every image and write the prediction sidecar files.  @see @ref DMContentPredictAll
+			DMContent & predict_all_images();
+
 			DMContent & show_jump_wnd();
 
 			DMContent & show_message(const std::string & msg);
@@ -208,6 +233,8 @@ namespace dm
 			std::atomic<bool> images_are_loading;
 
 			cv::Mat original_image;
+
+			/// The portion of the scaled image which is visible in the canvas, including the marks.  @see @ref DMCanvas::render_image()
 			cv::Mat scaled_image;
 
 			/// Image to which we've applied black-and-white thresholding, and converted back to a RGB image.
@@ -242,6 +269,36 @@ namespace dm
 
 			ProjectInfo project_info;
 
+			/// Summary of every .json file in the project so bulk operations don't need to parse each .json file.
+			AnnotationIndex annotation_index;
+
+			/// Smaller copies of the images, used by the jump window and the review.
+			ThumbnailCache thumbnail_cache;
+
+			/// Predictions from previous calls to DarkHelp.
+			PredictionCache prediction_cache;
+
+			/// Inference is done on a secondary thread so images can be displayed before the predictions are available.
+			DMContentPredictionThread prediction_thread;
+
+			/// Images before and after the current one are decoded on a secondary thread.  @see @ref prefetch_image_count
+			ImagePrefetcher image_prefetcher;
+
+			/// The number of images to decode ahead of time in each direction.  Set to zero to disable prefetching.
+			int prefetch_image_count;
+
+			/** The thresholds selected by the user.  These are not given to DarkHelp, which instead is always called with
+			 * @ref raw_prediction_threshold and NMS disabled.  @see @ref apply_prediction_thresholds()
+			 */
+			std::atomic<float> darknet_threshold;
+			float darknet_nms_threshold;
+
+			/// The predictions returned by DarkHelp for the current image, before thresholds and NMS were applied.
+			DarkHelp::PredictionResults raw_predictions;
+
+			/// The threshold used when calling DarkHelp, unless @ref darknet_threshold is even lower.
+			static constexpr float raw_prediction_threshold = 0.05f;
+
 			BubbleMessageComponent bubble_message;
 
 			VStr images_without_json;
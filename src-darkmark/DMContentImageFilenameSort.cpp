@@ -2,9 +2,6 @@
 
 #include "DarkMark.hpp"
 
-#include "json.hpp"
-using json = nlohmann::json;
-
 
 dm::DMContentImageFilenameSort::DMContentImageFilenameSort(dm::DMContent & c) :
 		ThreadWithProgressWindow("Sorting images...", true, true),
@@ -66,10 +63,10 @@ void dm::DMContentImageFilenameSort::run()
 				*/
 			size_t timestamp = 0;
 
-			if (file.existsAsFile())
+			const AnnotationSummary summary = content.annotation_index.get(file);
+			if (summary.exists and summary.is_valid)
 			{
-				json j = json::parse(file.loadFileAsString().toStdString());
-				timestamp = now - j["timestamp"].get<std::time_t>();
+				timestamp = now - summary.timestamp;
 			}
 
 			// If we don't have a timestamp, then use the file's modification time instead,
@@ -113,6 +110,8 @@ void dm::DMContentImageFilenameSort::run()
 					} );
 	}
 
+	content.annotation_index.save();
+
 	if (threadShouldExit())
 	{
 		// user hit the "cancel" button, so go back to a normal alphabetical sort order
@@ -0,0 +1,315 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+
+/// Thresholds are compared with a limited precision, the same way they are stored in the prediction cache keys.
+static int threshold_to_int(const float f)
+{
+	return static_cast<int>(std::round(f * 1000.0f));
+}
+
+
+dm::DMContentPredictAll::DMContentPredictAll(dm::DMContent & c) :
+	ThreadWithProgressWindow("Predicting all images...", true, true),
+	content(c),
+	threshold(0.5f),
+	nms_threshold(0.45f),
+	hierarchy_threshold(0.5f),
+	enable_tiles(false),
+	next_work_idx(0),
+	images_processed(0),
+	images_failed(0),
+	workers_running(0)
+{
+	return;
+}
+
+
+dm::DMContentPredictAll::~DMContentPredictAll()
+{
+	return;
+}
+
+
+File dm::DMContentPredictAll::get_sidecar(const std::string & image_filename)
+{
+	return File(image_filename).withFileExtension(".predictions.json");
+}
+
+
+void dm::DMContentPredictAll::run()
+{
+	DarkMarkApplication::setup_signal_handling();
+
+	cfg_filename		= cfg().get_str(content.cfg_prefix + "cfg"		);
+	weights_filename	= cfg().get_str(content.cfg_prefix + "weights"	);
+	names_filename		= cfg().get_str(content.cfg_prefix + "names"	);
+	threshold			= content.darknet_threshold;
+	nms_threshold		= content.darknet_nms_threshold;
+	hierarchy_threshold	= cfg().get_int("darknet_hierarchy_threshold") / 100.0f;
+	enable_tiles		= cfg().get_bool("darknet_image_tiling");
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
+		if (dmapp().darkhelp_nn)
+		{
+			hierarchy_threshold	= darkhelp_nn().config.hierarchy_threshold;
+			enable_tiles		= darkhelp_nn().config.enable_tiles;
+		}
+	}
+
+	if (cfg_filename.empty() or weights_filename.empty() or File(cfg_filename).existsAsFile() == false or File(weights_filename).existsAsFile() == false)
+	{
+		Log("cannot predict all images since the neural network files are missing");
+		return;
+	}
+
+	// the CLI value has already been validated in DarkMarkApplication::initialise()
+	int number_of_threads = cfg().get_int("predict_all_threads");
+	const auto & options = dmapp().cli_options;
+	if (options.count("threads"))
+	{
+		number_of_threads = String(options.at("threads")).getIntValue();
+	}
+	if (number_of_threads <= 0)
+	{
+		// zero means "automatic", which is one thread per CPU core
+		number_of_threads = std::thread::hardware_concurrency();
+	}
+	const size_t number_of_workers = std::clamp(number_of_threads, 1, 64);
+
+	// skip the images which already have predictions, that way the job can be resumed after it was interrupted
+	setStatusMessage("Finding images which need predictions...");
+	// editing the .cfg file in place (such as changing the network dimensions) changes the predictions as much as new weights
+	const int64 network_time = std::max(
+		File(cfg_filename		).getLastModificationTime().toMilliseconds(),
+		File(weights_filename	).getLastModificationTime().toMilliseconds());
+	work.clear();
+	size_t images_skipped = 0;
+	for (const auto & fn : content.image_filenames)
+	{
+		if (threadShouldExit())
+		{
+			return;
+		}
+
+		if (sidecar_is_current(fn, network_time))
+		{
+			images_skipped ++;
+			continue;
+		}
+
+		work.push_back(fn);
+	}
+	Log("predict all: " + std::to_string(work.size()) + " images to process, " + std::to_string(images_skipped) + " skipped, using " + std::to_string(number_of_workers) + " worker thread" + (number_of_workers == 1 ? "" : "s"));
+
+	if (work.empty())
+	{
+		return;
+	}
+
+	setStatusMessage("Loading " + std::to_string(number_of_workers) + " neural network" + (number_of_workers == 1 ? "" : "s") + "...");
+
+	next_work_idx		= 0;
+	images_processed	= 0;
+	images_failed		= 0;
+	workers_running		= number_of_workers;
+
+	std::vector<std::thread> workers;
+	for (size_t idx = 0; idx < number_of_workers; idx ++)
+	{
+		workers.emplace_back(&DMContentPredictAll::worker, this, idx);
+	}
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	auto next_cache_save = start_time + std::chrono::minutes(5);
+	while (workers_running > 0)
+	{
+		wait(500);
+
+		const size_t done		= images_processed + images_failed;
+		const auto now			= std::chrono::high_resolution_clock::now();
+		const double seconds	= std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count() / 1000.0;
+		const double per_second	= (seconds > 0.0 ? done / seconds : 0.0);
+
+		setProgress(static_cast<double>(done) / work.size());
+		if (done > 0)
+		{
+			const size_t remaining = (per_second > 0.0 ? std::round((work.size() - done) / per_second) : 0);
+			setStatusMessage(
+				std::to_string(done) + "/" + std::to_string(work.size()) + " images, " +
+				String(per_second, 1).toStdString() + " images/sec, " +
+				std::to_string(remaining / 60) + " minute" + (remaining / 60 == 1 ? "" : "s") + " remaining");
+		}
+
+		if (now >= next_cache_save)
+		{
+			// periodically save the cache so not much is lost if DarkMark is killed
+			content.prediction_cache.save();
+			next_cache_save = now + std::chrono::minutes(5);
+		}
+	}
+
+	for (auto & t : workers)
+	{
+		t.join();
+	}
+
+	content.prediction_cache.save();
+
+	const double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count() / 1000.0;
+	Log("predict all: " + std::to_string(images_processed) + " images processed and " + std::to_string(images_failed) + " failed in " + String(seconds, 1).toStdString() + " seconds");
+
+	return;
+}
+
+
+void dm::DMContentPredictAll::worker(const size_t worker_idx)
+{
+	DarkMarkApplication::setup_signal_handling();
+
+	std::unique_ptr<DarkHelp::NN> nn;
+	try
+	{
+		nn.reset(new DarkHelp::NN(cfg_filename, weights_filename, names_filename));
+
+		// same as the editor, get the raw predictions and then apply the thresholds; see DMContent::get_predictions()
+		nn->config.threshold							= std::min(DMContent::raw_prediction_threshold, threshold);
+		nn->config.hierarchy_threshold					= hierarchy_threshold;
+		nn->config.non_maximal_suppression_threshold	= 1.0f;
+		nn->config.enable_tiles							= enable_tiles;
+	}
+	catch (const std::exception & e)
+	{
+		Log("predict all: worker #" + std::to_string(worker_idx) + " failed to load the neural network: " + e.what());
+		workers_running --;
+		return;
+	}
+
+	while (threadShouldExit() == false)
+	{
+		const size_t idx = next_work_idx ++;
+		if (idx >= work.size())
+		{
+			break;
+		}
+
+		const std::string & fn = work.at(idx);
+		try
+		{
+			DarkHelp::PredictionResults raw_predictions;
+			const std::string key = content.prediction_cache.key_for(fn, nn->config);
+			if (content.prediction_cache.get(key, raw_predictions) == false)
+			{
+				cv::Mat mat = cv::imread(fn);
+				if (mat.empty())
+				{
+					throw std::runtime_error("failed to read image");
+				}
+				raw_predictions = nn->predict(mat);
+				content.prediction_cache.put(key, raw_predictions);
+			}
+
+			write_sidecar(fn, filter_predictions(raw_predictions, threshold, nms_threshold));
+			images_processed ++;
+		}
+		catch (const std::exception & e)
+		{
+			Log("predict all: error processing " + fn + ": " + e.what());
+			images_failed ++;
+		}
+	}
+
+	workers_running --;
+
+	return;
+}
+
+
+bool dm::DMContentPredictAll::sidecar_is_current(const std::string & image_filename, const int64 network_time) const
+{
+	const File sidecar = get_sidecar(image_filename);
+	if (sidecar.existsAsFile() == false)
+	{
+		return false;
+	}
+
+	const int64 sidecar_time = sidecar.getLastModificationTime().toMilliseconds();
+	if (sidecar_time < network_time or sidecar_time < File(image_filename).getLastModificationTime().toMilliseconds())
+	{
+		return false;
+	}
+
+	try
+	{
+		// sidecars written by older versions don't have all of these settings, so they are considered out-of-date
+		const json root = json::parse(sidecar.loadFileAsString().toStdString());
+
+		return
+			root.at("cfg"					).get<std::string>()				== cfg_filename							and
+			root.at("weights"				).get<std::string>()				== weights_filename						and
+			threshold_to_int(root.at("threshold"			).get<float>())	== threshold_to_int(threshold)			and
+			threshold_to_int(root.at("nms_threshold"		).get<float>())	== threshold_to_int(nms_threshold)		and
+			threshold_to_int(root.at("hierarchy_threshold"	).get<float>())	== threshold_to_int(hierarchy_threshold)	and
+			root.at("enable_tiles"			).get<bool>()						== enable_tiles;
+	}
+	catch (const std::exception & e)
+	{
+		Log("predict all: cannot use the existing sidecar " + sidecar.getFullPathName().toStdString() + ": " + e.what());
+	}
+
+	return false;
+}
+
+
+void dm::DMContentPredictAll::write_sidecar(const std::string & image_filename, const DarkHelp::PredictionResults & predictions)
+{
+	json root;
+	root["timestamp"]			= std::time(nullptr);
+	root["version"]				= DARKMARK_VERSION;
+	root["cfg"]					= cfg_filename;
+	root["weights"]				= weights_filename;
+	root["threshold"]			= threshold;
+	root["nms_threshold"]		= nms_threshold;
+	root["hierarchy_threshold"]	= hierarchy_threshold;
+	root["enable_tiles"]		= enable_tiles;
+	root["prediction"]			= json::array();
+
+	for (size_t idx = 0; idx < predictions.size(); idx ++)
+	{
+		const auto & prediction = predictions.at(idx);
+		const std::string name = (static_cast<size_t>(prediction.best_class) < content.names.size() ? content.names.at(prediction.best_class) : std::to_string(prediction.best_class));
+
+		root["prediction"][idx]["class_idx"]	= prediction.best_class;
+		root["prediction"][idx]["name"]			= name;
+		root["prediction"][idx]["probability"]	= prediction.best_probability;
+		root["prediction"][idx]["rect"]["x"]	= prediction.original_point.x - prediction.original_size.width / 2.0;
+		root["prediction"][idx]["rect"]["y"]	= prediction.original_point.y - prediction.original_size.height / 2.0;
+		root["prediction"][idx]["rect"]["w"]	= prediction.original_size.width;
+		root["prediction"][idx]["rect"]["h"]	= prediction.original_size.height;
+		root["prediction"][idx]["rect"]["int_x"]= prediction.rect.x;
+		root["prediction"][idx]["rect"]["int_y"]= prediction.rect.y;
+		root["prediction"][idx]["rect"]["int_w"]= prediction.rect.width;
+		root["prediction"][idx]["rect"]["int_h"]= prediction.rect.height;
+	}
+
+	// write to a temporary file and then rename it so an interrupted job never leaves a partial sidecar behind
+	const File sidecar = get_sidecar(image_filename);
+	const File tmp = sidecar.getSiblingFile(sidecar.getFileName() + ".tmp");
+	const std::string fn = tmp.getFullPathName().toStdString();
+
+	std::ofstream fs(fn);
+	fs << root.dump(1, '\t') << std::endl;
+	fs.close();
+	if (fs.fail() or tmp.moveFileTo(sidecar) == false)
+	{
+		tmp.deleteFile();
+		throw std::runtime_error("failed to write " + sidecar.getFullPathName().toStdString());
+	}
+
+	return;
+}
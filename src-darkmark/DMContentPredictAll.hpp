@@ -0,0 +1,63 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Run the neural network on every image in the project and write the predictions to a sidecar file next to each
+	 * image.  Multiple worker threads are used, each with its own instance of @p DarkHelp::NN.  Images which already have
+	 * an up-to-date sidecar file are skipped, so the job can be interrupted and resumed later.  A sidecar is up-to-date
+	 * when it is newer than the image, the .cfg file, and the .weights file, and was created with the same neural network
+	 * files, thresholds, and tiling setting.
+	 *
+	 * This can be started from the editor's popup menu, or from the CLI with @p editor=predict-all.
+	 */
+	class DMContentPredictAll : public ThreadWithProgressWindow
+	{
+		public:
+
+			DMContentPredictAll(dm::DMContent & c);
+
+			virtual ~DMContentPredictAll();
+
+			virtual void run();
+
+			/// Get the prediction sidecar file which belongs to the given image.
+			static File get_sidecar(const std::string & image_filename);
+
+			DMContent & content;
+
+		private:
+
+			/// Each worker thread loads a neural network and processes images until there is no more work.
+			void worker(const size_t worker_idx);
+
+			/// Determine if the sidecar was created from this image using the current neural network and settings.
+			bool sidecar_is_current(const std::string & image_filename, const int64 network_time) const;
+
+			/// Write the predictions for one image.
+			void write_sidecar(const std::string & image_filename, const DarkHelp::PredictionResults & predictions);
+
+			std::string cfg_filename;
+			std::string weights_filename;
+			std::string names_filename;
+
+			/// Settings copied from the editor when the job starts.  @{
+			float threshold;
+			float nms_threshold;
+			float hierarchy_threshold;
+			bool enable_tiles;
+			/// @}
+
+			/// The images which need to be processed.
+			VStr work;
+
+			std::atomic<size_t> next_work_idx;
+			std::atomic<size_t> images_processed;
+			std::atomic<size_t> images_failed;
+			std::atomic<size_t> workers_running;
+	};
+}
@@ -0,0 +1,146 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+
+dm::DMContentPredictionThread::DMContentPredictionThread(dm::DMContent & c) :
+	Thread("darkhelp prediction thread"),
+	content(c),
+	request_id(0),
+	result_id(0)
+{
+	return;
+}
+
+
+dm::DMContentPredictionThread::~DMContentPredictionThread()
+{
+	cancelPendingUpdate();
+
+	if (isThreadRunning())
+	{
+		cancel();
+		signalThreadShouldExit();
+		work_available.signal();
+
+		// never kill the thread while it is inside darknet; inference on a large image can take several seconds on the CPU
+		waitForThreadToExit(-1);
+	}
+
+	return;
+}
+
+
+dm::DMContentPredictionThread & dm::DMContentPredictionThread::request(const std::string & filename, cv::Mat image)
+{
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(request_lock);
+		request_id ++;
+		pending_filename	= filename;
+		pending_image		= image;
+	}
+
+	if (isThreadRunning() == false)
+	{
+		startThread();
+	}
+	work_available.signal();
+
+	return *this;
+}
+
+
+dm::DMContentPredictionThread & dm::DMContentPredictionThread::cancel()
+{
+	std::lock_guard<std::mutex> lock(request_lock);
+	request_id ++;
+	pending_filename.clear();
+	pending_image = cv::Mat();
+
+	return *this;
+}
+
+
+void dm::DMContentPredictionThread::run()
+{
+	DarkMarkApplication::setup_signal_handling();
+
+	while (threadShouldExit() == false)
+	{
+		std::string filename;
+		cv::Mat image;
+		size_t id = 0;
+
+		if (true)
+		{
+			std::lock_guard<std::mutex> lock(request_lock);
+			if (pending_image.empty() == false)
+			{
+				filename	= pending_filename;
+				image		= pending_image;
+				id			= request_id;
+			}
+		}
+
+		if (image.empty() or dmapp().darkhelp_nn == nullptr)
+		{
+			work_available.wait(500);
+			continue;
+		}
+
+		DarkHelp::PredictionResults predictions;
+		std::string duration;
+		try
+		{
+			predictions = content.get_predictions(filename, image, duration);
+		}
+		catch (const std::exception & e)
+		{
+			Log("Error with " + filename + ": exception caught while getting predictions: " + e.what());
+		}
+
+		std::lock_guard<std::mutex> lock(request_lock);
+		if (id == request_id)
+		{
+			// this is still the image the user wants to see, so hand the results to the message thread
+			pending_filename.clear();
+			pending_image		= cv::Mat();
+			result_id			= id;
+			result_filename		= filename;
+			result_duration		= duration;
+			results.swap(predictions);
+			triggerAsyncUpdate();
+		}
+	}
+
+	return;
+}
+
+
+void dm::DMContentPredictionThread::handleAsyncUpdate()
+{
+	std::string filename;
+	std::string duration;
+	DarkHelp::PredictionResults predictions;
+
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(request_lock);
+		if (result_id != request_id)
+		{
+			// the user has moved on since these results were generated
+			return;
+		}
+		filename = result_filename;
+		duration = result_duration;
+		predictions.swap(results);
+	}
+
+	if (filename == content.long_filename)
+	{
+		content.add_predictions(predictions, duration);
+	}
+
+	return;
+}
@@ -0,0 +1,56 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Run DarkHelp inference on a secondary thread so the image and the existing marks can be shown immediately.  When the
+	 * predictions are ready, they are handed back to @ref DMContent on the message thread.  Only the most recent request
+	 * matters:  if the user moves to a different image before inference has finished, the old results are discarded.
+	 */
+	class DMContentPredictionThread final : public Thread, public AsyncUpdater
+	{
+		public:
+
+			DMContentPredictionThread(DMContent & c);
+
+			virtual ~DMContentPredictionThread();
+
+			/// Queue an image for inference.  This replaces any previous request which hasn't yet started.
+			DMContentPredictionThread & request(const std::string & filename, cv::Mat image);
+
+			/// Discard any pending request, as well as the results of the inference currently running (if any).
+			DMContentPredictionThread & cancel();
+
+			/// Call DarkHelp on the most recent request.  @see @ref request()
+			virtual void run() override;
+
+			/// Pass the predictions to @ref DMContent::add_predictions() on the message thread.
+			virtual void handleAsyncUpdate() override;
+
+			DMContent & content;
+
+		private:
+
+			std::mutex request_lock;
+			WaitableEvent work_available;
+
+			/// Incremented every time @ref request() or @ref cancel() is called so stale results can be discarded.
+			size_t request_id;
+
+			/// The image which is waiting for inference.  @{
+			std::string pending_filename;
+			cv::Mat pending_image;
+			/// @}
+
+			/// The results of the most recent inference.  @{
+			size_t result_id;
+			std::string result_filename;
+			DarkHelp::PredictionResults results;
+			std::string result_duration;
+			/// @}
+	};
+}
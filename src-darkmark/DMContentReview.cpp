@@ -26,31 +26,150 @@ void dm::DMContentReview::run()
 {
 	DarkMarkApplication::setup_signal_handling();
 
-	const bool resize_thumbnails = cfg().get_bool("review_resize_thumbnails");
-	const int row_height = cfg().get_int("review_table_row_height");
-	const cv::Size desired_size(9999, row_height);
+	const size_t number_of_images = content.image_filenames.size();
 
-	const double max_work = content.image_filenames.size();
-	double work_completed = 0.0;
+	// each image gets its own result so the order of the marks does not depend on how the threads were scheduled
+	VImageResults results(number_of_images);
+	std::atomic<size_t> next_image_idx(0);
+	std::atomic<size_t> images_processed(0);
 
+	const size_t number_of_threads = std::max(size_t(1), std::min(number_of_images, static_cast<size_t>(std::thread::hardware_concurrency())));
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < number_of_threads; idx ++)
+	{
+		threads.emplace_back(&DMContentReview::worker, this, std::ref(results), std::ref(next_image_idx), std::ref(images_processed));
+	}
+
+	while (images_processed < number_of_images and threadShouldExit() == false)
+	{
+		setProgress(static_cast<double>(images_processed) / number_of_images);
+		wait(100);
+	}
+
+	for (auto & t : threads)
+	{
+		t.join();
+	}
+
+	// remember the image sizes which were read from the image headers
+	content.annotation_index.save();
+
+	// the worker threads above created the missing thumbnails; this only builds the compact description of every mark,
+	// and the review window will then draw the thumbnails from the cache as rows are shown
 	MMReviewInfo m;
+	VReviewImages images;
 	MStrSize md5s;
 
+	for (auto & result : results)
+	{
+		if (result.has_json == false)
+		{
+			continue;
+		}
+
+		const uint32_t image_idx = images.size();
+		for (auto & review_info : result.marks)
+		{
+			review_info.image_idx = image_idx;
+			m[review_info.class_idx].push_back(review_info);
+		}
+
+		if (result.image.md5.empty() == false and result.image.original_size.area() > 0)
+		{
+			md5s[result.image.md5] ++;
+		}
+
+		images.push_back(std::move(result.image));
+	}
+	results.clear();
+
+	// the perceptual hash is used to find images which are not byte-identical, but which are nearly the same
+	const int radius = cfg().get_int("near_duplicate_distance");
+	std::vector<uint64_t> hashes;
+	std::vector<size_t> hashed_images;
+	for (size_t idx = 0; idx < images.size(); idx ++)
+	{
+		images[idx].similar_group = idx;
+		images[idx].similar_count = 0;
+		if (images[idx].original_size.area() > 0)
+		{
+			hashes.push_back(images[idx].dhash);
+			hashed_images.push_back(idx);
+		}
+	}
+	const auto groups = group_near_duplicates(hashes, radius);
+	std::map<size_t, size_t> group_sizes;
+	for (const auto & group : groups)
+	{
+		group_sizes[group] ++;
+	}
+	for (size_t idx = 0; idx < groups.size(); idx ++)
+	{
+		auto & image = images[hashed_images[idx]];
+		image.similar_group = hashed_images[groups[idx]];
+		image.similar_count = group_sizes[groups[idx]] - 1;
+	}
+	Log("near-duplicate groups: " + std::to_string(group_sizes.size()) + " groups for " + std::to_string(hashes.size()) + " images");
+
+	if (threadShouldExit() == false)
+	{
+		Log("review map entries (classes found): " + std::to_string(m.size()));
+		for (const auto & iter : m)
+		{
+			const auto & class_idx = iter.first;
+			const auto & vri = iter.second;
+			Log("review map entries for class #" + std::to_string(class_idx) + ": " + std::to_string(vri.size()));
+		}
+	}
+
+
+	if (not dmapp().review_wnd)
+	{
+		dmapp().review_wnd.reset(new DMReviewWnd(content));
+
+		// start with JUCE 7, setting the always-on-top flag before the window has been fully created and displayed
+		// seems to cause a segfault deep inside JUCE and X
+//		dmapp().review_wnd->setAlwaysOnTop(true);
+	}
+	dmapp().review_wnd->m.swap(m);
+	dmapp().review_wnd->images.swap(images);
+	dmapp().review_wnd->md5s.swap(md5s);
+	dmapp().review_wnd->rebuild_notebook();
+	dmapp().review_wnd->toFront(true);
+
+	return;
+}
+
+
+void dm::DMContentReview::worker(VImageResults & results, std::atomic<size_t> & next_image_idx, std::atomic<size_t> & images_processed)
+{
+	DarkMarkApplication::setup_signal_handling();
+
 	// last index in the names vector will be to store "errors"
 	const size_t error_index = content.names.size();
 
+	// libmagic is not thread-safe, so each thread needs its own cookie
 	magic_t magic_cookie = magic_open(MAGIC_MIME_TYPE);
 	magic_load(magic_cookie, nullptr);
 
-	for (const auto & fn : content.image_filenames)
+	while (threadShouldExit() == false)
 	{
-		if (threadShouldExit())
+		const size_t idx = next_image_idx ++;
+		if (idx >= content.image_filenames.size())
 		{
 			break;
 		}
 
-		setProgress(work_completed / max_work);
-		work_completed ++;
+		// the progress bar shows finished images, so the count is incremented when this iteration ends (including "continue")
+		struct Finished final
+		{
+			std::atomic<size_t> & count;
+			~Finished() { count ++; }
+		} finished{images_processed};
+
+		const std::string & fn = content.image_filenames.at(idx);
+		ImageResult & result = results.at(idx);
+		result.has_json = false;
 
 		File f = File(fn).withFileExtension(".json");
 		if (f.existsAsFile() == false)
@@ -59,70 +178,94 @@ void dm::DMContentReview::run()
 			continue;
 		}
 
+		result.has_json = true;
+		ReviewImage & image = result.image;
+		image.filename = fn;
+		VReviewInfo & marks = result.marks;
+
 		json root;
-		cv::Mat mat;
+		MemoryBlock bytes;
 		try
 		{
 			root = json::parse(f.loadFileAsString().toStdString());
-			mat = cv::imread(fn);
+
+			// the file is only read once, and those bytes are used for the md5, the MIME type, and decoding the image if needed
+			if (File(fn).loadFileAsData(bytes) and bytes.getSize() > 0)
+			{
+				image.md5 = MD5(bytes).toHexString().toStdString();
+
+				// the thumbnail cache knows the size of the image, in which case we don't need to decode the image at all
+				ThumbnailCache::Info info;
+				if (content.thumbnail_cache.get_info(fn, info) == false)
+				{
+					// the image header gives us the size, so large images can be decoded at a reduced size which is still
+					// large enough for the largest thumbnail
+					const cv::Size original_size = content.annotation_index.get_image_size(fn);
+					const int level = ThumbnailCache::levels.back();
+					const cv::Mat buffer(1, bytes.getSize(), CV_8UC1, bytes.getData());
+					cv::Mat mat = cv::imdecode(buffer, reduced_imread_flags(original_size, cv::Size(level, level)));
+					if (mat.empty() == false)
+					{
+						// this also creates the thumbnails which the review window will use to draw the marks
+						info = content.thumbnail_cache.create(fn, mat, original_size);
+					}
+				}
+				image.original_size	= info.original_size;
+				image.dhash			= info.dhash;
+			}
 		}
 		catch(const std::exception & e)
 		{
 			Log("failed to read image " + fn + " or parse json " + f.getFullPathName().toStdString() + ": " + e.what());
-			const auto class_idx = error_index;
 			ReviewInfo review_info;
-			review_info.overlap_sum	= 0.0;
-			review_info.class_idx	= class_idx;
-			review_info.filename	= fn;
-			review_info.mat			= cv::Mat(32, 32, CV_8UC3, cv::Scalar(0, 0, 255)); // use a red square to indicate a problem
-			review_info.errors.push_back(e.what()); // default error msg, but then see if we can provide something more specific
-			if (root.empty())
-			{
-				review_info.errors.push_back("error reading json file " + f.getFullPathName().toStdString());
-			}
-			else if (mat.empty())
-			{
-				review_info.errors.push_back("error reading image file " + fn);
-			}
-			const size_t idx = m[class_idx].size();
-			m[class_idx][idx] = review_info;
+			review_info.class_idx	= error_index;
+			review_info.overlap_sum	= 0.0f;
+			review_info.flags		= (root.empty() ? kReviewErrorJson : kReviewErrorImage);
+			image.error				= e.what();
+			marks.push_back(review_info);
 			continue;
 		}
 
-		if (mat.empty())
+		if (image.original_size.area() <= 0)
 		{
 			Log("failed to load image " + fn);
-			const auto class_idx = error_index;
 			ReviewInfo review_info;
-			review_info.overlap_sum	= 0.0;
-			review_info.class_idx	= class_idx;
-			review_info.filename	= fn;
-			review_info.mat			= cv::Mat(32, 32, CV_8UC3, cv::Scalar(0, 0, 255)); // use a red square to indicate a problem
-			review_info.errors.push_back("failed to load image");
-			const size_t idx		= m[class_idx].size();
-			m[class_idx][idx]		= review_info;
+			review_info.class_idx	= error_index;
+			review_info.overlap_sum	= 0.0f;
+			review_info.flags		= kReviewErrorImage;
+			marks.push_back(review_info);
 			continue;
 		}
 
-		const auto md5 = MD5(mat.data, mat.step[0] * mat.rows).toHexString().toStdString();
-		md5s[md5] ++;
+		const cv::Size & original_size = image.original_size;
+
+		// Check to see if the file type looks sane.  Especially when working with 3rd-party data sets, I've seen plenty of images
+		// which are saved with .jpg extension, but which are actually .bmp, .gif, or .png.  (Though I'm not certain if this causes
+		// problems when darknet uses opencv to load images...?)
+		image.mime_type = magic_buffer(magic_cookie, bytes.getData(), bytes.getSize());
+		uint16_t mime_flags = kReviewNone;
+		if (image.mime_type != "image/jpeg" and image.mime_type != "image/png")
+		{
+			// looks like something about this image is different than what we'd normally expect
+			if (image.mime_type.find("image/") == std::string::npos)
+			{
+				mime_flags = kReviewErrorNotAnImage;
+			}
+			else
+			{
+				mime_flags = kReviewWarningUnusualType;
+			}
+		}
 
 		if (root["mark"].empty() and root.value("completely_empty", false))
 		{
 			const auto class_idx = content.empty_image_name_index;
 			ReviewInfo review_info;
-			review_info.overlap_sum = 0.0;
-			review_info.class_idx = class_idx;
-			review_info.filename = fn;
-			review_info.mime_type = magic_file(magic_cookie, fn.c_str());
-			review_info.r = cv::Rect(0, 0, mat.cols, mat.rows);
-			review_info.md5 = md5;
-
-			// full-size images are always resized
-			review_info.mat = DarkHelp::resize_keeping_aspect_ratio(mat, desired_size);
-
-			const size_t idx = m[class_idx].size();
-			m[class_idx][idx] = review_info;
+			review_info.class_idx	= class_idx;
+			review_info.overlap_sum	= 0.0f;
+			review_info.r			= cv::Rect(0, 0, original_size.width, original_size.height);
+			review_info.flags		= kReviewEmptyImage;
+			marks.push_back(review_info);
 			continue;
 		}
 
@@ -130,16 +273,11 @@ void dm::DMContentReview::run()
 		{
 			// nothing we can do with this file we don't have any marks defined
 			Log("no marks defined, yet image is not marked as empty: " + fn);
-			const auto class_idx = error_index;
 			ReviewInfo review_info;
-			review_info.overlap_sum = 0.0;
-			review_info.class_idx = class_idx;
-			review_info.filename = fn;
-			review_info.md5 = md5;
-			review_info.mat = cv::Mat(32, 32, CV_8UC3, cv::Scalar(0, 0, 255)); // use a red square to indicate a problem
-			review_info.errors.push_back("no marks defined, yet image is not marked as empty");
-			const size_t idx = m[class_idx].size();
-			m[class_idx][idx] = review_info;
+			review_info.class_idx	= error_index;
+			review_info.overlap_sum	= 0.0f;
+			review_info.flags		= kReviewErrorNoMarks;
+			marks.push_back(review_info);
 			continue;
 		}
 
@@ -152,21 +290,25 @@ void dm::DMContentReview::run()
 				break;
 			}
 
-			const int x = std::round(mat.cols * mark["rect"]["x"].get<double>());
-			const int y = std::round(mat.rows * mark["rect"]["y"].get<double>());
-			const int w = std::round(mat.cols * mark["rect"]["w"].get<double>());
-			const int h = std::round(mat.rows * mark["rect"]["h"].get<double>());
+			const int x = std::round(original_size.width	* mark["rect"]["x"].get<double>());
+			const int y = std::round(original_size.height	* mark["rect"]["y"].get<double>());
+			const int w = std::round(original_size.width	* mark["rect"]["w"].get<double>());
+			const int h = std::round(original_size.height	* mark["rect"]["h"].get<double>());
 			const cv::Rect r(x, y, w, h);
 
 			all_rectangles.push_back(r);
 		}
 
+		// only the marks which touch each other need to be compared when calculating the overlap
+		SpatialIndex spatial_index;
+		spatial_index.build(all_rectangles);
+
 		// This image may need to be resized for the neural network.  Figure out the exact factor by which the image
 		// will be resized so we can determine if individual marks will be too small.
 		const double network_width	= content.project_info.image_width;
 		const double network_height	= content.project_info.image_height;
-		const double image_width	= mat.cols;
-		const double image_height	= mat.rows;
+		const double image_width	= original_size.width;
+		const double image_height	= original_size.height;
 		const double scale_x		= network_width / image_width;
 		const double scale_y		= network_height / image_height;
 
@@ -179,61 +321,34 @@ void dm::DMContentReview::run()
 			}
 
 			size_t class_idx = mark["class_idx"].get<size_t>();
-			const int x = std::round(mat.cols * mark["rect"]["x"].get<double>());
-			const int y = std::round(mat.rows * mark["rect"]["y"].get<double>());
-			const int w = std::round(mat.cols * mark["rect"]["w"].get<double>());
-			const int h = std::round(mat.rows * mark["rect"]["h"].get<double>());
+			const int x = std::round(original_size.width	* mark["rect"]["x"].get<double>());
+			const int y = std::round(original_size.height	* mark["rect"]["y"].get<double>());
+			const int w = std::round(original_size.width	* mark["rect"]["w"].get<double>());
+			const int h = std::round(original_size.height	* mark["rect"]["h"].get<double>());
 			const cv::Rect r1(x, y, w, h);
 
 			ReviewInfo review_info;
-			review_info.r = r1;
-			review_info.overlap_sum = 0.0;
-			review_info.class_idx = class_idx;
-			review_info.filename = fn;
-			review_info.md5 = md5;
-
-			// Check to see if the file type looks sane.  Especially when working with 3rd-party data sets, I've seen plenty of images
-			// which are saved with .jpg extension, but which are actually .bmp, .gif, or .png.  (Though I'm not certain if this causes
-			// problems when darknet uses opencv to load images...?)
-			review_info.mime_type = magic_file(magic_cookie, fn.c_str());
-			if (review_info.mime_type != "image/jpeg" and review_info.mime_type != "image/png")
-			{
-				// looks like something about this image is different than what we'd normally expect
-				if (review_info.mime_type.find("image/") == std::string::npos)
-				{
-					review_info.errors.push_back("not an image");
-				}
-				else
-				{
-					review_info.warnings.push_back("unusual image type");
-				}
-			}
+			review_info.r			= r1;
+			review_info.flags		= mime_flags;
 
-			try
-			{
-				cv::Mat roi = mat(r1);
-				if (resize_thumbnails or roi.rows > row_height)
-				{
-					review_info.mat = DarkHelp::resize_keeping_aspect_ratio(roi, desired_size).clone();
-				}
-				else
-				{
-					review_info.mat = roi.clone();
-				}
-			}
-			catch (...)
+			// the thumbnail is created later, but we already know if the mark cannot possibly be cropped from the image
+			if (r1.area() <= 0 or (r1 & cv::Rect(0, 0, original_size.width, original_size.height)) != r1)
 			{
 				Log(content.names[class_idx] + ": encountered a problem trying to get the ROI from " + fn);
-				review_info.mat = cv::Mat(32, 32, CV_8UC3, cv::Scalar(0, 0, 255)); // use a red square to indicate a problem
-				review_info.errors.push_back("error reading image or region of interest; maybe try to delete and re-create the mark?");
+				review_info.flags |= kReviewErrorROI;
 				class_idx = error_index;
 			}
+			review_info.class_idx = class_idx;
 
-			// now compare this rectangle against all other rectangles in this image to see if there is any overlap
-			for (const auto & r2 : all_rectangles)
+			double overlap_sum = 0.0;
+
+			// now compare this rectangle against all other rectangles in this image which overlap it (rectangles which
+			// don't overlap have an intersection over union of zero so they don't change the sum)
+			for (const auto id : spatial_index.find(r1))
 			{
-				// so now we have r1 and r2, and since we're looping over "all_rectangles" at some
-				// point r1 == r2 which we'll need to take into account when we calculate the sum
+				// so now we have r1 and r2, and since the spatial index contains all the rectangles at
+				// some point r1 == r2 which we'll need to take into account when we calculate the sum
+				const cv::Rect & r2 = spatial_index.at(id);
 
 				// see: https://stackoverflow.com/questions/9324339/how-much-do-two-rectangles-overlap/9325084
 				const auto tl1 = r1.tl();	// blue_triangle
@@ -245,61 +360,36 @@ void dm::DMContentReview::run()
 				const double a1 = r1.area();
 				const double a2 = r2.area();
 				const double intersection_over_union = intersecting_area / std::max(1.0, (a1 + std::min(a2, intersecting_area) - intersecting_area));
-				review_info.overlap_sum += intersection_over_union;
+				overlap_sum += intersection_over_union;
 //				Log(fn + ": intersection_over_union=" + std::to_string(intersection_over_union));
 			}
 
-			if (review_info.overlap_sum >= 1.0)
+			if (overlap_sum >= 1.0)
 			{
 				// we don't care about the overlap we have with ourself (which is exactly 1.0) so subtract that from the total
-				review_info.overlap_sum -= 1.0;
+				overlap_sum -= 1.0;
 
-				if (review_info.overlap_sum >= 0.1) // meaning >= 10%
+				if (overlap_sum >= 0.1) // meaning >= 10%
 				{
-					review_info.warnings.push_back("overlap (intersection over union) seems high");
-//					Log(fn + ": overlap (intersection over union) is " + std::to_string(review_info.overlap_sum));
+					review_info.flags |= kReviewWarningOverlap;
+//					Log(fn + ": overlap (intersection over union) is " + std::to_string(overlap_sum));
 				}
 			}
+			review_info.overlap_sum = overlap_sum;
 
 			const double scaled_width = scale_x * w;
 			const double scaled_height = scale_y * h;
 			if (scaled_width < 16.0 or scaled_height < 16.0)
 			{
-				review_info.warnings.push_back("scaled mark measuring " + std::to_string((int)scaled_width) + "x" + std::to_string((int)scaled_height) + " may be too small to detect");
+				review_info.flags |= kReviewWarningTooSmall;
 //				Log(fn + ": scaled mark measures " + std::to_string((int)scaled_width) + "x" + std::to_string((int)scaled_height));
 			}
 
-			const size_t idx = m[class_idx].size();
-			m[class_idx][idx] = review_info;
+			marks.push_back(review_info);
 		}
 	}
 
 	magic_close(magic_cookie);
 
-	if (threadShouldExit() == false)
-	{
-		Log("review map entries (classes found): " + std::to_string(m.size()));
-		for (const auto & iter : m)
-		{
-			const auto & class_idx = iter.first;
-			const auto & mri = iter.second;
-			Log("review map entries for class #" + std::to_string(class_idx) + ": " + std::to_string(mri.size()));
-		}
-	}
-
-
-	if (not dmapp().review_wnd)
-	{
-		dmapp().review_wnd.reset(new DMReviewWnd(content));
-
-		// start with JUCE 7, setting the always-on-top flag before the window has been fully created and displayed
-		// seems to cause a segfault deep inside JUCE and X
-//		dmapp().review_wnd->setAlwaysOnTop(true);
-	}
-	dmapp().review_wnd->m.swap(m);
-	dmapp().review_wnd->md5s.swap(md5s);
-	dmapp().review_wnd->rebuild_notebook();
-	dmapp().review_wnd->toFront(true);
-
 	return;
 }
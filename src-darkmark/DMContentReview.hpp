@@ -7,6 +7,9 @@
 
 namespace dm
 {
+	/** Build the review information for every mark in the project, and show the results in @ref DMReviewWnd.  The images
+	 * are split between several threads, and the results are merged together in the original image order at the end.
+	 */
 	class DMContentReview : public ThreadWithProgressWindow
 	{
 		public:
@@ -17,6 +20,18 @@ namespace dm
 
 			virtual void run();
 
+			/// Everything found in a single image.
+			struct ImageResult
+			{
+				bool has_json;
+				ReviewImage image;
+				VReviewInfo marks; ///< The image index in these records is set when the results are merged.
+			};
+			typedef std::vector<ImageResult> VImageResults;
+
+			/// Process images until there are none left.  The results for each image are stored in @p results.
+			void worker(VImageResults & results, std::atomic<size_t> & next_image_idx, std::atomic<size_t> & images_processed);
+
 			DMContent & content;
 	};
 }
@@ -3,10 +3,6 @@
 #include "DarkMark.hpp"
 
 
-#include "json.hpp"
-using json = nlohmann::json;
-
-
 dm::DMContentStatistics::DMContentStatistics(dm::DMContent & c) :
 		ThreadWithProgressWindow("Gathering statistics...", true, true),
 		content(c)
@@ -25,8 +21,32 @@ void dm::DMContentStatistics::run()
 {
 	DarkMarkApplication::setup_signal_handling();
 
-	const double max_work = content.image_filenames.size();
-	double work_completed = 0.0;
+	const size_t number_of_images = content.image_filenames.size();
+
+	// each thread gets its own stats which are merged once all of the images have been processed
+	const size_t number_of_threads = std::max(size_t(1), std::min(number_of_images, static_cast<size_t>(std::thread::hardware_concurrency())));
+	std::vector<MStats> thread_stats(number_of_threads);
+	std::atomic<size_t> next_image_idx(0);
+	std::atomic<size_t> images_processed(0);
+
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < number_of_threads; idx ++)
+	{
+		threads.emplace_back(&DMContentStatistics::worker, this, std::ref(thread_stats[idx]), std::ref(next_image_idx), std::ref(images_processed));
+	}
+
+	while (images_processed < number_of_images and threadShouldExit() == false)
+	{
+		setProgress(static_cast<double>(images_processed) / number_of_images);
+		wait(100);
+	}
+
+	for (auto & t : threads)
+	{
+		t.join();
+	}
+
+	content.annotation_index.save();
 
 	MStats m;
 
@@ -37,48 +57,82 @@ void dm::DMContentStatistics::run()
 		m[idx].name = content.names.at(idx);
 	}
 
-	for (const auto & fn : content.image_filenames)
+	for (const auto & stats : thread_stats)
 	{
-		if (threadShouldExit())
+		for (const auto & iter : stats)
 		{
-			break;
+			m[iter.first].merge(iter.second);
 		}
+	}
+
+	// remove the entry for "empty images" if it wasn't used
+	if (m[content.empty_image_name_index].count == 0)
+	{
+		m.erase(content.empty_image_name_index);
+	}
 
-		setProgress(work_completed / max_work);
-		work_completed ++;
+	// calculate the averages, standard deviations, and percentiles for each class
+	for (auto & iter : m)
+	{
+		iter.second.finalize();
+	}
 
-		File f = File(fn).withFileExtension(".json");
-		if (f.existsAsFile())
+	if (not dmapp().stats_wnd)
+	{
+		dmapp().stats_wnd.reset(new DMStatsWnd(content));
+	}
+	dmapp().stats_wnd->m.swap(m);
+	dmapp().stats_wnd->tlb.updateContent();
+	dmapp().stats_wnd->tlb.repaint();
+	dmapp().stats_wnd->toFront(true);
+
+	return;
+}
+
+
+void dm::DMContentStatistics::worker(MStats & m, std::atomic<size_t> & next_image_idx, std::atomic<size_t> & images_processed)
+{
+	DarkMarkApplication::setup_signal_handling();
+
+	while (threadShouldExit() == false)
+	{
+		const size_t image_idx = next_image_idx ++;
+		if (image_idx >= content.image_filenames.size())
 		{
-			json root = json::parse(f.loadFileAsString().toStdString());
+			break;
+		}
+
+		const std::string & fn = content.image_filenames.at(image_idx);
 
+		AnnotationSummary summary = content.annotation_index.get_for_image(fn);
+		if (summary.exists and summary.is_valid)
+		{
 			// if the image is completely empty, then create a "fake" mark covering the entire image
-			if (root.value("completely_empty", false))
+			if (summary.completely_empty)
 			{
-				root["mark"][0]["class_idx"] = content.empty_image_name_index;
-				root["mark"][0]["rect"]["int_w"] = root["image"]["width"];
-				root["mark"][0]["rect"]["int_h"] = root["image"]["height"];
+				MarkSummary empty_mark;
+				empty_mark.class_idx	= content.empty_image_name_index;
+				empty_mark.rect			= cv::Rect(cv::Point(0, 0), summary.image_size);
+				summary.marks = {empty_mark};
 			}
 
 			std::map<size_t, size_t> mark_counter;
 
-			for (auto mark : root["mark"])
+			for (const auto & mark : summary.marks)
 			{
-				const size_t class_idx = mark["class_idx"].get<size_t>();
+				const size_t class_idx = mark.class_idx;
 				Stats & s = m[class_idx];
 				s.count ++;
-				s.filenames.insert(fn);
 
-				const int w = mark["rect"]["int_w"].get<int>();
-				const int h = mark["rect"]["int_h"].get<int>();
+				const int w = mark.rect.width;
+				const int h = mark.rect.height;
 				const int a = w * h;
 
-				s.sum_w += w;
-				s.sum_h += h;
-				s.sum_a += a;
-
-				s.width_counts[w] ++;
-				s.height_counts[h] ++;
+				s.width			.add(w);
+				s.height		.add(h);
+				s.area			.add(a);
+				s.width_sketch	.add(w);
+				s.height_sketch	.add(h);
 
 				mark_counter[class_idx] ++;
 
@@ -103,6 +157,7 @@ void dm::DMContentStatistics::run()
 				const size_t count = iter.second;
 
 				Stats & s = m[class_idx];
+				s.number_of_images ++;
 
 				if (s.min_number_of_marks_per_image == 0 or s.min_number_of_marks_per_image > count)
 				{
@@ -120,63 +175,9 @@ void dm::DMContentStatistics::run()
 				}
 			}
 		}
-	}
 
-	// remove the entry for "empty images" if it wasn't used
-	if (m[content.empty_image_name_index].count == 0)
-	{
-		m.erase(content.empty_image_name_index);
+		images_processed ++;
 	}
 
-	// calculate the averages and standard deviations for each class
-	for (auto iter : m)
-	{
-		if (threadShouldExit())
-		{
-			break;
-		}
-
-		const size_t idx = iter.first;
-		Stats & s = m.at(idx);
-
-		if (s.count > 0)
-		{
-			s.avg_w = double(s.sum_w) / double(s.count);
-			s.avg_h = double(s.sum_h) / double(s.count);
-			s.avg_a = double(s.sum_a) / double(s.count);
-
-			double sum_of_diff_squared = 0.0;
-			for (auto i : s.width_counts)
-			{
-				const double w				= i.first;
-				const size_t count			= i.second;
-				const double diff			= w - s.avg_w;
-				const double diff_squared	= diff * diff;
-				sum_of_diff_squared			+= (count * diff_squared);
-			}
-			s.standard_deviation_width = std::sqrt(sum_of_diff_squared / double(s.count));
-
-			sum_of_diff_squared = 0.0;
-			for (auto i : s.height_counts)
-			{
-				const double h				= i.first;
-				const size_t count			= i.second;
-				const double diff			= h - s.avg_h;
-				const double diff_squared	= diff * diff;
-				sum_of_diff_squared			+= (count * diff_squared);
-			}
-			s.standard_deviation_height = std::sqrt(sum_of_diff_squared / double(s.count));
-		}
-	}
-
-	if (not dmapp().stats_wnd)
-	{
-		dmapp().stats_wnd.reset(new DMStatsWnd(content));
-	}
-	dmapp().stats_wnd->m.swap(m);
-	dmapp().stats_wnd->tlb.updateContent();
-	dmapp().stats_wnd->tlb.repaint();
-	dmapp().stats_wnd->toFront(true);
-
 	return;
 }
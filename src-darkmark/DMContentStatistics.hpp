@@ -7,6 +7,9 @@
 
 namespace dm
 {
+	/** Gather statistics on all the marks in the project, and show the results in @ref DMStatsWnd.  The images are split
+	 * between several threads, and the stats from each thread are merged together at the end.
+	 */
 	class DMContentStatistics : public ThreadWithProgressWindow
 	{
 		public:
@@ -17,6 +20,9 @@ namespace dm
 
 			virtual void run();
 
+			/// Process images until there are none left.  Each worker thread has its own @p m which is merged later.
+			void worker(MStats & m, std::atomic<size_t> & next_image_idx, std::atomic<size_t> & images_processed);
+
 			DMContent & content;
 	};
 }
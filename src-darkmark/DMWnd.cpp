@@ -18,7 +18,7 @@ dm::DMWnd::DMWnd(const std::string & prefix) :
 	setResizable			(true, true	);
 	setDropShadowEnabled	(true		);
 
-	if (dmapp().cli_options.count("editor") and dmapp().cli_options.at("editor") == "gen-darknet")
+	if (dmapp().cli_options.count("editor") and (dmapp().cli_options.at("editor") == "gen-darknet" or dmapp().cli_options.at("editor") == "predict-all"))
 	{
 		show_window = false;
 		content.show_window = false;
@@ -126,6 +126,16 @@ void dm::DMWnd::timerCallback()
 		setMinimised(true);
 		content.show_darknet_window();
 	}
+	else if (action == "predict-all")
+	{
+		setVisible(false);
+		setBounds(0, 0, 0, 0);
+		setMinimised(true);
+		content.predict_all_images();
+
+		// since our sole purpose was to predict all images, we can completely exit from DarkMark
+		dmapp().systemRequestedQuit();
+	}
 	else
 	{
 		content.load_image(0);
@@ -249,6 +249,49 @@ size_t dm::CfgHandler::number_of_anchors_in_yolo()
 }
 
 
+std::vector<dm::VSizet> dm::CfgHandler::yolo_masks(const size_t number_of_anchors)
+{
+	std::vector<VSizet> masks;
+
+	for (const auto section_idx : find_section("yolo"))
+	{
+		VSizet mask;
+
+		const auto idx = find_key_in_section(section_idx, "mask");
+		if (idx == std::string::npos)
+		{
+			for (size_t anchor = 0; anchor < number_of_anchors; anchor ++)
+			{
+				mask.push_back(anchor);
+			}
+		}
+		else
+		{
+			// the line looks like this:  mask = 0,1,2
+			std::smatch what;
+			if (std::regex_match(cfg.at(idx), what, key_value_rx))
+			{
+				std::string str = what.str(2);
+				std::replace(str.begin(), str.end(), ',', ' ');
+				std::stringstream ss(str);
+				size_t anchor = 0;
+				while (ss >> anchor)
+				{
+					if (anchor < number_of_anchors)
+					{
+						mask.push_back(anchor);
+					}
+				}
+			}
+		}
+
+		masks.push_back(mask);
+	}
+
+	return masks;
+}
+
+
 dm::CfgHandler & dm::CfgHandler::output(const dm::ProjectInfo & info)
 {
 	if (cfg.empty())
@@ -37,6 +37,11 @@ namespace dm
 			/// Count the number of anchors in the first [yolo] section.
 			size_t number_of_anchors_in_yolo();
 
+			/** Get the anchor indexes from the @p mask line of each @p [yolo] section, in the order the sections appear.  A
+			 * section without a mask uses all of the anchors.  Indexes which don't refer to one of the anchors are ignored.
+			 */
+			std::vector<VSizet> yolo_masks(const size_t number_of_anchors);
+
 			/// Find the key in the given section, and return the value for that key.
 			float get_value(const size_t start_of_section, const std::string & key);
 
@@ -1,6 +1,8 @@
 // DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
 
+#include <filesystem>
 #include <random>
+#include <set>
 #include "DarkMark.hpp"
 #include "json.hpp"
 using json = nlohmann::json;
@@ -43,6 +45,8 @@ void dm::DarknetWnd::find_all_annotated_images(ThreadWithProgressWindow & progre
 		number_of_marks += count;
 	}
 
+	content.annotation_index.save();
+
 	work_done = 0.0;
 	work_to_do = skipped_images.size() + 1.0;
 	progress_window.setProgress(0.0);
@@ -63,326 +67,606 @@ void dm::DarknetWnd::find_all_annotated_images(ThreadWithProgressWindow & progre
 }
 
 
-void dm::DarknetWnd::resize_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_resized_images, size_t & number_of_images_not_resized, size_t & number_of_marks, size_t & number_of_empty_images)
+void dm::DarknetWnd::generate_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_resized_images, size_t & number_of_images_not_resized, size_t & number_of_tiles_created, size_t & number_of_zooms_created, size_t & number_of_marks, size_t & number_of_empty_images)
 {
-	double work_done = 0.0;
-	double work_to_do = annotated_images.size() + 1.0;
+	const bool enabled[kNumberOfGenerators] =
+	{
+		info.resize_images,
+		info.tile_images,
+		info.zoom_images
+	};
+	const std::string subdirectories[kNumberOfGenerators]	= {"resize"		, "tiles"		, "zoom"		};
+	const std::string log_filenames[kNumberOfGenerators]	= {"resized.txt", "tiles.txt"	, "zoom.txt"	};
 
 	const String sizing = String(info.image_width) + "x" + String(info.image_height);
-	String text = getText("Resizing images to");
-	#if DARKNET_GEN_SIMPLIFIED
-		text = sizing + " " + text + "...";
-	#else
-		text += " " + sizing + "...";
-	#endif
+	auto with_sizing = [&](const String & key)
+	{
+		String text = getText(key);
+		#if DARKNET_GEN_SIMPLIFIED
+			text = sizing + " " + text + "...";
+		#else
+			text += " " + sizing + "...";
+		#endif
+		return text;
+	};
+
+	StringArray messages;
+	if (info.resize_images)
+	{
+		messages.add(with_sizing("Resizing images to"));
+	}
+	if (info.tile_images)
+	{
+		messages.add(with_sizing("Tiling images to"));
+	}
+	if (info.zoom_images)
+	{
+		messages.add(getText("Random image crop and zoom..."));
+	}
 
 	progress_window.setProgress(0.0);
-	progress_window.setStatusMessage(text);
+	progress_window.setStatusMessage(messages.joinIntoString(" "));
 
-	File dir = File(info.project_dir).getChildFile("darkmark_image_cache").getChildFile("resize");
-	const std::string dir_name = dir.getFullPathName().toStdString();
-	dir.createDirectory();
-	if (dir.isDirectory() == false)
+	std::string dir_names[kNumberOfGenerators];
+	for (size_t group = 0; group < kNumberOfGenerators; group ++)
 	{
-		throw std::runtime_error("Failed to create directory " + dir_name + ".");
+		if (enabled[group])
+		{
+			File dir = File(info.project_dir).getChildFile("darkmark_image_cache").getChildFile(subdirectories[group]);
+			dir_names[group] = dir.getFullPathName().toStdString();
+			dir.createDirectory();
+			if (dir.isDirectory() == false)
+			{
+				throw std::runtime_error("Failed to create directory " + dir_names[group] + ".");
+			}
+		}
 	}
 
-	const cv::Size desired_image_size(info.image_width, info.image_height);
+	ImagePipeline pipeline("darknet images");
 
-	std::ofstream resized_txt(dir_name + "/resized.txt");
+	/* Anything which changes the generated images must be part of the key, otherwise images from a previous run would
+	 * be reused when they should have been re-created.  The rest of the key comes from the source image and annotations.
+	 */
+	const std::string sizing_key = std::to_string(info.image_width) + "x" + std::to_string(info.image_height) + " quality=" + std::to_string(pipeline.jpeg_quality);
+	const std::string parameters[kNumberOfGenerators] =
+	{
+		"resize "	+ sizing_key,
+		"tile "		+ sizing_key + " resize=" + std::to_string(info.resize_images),
+		"zoom "		+ sizing_key
+	};
 
-	for (const auto & original_image : annotated_images)
+	auto base_name_for = [&](const ImagePipeline::Item & item, const size_t group)
 	{
-		work_done ++;
-		progress_window.setProgress(work_done / work_to_do);
+		const std::string str = item.key + "|" + parameters[group];
+		const std::string key = MD5(str.c_str(), str.size()).toHexString().toStdString();
 
-		std::stringstream ss;
-		ss << dir_name << "/" << std::setfill('0') << std::setw(8) << all_output_images.size();
-		const std::string output_base_name = ss.str();
-		const std::string output_image = output_base_name + ".jpg";
-		const std::string output_label = output_base_name + ".txt";
-		all_output_images.push_back(output_image);
+		// use a 2-character subdirectory so we don't end up with 100K+ files in a single directory
+		return dir_names[group] + "/" + key.substr(0, 2) + "/" + key;
+	};
 
-		// first we create the resized image file
-		cv::Mat mat = cv::imread(original_image);
-		if (mat.empty())
+	// this is called from several threads at once, so it must not touch anything shared
+	auto prepare = [&](ImagePipeline::Item & item)
+	{
+		// the source image is identified the same way as in the thumbnail cache, while the annotations are identified by content
+		const File image_file(item.source_image);
+		const std::string str =
+			image_file.getFullPathName().toStdString()										+ "|" +
+			std::to_string(image_file.getSize())											+ "|" +
+			std::to_string(image_file.getLastModificationTime().toMilliseconds())			+ "|" +
+			image_file.withFileExtension(".json").loadFileAsString().toStdString()			+ "|" +
+			image_file.withFileExtension(".txt").loadFileAsString().toStdString();
+		item.key = MD5(str.c_str(), str.size()).toHexString().toStdString();
+
+		item.logs.resize(kNumberOfGenerators);
+		item.reused.assign(kNumberOfGenerators, false);
+		item.needs_decoding = false;
+
+		for (size_t group = 0; group < kNumberOfGenerators; group ++)
 		{
-			// something has gone *very* wrong if we cannot read the image
-			Log(original_image + " (" + std::to_string(mat.cols) + "x" + std::to_string(mat.rows) + ")");
-			throw std::runtime_error("failed to open or read the image " + original_image);
+			if (enabled[group])
+			{
+				const std::string base_name = base_name_for(item, group);
+				item.reused[group] = reuse_generated_images(item, group, base_name);
+				if (item.reused[group] == false)
+				{
+					File(base_name).getParentDirectory().createDirectory();
+
+					// images which are already the right size don't need to be decoded to be resized
+					if (group != kResize or link_resized_image(item, base_name) == false)
+					{
+						item.needs_decoding = true;
+					}
+				}
+			}
 		}
+	};
 
-		cv::Mat dst;
-		if (mat.cols != desired_image_size.width or mat.rows != desired_image_size.height)
+	// this is called from several threads at once, so it must not touch anything shared
+	auto transform = [&](ImagePipeline::Item & item)
+	{
+		// the annotations are parsed once and then shared by all of the generators
+		json root = json::parse(File(item.source_image).withFileExtension(".json").loadFileAsString().toStdString());
+		VAnnotations annotations;
+		for (auto j : root["mark"])
 		{
-			cv::resize(mat, dst, desired_image_size, cv::INTER_AREA);
-			number_of_resized_images ++;
+			Annotation annotation;
+			annotation.class_idx	= j["class_idx"].get<int>();
+			annotation.rect			= cv::Rect(
+				j["rect"]["int_x"].get<int>(),
+				j["rect"]["int_y"].get<int>(),
+				j["rect"]["int_w"].get<int>(),
+				j["rect"]["int_h"].get<int>());
+			annotations.push_back(annotation);
 		}
-		else
+
+		// when the resize output is already there, it was either reused or the original image was linked
+		const bool already_resized = std::any_of(item.outputs.begin(), item.outputs.end(), [](const ImagePipeline::Output & output) { return output.group == kResize; });
+
+		if (enabled[kResize] and item.reused[kResize] == false and already_resized == false)
 		{
-			dst = mat;
-			number_of_images_not_resized ++;
+			resize_image(item, annotations, base_name_for(item, kResize));
 		}
+		if (enabled[kTile] and item.reused[kTile] == false)
+		{
+			tile_image(item, annotations, base_name_for(item, kTile));
+		}
+		if (enabled[kZoom] and item.reused[kZoom] == false)
+		{
+			zoom_image(item, annotations, base_name_for(item, kZoom));
+		}
+	};
 
-		resized_txt
-			<< original_image
-			<< " [" << mat.cols << "x" << mat.rows << "] -> "
-			<< output_image
-			<< " [" << dst.cols << "x" << dst.rows << "]"
-			<< std::endl;
-
-		cv::imwrite(output_image, dst, {cv::ImwriteFlags::IMWRITE_JPEG_QUALITY, 75});
+	const auto results = pipeline.run(progress_window, annotated_images, transform, prepare);
+	content.annotation_index.save();
 
-		// next we copy the annoations in the .txt file
-		File txt = File(original_image).withFileExtension(".txt");
-		const bool success = txt.copyFileTo(File(output_label));
-		if (not success)
+	// go through the results one generator at a time so the output images are in the same order as if each generator had its own pass
+	for (size_t group = 0; group < kNumberOfGenerators; group ++)
+	{
+		if (enabled[group] == false)
 		{
-			throw std::runtime_error("Failed to copy " + txt.getFullPathName().toStdString() + ".");
+			continue;
 		}
 
-		if (txt.getSize() == 0)
+		const std::string log_filename = dir_names[group] + "/" + log_filenames[group];
+		std::set<std::string> files_in_use = {log_filename};
+		size_t number_of_images_reused = 0;
+
+		std::ofstream log_txt(log_filename);
+		for (const auto & item : results)
 		{
-			number_of_empty_images ++;
+			log_txt << item.logs[group];
+
+			// remember what was created so the images don't have to be created again the next time
+			const std::string base_name = base_name_for(item, group);
+			if (item.reused[group])
+			{
+				number_of_images_reused ++;
+			}
+			else
+			{
+				save_generated_images(item, group, base_name);
+			}
+			files_in_use.insert(base_name + ".json");
+
+			if (group == kResize)
+			{
+				if (item.modified)
+				{
+					number_of_resized_images ++;
+				}
+				else
+				{
+					number_of_images_not_resized ++;
+				}
+			}
+
+			for (const auto & output : item.outputs)
+			{
+				if (output.group != group)
+				{
+					continue;
+				}
+
+				all_output_images.push_back(output.image_filename);
+				output_source_images[output.image_filename] = item.source_image;
+				files_in_use.insert(output.image_filename);
+				files_in_use.insert(output.label_filename);
+
+				if (output.number_of_marks == 0)
+				{
+					number_of_empty_images ++;
+				}
+				number_of_marks += output.number_of_marks;
+
+				if (group == kTile)
+				{
+					number_of_tiles_created ++;
+				}
+				else if (group == kZoom)
+				{
+					number_of_zooms_created ++;
+				}
+			}
 		}
-		else
+
+		// anything else in the directory is from a previous run and is no longer needed
+		size_t number_of_files_deleted = 0;
+		for (auto & f : File(dir_names[group]).findChildFiles(File::findFiles, true))
 		{
-			json root = json::parse(txt.withFileExtension(".json").loadFileAsString().toStdString());
-			number_of_marks += root["mark"].size();
+			if (files_in_use.count(f.getFullPathName().toStdString()) == 0)
+			{
+				f.deleteFile();
+				number_of_files_deleted ++;
+			}
 		}
+
+		Log(subdirectories[group] + ": " + std::to_string(number_of_images_reused) + " of " + std::to_string(results.size()) + " images reused from the previous run, " + std::to_string(number_of_files_deleted) + " old files deleted");
 	}
 
 	return;
 }
 
 
-void dm::DarknetWnd::tile_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_marks, size_t & number_of_tiles_created, size_t & number_of_empty_images)
+bool dm::DarknetWnd::reuse_generated_images(ImagePipeline::Item & item, const size_t group, const std::string & base_name) const
 {
-	double work_done = 0.0;
-	double work_to_do = annotated_images.size() + 1.0;
+	const File f(base_name + ".json");
+	if (f.existsAsFile() == false)
+	{
+		return false;
+	}
 
-	const String sizing = String(info.image_width) + "x" + String(info.image_height);
-	String text = getText("Tiling images to");
-	#if DARKNET_GEN_SIMPLIFIED
-		text = sizing + " " + text + "...";
-	#else
-		text += " " + sizing + "...";
-	#endif
+	std::vector<ImagePipeline::Output> outputs;
+	bool modified = false;
+	std::string log;
 
-	progress_window.setProgress(0.0);
-	progress_window.setStatusMessage(text);
+	try
+	{
+		const json root = json::parse(f.loadFileAsString().toStdString());
+		modified	= root.at("modified").get<bool>();
+		log			= root.at("log").get<std::string>();
 
-	File dir = File(info.project_dir).getChildFile("darkmark_image_cache").getChildFile("tiles");
-	const std::string dir_name = dir.getFullPathName().toStdString();
-	dir.createDirectory();
-	if (dir.isDirectory() == false)
+		for (const auto & j : root.at("outputs"))
+		{
+			ImagePipeline::Output output;
+			output.group			= group;
+			output.image_filename	= j.at("image").get<std::string>();
+			output.label_filename	= File(output.image_filename).withFileExtension(".txt").getFullPathName().toStdString();
+			output.number_of_marks	= j.at("marks").get<size_t>();
+			output.reused			= true;
+
+			// if someone has been deleting files in the cache then we need to re-create this image
+			if (File(output.image_filename).existsAsFile() == false or File(output.label_filename).existsAsFile() == false)
+			{
+				return false;
+			}
+
+			outputs.push_back(output);
+		}
+	}
+	catch (const std::exception & e)
 	{
-		throw std::runtime_error("Failed to create directory " + dir_name + ".");
+		Log("failed to read " + f.getFullPathName().toStdString() + ": " + e.what());
+		return false;
 	}
 
-	std::ofstream tiles_txt(dir_name + "/tiles.txt");
-	const cv::Size desired_tile_size(info.image_width, info.image_height);
-
-	for (const auto & original_image : annotated_images)
+	item.outputs.insert(item.outputs.end(), outputs.begin(), outputs.end());
+	item.logs[group] = log;
+	if (group == kResize)
 	{
-		work_done ++;
-		progress_window.setProgress(work_done / work_to_do);
+		item.modified = modified;
+	}
+
+	return true;
+}
+
 
-		// first thing we'll do is read the annotations for this image
-		json root = json::parse(File(original_image).withFileExtension(".json").loadFileAsString().toStdString());
+void dm::DarknetWnd::save_generated_images(const ImagePipeline::Item & item, const size_t group, const std::string & base_name) const
+{
+	json root;
+	root["source"]		= item.source_image;
+	root["modified"]	= (group == kResize and item.modified);
+	root["log"]			= item.logs[group];
+	root["outputs"]		= json::array();
 
-		cv::Mat mat = cv::imread(original_image);
-		if (mat.empty())
+	for (const auto & output : item.outputs)
+	{
+		if (output.group == group)
 		{
-			// something has gone *very* wrong if we cannot read the image
-			Log(original_image + " (" + std::to_string(mat.cols) + "x" + std::to_string(mat.rows) + ")");
-			throw std::runtime_error("failed to open or read the image " + original_image);
+			json j;
+			j["image"] = output.image_filename;
+			j["marks"] = output.number_of_marks;
+			root["outputs"].push_back(j);
 		}
+	}
 
-		const double horizontal_factor		= static_cast<double>(mat.cols) / static_cast<double>(desired_tile_size.width);
-		const double vertical_factor		= static_cast<double>(mat.rows) / static_cast<double>(desired_tile_size.height);
-		const size_t horizontal_tiles_count	= std::round(std::max(1.0, horizontal_factor	));
-		const size_t vertical_tiles_count	= std::round(std::max(1.0, vertical_factor		));
-		const double cell_width				= static_cast<double>(mat.cols) / static_cast<double>(horizontal_tiles_count);
-		const double cell_height			= static_cast<double>(mat.rows) / static_cast<double>(vertical_tiles_count);
-
-		tiles_txt
-			<< original_image << " [" << mat.cols << "x" << mat.rows << "]"
-			<< " -> [" << horizontal_tiles_count << "x" << vertical_tiles_count << "]"
-			<< " -> [" << cell_width << "x" << cell_height << "]"
-			<< std::endl;
+	// this file is written last since it is used to know if the generated images exist
+	std::ofstream ofs(base_name + ".json");
+	ofs << root.dump(1, '\t') << std::endl;
 
-		if (info.resize_images and horizontal_tiles_count == 1 and vertical_tiles_count == 1)
-		{
-			// this image only has 1 tile, and we already have it since "resize" is enabled, so skip to the next image
-			tiles_txt << "-> skipped (single tile)" << std::endl;
-			continue;
-		}
+	return;
+}
+
+
+void dm::DarknetWnd::resize_image(ImagePipeline::Item & item, const VAnnotations & annotations, const std::string & base_name) const
+{
+	const cv::Mat & mat = item.mat;
+	const cv::Size desired_image_size(info.image_width, info.image_height);
+
+	ImagePipeline::Output output;
+	output.group			= kResize;
+	output.image_filename	= base_name + ".jpg";
+	output.label_filename	= base_name + ".txt";
+	output.number_of_marks	= 0;
+	output.reused			= false;
+
+	if (mat.cols != desired_image_size.width or mat.rows != desired_image_size.height)
+	{
+		cv::resize(mat, output.mat, desired_image_size, cv::INTER_AREA);
+		item.modified = true;
+	}
+	else
+	{
+		output.mat = mat;
+	}
+
+	// the annotations are normalized so they don't change when the image is resized
+	File txt = File(item.source_image).withFileExtension(".txt");
+	if (txt.existsAsFile() == false)
+	{
+		throw std::runtime_error("Failed to copy " + txt.getFullPathName().toStdString() + ".");
+	}
+	output.labels = txt.loadFileAsString().toStdString();
+
+	if (output.labels.empty() == false)
+	{
+		output.number_of_marks = annotations.size();
+	}
+
+	std::stringstream log;
+	log	<< item.source_image
+		<< " [" << mat.cols << "x" << mat.rows << "] -> "
+		<< output.image_filename
+		<< " [" << output.mat.cols << "x" << output.mat.rows << "]"
+		<< std::endl;
+	item.logs[kResize] += log.str();
+
+	item.outputs.push_back(output);
+
+	return;
+}
+
+
+bool dm::DarknetWnd::link_resized_image(ImagePipeline::Item & item, const std::string & base_name) const
+{
+	const cv::Size image_size = content.annotation_index.get_image_size(item.source_image);
+	if (image_size.width != info.image_width or image_size.height != info.image_height)
+	{
+		return false;
+	}
+
+	const File image_file(item.source_image);
+	const File txt = image_file.withFileExtension(".txt");
+	if (txt.existsAsFile() == false)
+	{
+		throw std::runtime_error("Failed to copy " + txt.getFullPathName().toStdString() + ".");
+	}
+
+	// keep the original extension since the file is not converted to JPEG
+	ImagePipeline::Output output;
+	output.group			= kResize;
+	output.image_filename	= base_name + image_file.getFileExtension().toLowerCase().toStdString();
+	output.label_filename	= base_name + ".txt";
+	output.number_of_marks	= 0;
+	output.reused			= true;
+
+	if (link_or_copy_file(item.source_image, output.image_filename) == false or
+		link_or_copy_file(txt.getFullPathName().toStdString(), output.label_filename) == false)
+	{
+		// don't leave a linked or partially-copied image behind, since resize_image() might write a file with a different extension
+		std::error_code ec;
+		std::filesystem::remove(output.image_filename, ec);
+
+		// let resize_image() decode and write the image instead
+		return false;
+	}
+
+	if (txt.getSize() > 0)
+	{
+		output.number_of_marks = content.annotation_index.get_for_image(item.source_image).marks.size();
+	}
 
-//		Log(original_image + " (" + std::to_string(mat.cols) + "x" + std::to_string(mat.rows) + ") needs to be tiled as " + std::to_string(horizontal_tiles_count) + "x" + std::to_string(vertical_tiles_count) + " tiles each measuring " + std::to_string(desired_tile_size.width) + "x" + std::to_string(desired_tile_size.height));
+	std::stringstream log;
+	log	<< item.source_image
+		<< " [" << image_size.width << "x" << image_size.height << "] -> "
+		<< output.image_filename
+		<< " [linked, no resize needed]"
+		<< std::endl;
+	item.logs[kResize] += log.str();
+
+	item.outputs.push_back(output);
+
+	return true;
+}
+
+
+void dm::DarknetWnd::tile_image(ImagePipeline::Item & item, const VAnnotations & annotations, const std::string & base_name) const
+{
+	const cv::Mat & mat = item.mat;
+	const cv::Size desired_tile_size(info.image_width, info.image_height);
+	const size_t first_output = item.outputs.size();
+	std::stringstream tiles_txt;
+
+	const double horizontal_factor		= static_cast<double>(mat.cols) / static_cast<double>(desired_tile_size.width);
+	const double vertical_factor		= static_cast<double>(mat.rows) / static_cast<double>(desired_tile_size.height);
+	const size_t horizontal_tiles_count	= std::round(std::max(1.0, horizontal_factor	));
+	const size_t vertical_tiles_count	= std::round(std::max(1.0, vertical_factor		));
+	const double cell_width				= static_cast<double>(mat.cols) / static_cast<double>(horizontal_tiles_count);
+	const double cell_height			= static_cast<double>(mat.rows) / static_cast<double>(vertical_tiles_count);
+
+	tiles_txt
+		<< item.source_image << " [" << mat.cols << "x" << mat.rows << "]"
+		<< " -> [" << horizontal_tiles_count << "x" << vertical_tiles_count << "]"
+		<< " -> [" << cell_width << "x" << cell_height << "]"
+		<< std::endl;
+
+	if (info.resize_images and horizontal_tiles_count == 1 and vertical_tiles_count == 1)
+	{
+		// this image only has 1 tile, and we already have it since "resize" is enabled, so skip to the next image
+		tiles_txt << "-> skipped (single tile)" << std::endl;
+		item.logs[kTile] += tiles_txt.str();
+		return;
+	}
 
-		for (size_t y_idx = 0; y_idx < vertical_tiles_count; y_idx ++)
+	for (size_t y_idx = 0; y_idx < vertical_tiles_count; y_idx ++)
+	{
+		for (size_t x_idx = 0; x_idx < horizontal_tiles_count; x_idx ++)
 		{
-			for (size_t x_idx = 0; x_idx < horizontal_tiles_count; x_idx ++)
+			int tile_x = std::round(cell_width	* static_cast<double>(x_idx));
+			int tile_y = std::round(cell_height	* static_cast<double>(y_idx));
+			int tile_w = std::round(cell_width);
+			int tile_h = std::round(cell_height);
+
+			// if a cell is smaller than our desired tile, then we can grab a few more pixels to fill out the tile and get it closer to the desired network size
+			int delta = desired_tile_size.width - tile_w;
+			tile_x -= delta / 2;
+			tile_w += delta;
+
+			// if we moved beyond the right border then move the X coordinate back
+			if (tile_x + tile_w >= mat.cols)
 			{
-				int tile_x = std::round(cell_width	* static_cast<double>(x_idx));
-				int tile_y = std::round(cell_height	* static_cast<double>(y_idx));
-				int tile_w = std::round(cell_width);
-				int tile_h = std::round(cell_height);
-//				Log("-> old tile: x=" + std::to_string(tile_x) + " y=" + std::to_string(tile_y) + " w=" + std::to_string(tile_w) + " h=" + std::to_string(tile_h));
-
-				// if a cell is smaller than our desired tile, then we can grab a few more pixels to fill out the tile and get it closer to the desired network size
-				int delta = desired_tile_size.width - tile_w;
-				tile_x -= delta / 2;
-				tile_w += delta;
-
-				// if we moved beyond the right border then move the X coordinate back
-				if (tile_x + tile_w >= mat.cols)
-				{
-					tile_x = mat.cols - tile_w;
-				}
-
-				// if we moved beyond the *left* border, then reset to zero
-				if (tile_x < 0)
-				{
-					tile_x = 0;
-				}
+				tile_x = mat.cols - tile_w;
+			}
 
-				// make sure the cell width doesn't extend beyond the right border
-				if (tile_x + tile_w >= mat.cols)
-				{
-					tile_w = (mat.cols - tile_x);
-				}
+			// if we moved beyond the *left* border, then reset to zero
+			if (tile_x < 0)
+			{
+				tile_x = 0;
+			}
 
-				delta = desired_tile_size.height - tile_h;
-				tile_y -= delta / 2;
-				tile_h += delta;
+			// make sure the cell width doesn't extend beyond the right border
+			if (tile_x + tile_w >= mat.cols)
+			{
+				tile_w = (mat.cols - tile_x);
+			}
 
-				// if we moved beyond the bottom border then move the Y coordinate back
-				if (tile_y + tile_h >= mat.rows)
-				{
-					tile_y = mat.rows - tile_h;
-				}
+			delta = desired_tile_size.height - tile_h;
+			tile_y -= delta / 2;
+			tile_h += delta;
 
-				// if we moved beyond the *top* border, then reset to zero
-				if (tile_y < 0)
-				{
-					tile_y = 0;
-				}
+			// if we moved beyond the bottom border then move the Y coordinate back
+			if (tile_y + tile_h >= mat.rows)
+			{
+				tile_y = mat.rows - tile_h;
+			}
 
-				// make sure the cell width doesn't extend beyond the bottom border
-				if (tile_y + tile_h >= mat.rows)
-				{
-					tile_h = (mat.rows - tile_y);
-				}
-//				Log("-> new tile: x=" + std::to_string(tile_x) + " y=" + std::to_string(tile_y) + " w=" + std::to_string(tile_w) + " h=" + std::to_string(tile_h));
+			// if we moved beyond the *top* border, then reset to zero
+			if (tile_y < 0)
+			{
+				tile_y = 0;
+			}
 
-				const cv::Rect tile_rect(tile_x, tile_y, tile_w, tile_h);
-				cv::Mat tile = mat(tile_rect);
+			// make sure the cell width doesn't extend beyond the bottom border
+			if (tile_y + tile_h >= mat.rows)
+			{
+				tile_h = (mat.rows - tile_y);
+			}
 
-				std::stringstream ss;
-				ss << dir_name << "/" << std::setfill('0') << std::setw(8) << all_output_images.size();
-				const std::string output_base_name = ss.str();
-				const std::string output_image = output_base_name + ".jpg";
-				const std::string output_label = output_base_name + ".txt";
+			const cv::Rect tile_rect(tile_x, tile_y, tile_w, tile_h);
+			const cv::Mat tile = mat(tile_rect);
 
-				cv::imwrite(output_image, tile, {cv::ImwriteFlags::IMWRITE_JPEG_QUALITY, 75});
-				all_output_images.push_back(output_image);
+			std::stringstream ss;
+			ss << base_name << "_" << std::setfill('0') << std::setw(4) << (item.outputs.size() - first_output);
+			const std::string output_base_name = ss.str();
 
-				// now re-create the .txt file with the appropriate annotations for this new tile
-				//
-				// we know our tile is from (tile_x, tile_y, tile_w, tile_h), so include any annotations within those bounds
-				std::ofstream fs_txt(output_label);
-				fs_txt << std::fixed << std::setprecision(10);
+			ImagePipeline::Output output;
+			output.group			= kTile;
+			output.image_filename	= output_base_name + ".jpg";
+			output.label_filename	= output_base_name + ".txt";
+			output.mat				= tile;
+			output.reused			= false;
+
+			// now re-create the .txt file with the appropriate annotations for this new tile
+			//
+			// we know our tile is from (tile_x, tile_y, tile_w, tile_h), so include any annotations within those bounds
+			std::stringstream fs_txt;
+			fs_txt << std::fixed << std::setprecision(10);
 
-				size_t number_of_annotations = 0;
-				for (auto j : root["mark"])
+			size_t number_of_annotations = 0;
+			for (const auto & annotation : annotations)
+			{
+				const cv::Rect intersection = annotation.rect & tile_rect;
+				if (intersection.area() > 0)
 				{
-					const cv::Rect annotation_rect(j["rect"]["int_x"], j["rect"]["int_y"], j["rect"]["int_w"], j["rect"]["int_h"]);
-					const cv::Rect intersection = annotation_rect & tile_rect;
-					if (intersection.area() > 0)
+					const int class_idx = annotation.class_idx;
+					int x = annotation.rect.x;
+					int y = annotation.rect.y;
+					int w = annotation.rect.width;
+					int h = annotation.rect.height;
+
+					if (x < tile_rect.x)
 					{
-						const int class_idx = j["class_idx"];
-						int x = j["rect"]["int_x"];
-						int y = j["rect"]["int_y"];
-						int w = j["rect"]["int_w"];
-						int h = j["rect"]["int_h"];
-
-						if (x < tile_rect.x)
-						{
-							// X is beyond the left border, we need to move it to the right
-							const int delta_x = tile_rect.x - x;
-							x += delta_x;
-							w -= delta_x;
-						}
-						if (y < tile_rect.y)
-						{
-							const int delta_y = tile_rect.y - y;
-							y += delta_y;
-							h -= delta_y;
-						}
-						if (x + w > tile_rect.x + tile_rect.width)
-						{
-							w = tile_rect.x + tile_rect.width - x;
-						}
-						if (y + h > tile_rect.y + tile_rect.height)
-						{
-							h = tile_rect.y + tile_rect.height - y;
-						}
-
-						// ignore extremely tiny slices
-						if (w >= 10 and h >= 10)
-						{
-							// bring all the coordinates back down to zero
-							x -= tile_rect.x;
-							y -= tile_rect.y;
-
-							const double normalized_w = static_cast<double>(w) / static_cast<double>(tile.cols);
-							const double normalized_h = static_cast<double>(h) / static_cast<double>(tile.rows);
-							const double normalized_x = static_cast<double>(x) / static_cast<double>(tile.cols) + normalized_w / 2.0;
-							const double normalized_y = static_cast<double>(y) / static_cast<double>(tile.rows) + normalized_h / 2.0;
-							fs_txt << class_idx << " " << normalized_x <<  " " << normalized_y << " " << normalized_w << " " << normalized_h << std::endl;
-							number_of_annotations ++;
-						}
+						// X is beyond the left border, we need to move it to the right
+						const int delta_x = tile_rect.x - x;
+						x += delta_x;
+						w -= delta_x;
+					}
+					if (y < tile_rect.y)
+					{
+						const int delta_y = tile_rect.y - y;
+						y += delta_y;
+						h -= delta_y;
+					}
+					if (x + w > tile_rect.x + tile_rect.width)
+					{
+						w = tile_rect.x + tile_rect.width - x;
+					}
+					if (y + h > tile_rect.y + tile_rect.height)
+					{
+						h = tile_rect.y + tile_rect.height - y;
 					}
-				}
 
-				if (number_of_annotations == 0)
-				{
-					number_of_empty_images ++;
+					// ignore extremely tiny slices
+					if (w >= 10 and h >= 10)
+					{
+						// bring all the coordinates back down to zero
+						x -= tile_rect.x;
+						y -= tile_rect.y;
+
+						const double normalized_w = static_cast<double>(w) / static_cast<double>(tile.cols);
+						const double normalized_h = static_cast<double>(h) / static_cast<double>(tile.rows);
+						const double normalized_x = static_cast<double>(x) / static_cast<double>(tile.cols) + normalized_w / 2.0;
+						const double normalized_y = static_cast<double>(y) / static_cast<double>(tile.rows) + normalized_h / 2.0;
+						fs_txt << class_idx << " " << normalized_x <<  " " << normalized_y << " " << normalized_w << " " << normalized_h << std::endl;
+						number_of_annotations ++;
+					}
 				}
-				number_of_marks += number_of_annotations;
-				number_of_tiles_created ++;
-
-				tiles_txt
-					<< "-> " << output_image
-					<< " [" << tile.cols << "x" << tile.rows << "]"
-					<< " [" << number_of_annotations << "/" << root["mark"].size() << "]"
-					<< std::endl;
 			}
+
+			output.labels			= fs_txt.str();
+			output.number_of_marks	= number_of_annotations;
+			item.outputs.push_back(output);
+
+			tiles_txt
+				<< "-> " << output.image_filename
+				<< " [" << tile.cols << "x" << tile.rows << "]"
+				<< " [" << number_of_annotations << "/" << annotations.size() << "]"
+				<< std::endl;
 		}
 	}
 
+	item.logs[kTile] += tiles_txt.str();
+
 	return;
 }
 
 
-void dm::DarknetWnd::random_zoom_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_marks, size_t & number_of_zooms_created, size_t & number_of_empty_images)
+void dm::DarknetWnd::zoom_image(ImagePipeline::Item & item, const VAnnotations & annotations, const std::string & base_name) const
 {
-	double work_done = 0.0;
-	double work_to_do = annotated_images.size() + 1.0;
-	progress_window.setProgress(0.0);
-	progress_window.setStatusMessage(getText("Random image crop and zoom..."));
+	const cv::Mat & original_mat = item.mat;
+	const std::string & original_image = item.source_image;
+	const size_t first_output = item.outputs.size();
+	std::stringstream zoom_txt;
 
-	File dir = File(info.project_dir).getChildFile("darkmark_image_cache").getChildFile("zoom");
-	const std::string dir_name = dir.getFullPathName().toStdString();
-	dir.createDirectory();
-	if (dir.isDirectory() == false)
-	{
-		throw std::runtime_error("Failed to create directory " + dir_name + ".");
-	}
-
-	std::ofstream zoom_txt(dir_name + "/zoom.txt");
 	const cv::Size desired_size(info.image_width, info.image_height);
 
 	/* Images must be larger than the final desired size for us to "zoom in".
@@ -392,252 +676,238 @@ void dm::DarknetWnd::random_zoom_images(ThreadWithProgressWindow & progress_wind
 			std::round(1.25f * desired_size.width),
 			std::round(1.25f * desired_size.height));
 
-	auto & rng = get_random_engine();
+	if (original_mat.cols < large_size.width or original_mat.rows < large_size.height)
+	{
+		zoom_txt
+			<< original_image
+			<< " [" << original_mat.cols << "x" << original_mat.rows << "]"
+			<< " -> skipped (image too small)" << std::endl;
+		item.logs[kZoom] += zoom_txt.str();
+		return;
+	}
 
-	for (const auto & original_image : annotated_images)
+	// the shared random engine is not thread-safe, so each image gets its own engine seeded by the pipeline
+	std::default_random_engine rng(item.seed);
+
+	const cv::Rect original_rect(0, 0, original_mat.cols, original_mat.rows);
+	std::vector<cv::Point> points_of_interest;
+	for (const auto & annotation : annotations)
 	{
-		work_done ++;
-		progress_window.setProgress(work_done / work_to_do);
+		const int x = annotation.rect.x;
+		const int y = annotation.rect.y;
+		const int w = annotation.rect.width;
+		const int h = annotation.rect.height;
 
-		cv::Mat original_mat = cv::imread(original_image);
-		if (original_mat.empty())
+		for (const cv::Point & p :
+			{
+				cv::Point(x + 0, y + 0),	// TL
+				cv::Point(x + w, y + 0),	// TR
+				cv::Point(x + w, y + h),	// BR
+				cv::Point(x + 0, y + h),	// BL
+				cv::Point(x + w/2, y + h/2)	// middle
+			})
 		{
-			// something has gone *very* wrong if we cannot read the image
-			Log(original_image + " (" + std::to_string(original_mat.cols) + "x" + std::to_string(original_mat.rows) + ")");
-			throw std::runtime_error("failed to open or read the image " + original_image);
+			if (original_rect.contains(p))
+			{
+				points_of_interest.push_back(p);
+			}
 		}
+	}
+
+	// the annotations are indexed so each RoI only needs to look at the annotations it overlaps
+	std::vector<cv::Rect> annotation_rects;
+	for (const auto & annotation : annotations)
+	{
+		annotation_rects.push_back(annotation.rect);
+	}
+	SpatialIndex annotation_index;
+	annotation_index.build(annotation_rects);
+
+	// keep creating cropped/zoomed images as long as we're finding new parts of the image that we didn't previously cover
+	SpatialIndex all_previous_rectangles(desired_size);
+	size_t failed_consecutive_attempts = 0;
 
-		if (original_mat.cols < large_size.width or original_mat.rows < large_size.height)
+	while (failed_consecutive_attempts < 5)
+	{
+		/* The amount we're going to "zoom in" depends on exactly how big the image is compared to the final size.
+		 * This value is the "factor" by which we multiply the desired image size.  We need to make sure that both
+		 * the horizontal and vertical values can be satisfied.
+		 */
+		const float horizontal_factor	= static_cast<float>(original_mat.cols) / static_cast<float>(desired_size.width);
+		const float vertical_factor		= static_cast<float>(original_mat.rows) / static_cast<float>(desired_size.height);
+		const float min_factor			= std::min(horizontal_factor, vertical_factor);
+
+		std::uniform_real_distribution<float> uni_f(0.8f, min_factor);
+		const float factor = uni_f(rng);
+
+		// This describes the size of the RoI we're going to carve out of the original image mat.
+		const cv::Size size(
+				std::round(factor * desired_size.width),
+				std::round(factor * desired_size.height));
+
+		// Now that we know the size, we can create the rectangle which is used to carve out the RoI.
+		cv::Rect roi(cv::Point(0, 0), size);
+
+		// Now figure out how much room remains outside of the RoI, and randomly choose some spacing to assign.
+		const int delta_h = original_mat.cols - roi.width;
+		const int delta_v = original_mat.rows - roi.height;
+		std::uniform_int_distribution<int> uni_h(0, delta_h);
+		std::uniform_int_distribution<int> uni_v(0, delta_v);
+		roi.x = uni_h(rng);
+		roi.y = uni_v(rng);
+
+		// See if the middle point of this RoI was already covered by a previous rectangle.
+		bool continue_crop_and_zoom = true;
+		const cv::Point middle_point(roi.x + roi.width/2, roi.y + roi.height/2);
+		if (all_previous_rectangles.find(middle_point).empty() == false)
 		{
-			zoom_txt
-				<< original_image
-				<< " [" << original_mat.cols << "x" << original_mat.rows << "]"
-				<< " -> skipped (image too small)" << std::endl;
-			continue;
+			// we've already covered this point
+			continue_crop_and_zoom = false;
 		}
 
-		const cv::Rect original_rect(0, 0, original_mat.cols, original_mat.rows);
-		json root = json::parse(File(original_image).withFileExtension(".json").loadFileAsString().toStdString());
-		std::vector<cv::Point> points_of_interest;
-		for (auto j : root["mark"])
+		if (continue_crop_and_zoom == false)
 		{
-			const int x = j["rect"]["int_x"];
-			const int y = j["rect"]["int_y"];
-			const int w = j["rect"]["int_w"];
-			const int h = j["rect"]["int_h"];
-
-			for (const cv::Point & p :
-				{
-					cv::Point(x + 0, y + 0),	// TL
-					cv::Point(x + w, y + 0),	// TR
-					cv::Point(x + w, y + h),	// BR
-					cv::Point(x + 0, y + h),	// BL
-					cv::Point(x + w/2, y + h/2)	// middle
-				})
+			// before we give up on this RoI, see if it covers one of the remaining points of interest
+			for (const auto & p : points_of_interest)
 			{
-				if (original_rect.contains(p))
+				if (roi.contains(p))
 				{
-					points_of_interest.push_back(p);
+					zoom_txt << original_image << "-> adding RoI because it includes point-of-interest x=" << p.x << " y=" << p.y << std::endl;
+					continue_crop_and_zoom = true;
+					break;
 				}
 			}
 		}
 
-		// keep creating cropped/zoomed images as long as we're finding new parts of the image that we didn't previously cover
-		std::vector<cv::Rect> all_previous_rectangles;
-		size_t failed_consecutive_attempts = 0;
-
-		while (failed_consecutive_attempts < 5)
+		if (continue_crop_and_zoom == false)
 		{
-			/* The amount we're going to "zoom in" depends on exactly how big the image is compared to the final size.
-			 * This value is the "factor" by which we multiply the desired image size.  We need to make sure that both
-			 * the horizontal and vertical values can be satisfied.
-			 */
-			const float horizontal_factor	= static_cast<float>(original_mat.cols) / static_cast<float>(desired_size.width);
-			const float vertical_factor		= static_cast<float>(original_mat.rows) / static_cast<float>(desired_size.height);
-			const float min_factor			= std::min(horizontal_factor, vertical_factor);
-
-			std::uniform_real_distribution<float> uni_f(0.8f, min_factor);
-			const float factor = uni_f(rng);
-
-			// This describes the size of the RoI we're going to carve out of the original image mat.
-			const cv::Size size(
-					std::round(factor * desired_size.width),
-					std::round(factor * desired_size.height));
-
-			// Now that we know the size, we can create the rectangle which is used to carve out the RoI.
-			cv::Rect roi(cv::Point(0, 0), size);
-
-			// Now figure out how much room remains outside of the RoI, and randomly choose some spacing to assign.
-			const int delta_h = original_mat.cols - roi.width;
-			const int delta_v = original_mat.rows - roi.height;
-			std::uniform_int_distribution<int> uni_h(0, delta_h);
-			std::uniform_int_distribution<int> uni_v(0, delta_v);
-			roi.x = uni_h(rng);
-			roi.y = uni_v(rng);
-
-			// See if the middle point of this RoI was already covered by a previous rectangle.
-			bool continue_crop_and_zoom = true;
-			const cv::Point middle_point(roi.x + roi.width/2, roi.y + roi.height/2);
-			for (const auto & r : all_previous_rectangles)
-			{
-				if (r.contains(middle_point))
-				{
-					// we've already covered this point
-					continue_crop_and_zoom = false;
-					break;
-				}
-			}
+			zoom_txt
+				<< original_image
+				<< " -> skipped RoI [x=" << roi.x << " y=" << roi.y << " w=" << roi.width << " h=" << roi.height << "] due to overlap" << std::endl;
+			failed_consecutive_attempts ++;
+			continue;
+		}
 
-			if (continue_crop_and_zoom == false)
-			{
-				// before we give up on this RoI, see if it covers one of the remaining points of interest
-				for (const auto & p : points_of_interest)
-				{
-					if (roi.contains(p))
-					{
-						zoom_txt << original_image << "-> adding RoI because it includes point-of-interest x=" << p.x << " y=" << p.y << std::endl;
-						continue_crop_and_zoom = true;
-						break;
-					}
-				}
-			}
+		// ...otherise, if we get here then we seem to be covering a new part of the image
+		failed_consecutive_attempts = 0;
+		all_previous_rectangles.insert(roi);
+		zoom_txt
+			<< original_image
+			<< " -> creating RoI from [x=" << roi.x << " y=" << roi.y << " w=" << roi.width << " h=" << roi.height << "]" << std::endl;
 
-			if (continue_crop_and_zoom == false)
+		// remove from "points-of-interest" any points located within the RoI we've just created
+		auto iter = points_of_interest.begin();
+		while (iter != points_of_interest.end())
+		{
+			const auto & p = *iter;
+			if (roi.contains(p))
 			{
-				zoom_txt
-					<< original_image
-					<< " -> skipped RoI [x=" << roi.x << " y=" << roi.y << " w=" << roi.width << " h=" << roi.height << "] due to overlap" << std::endl;
-				failed_consecutive_attempts ++;
-				continue;
+				iter = points_of_interest.erase(iter);
 			}
-
-			// ...otherise, if we get here then we seem to be covering a new part of the image
-			failed_consecutive_attempts = 0;
-			all_previous_rectangles.push_back(roi);
-			zoom_txt
-				<< original_image
-				<< " -> creating RoI from [x=" << roi.x << " y=" << roi.y << " w=" << roi.width << " h=" << roi.height << "]" << std::endl;
-
-			// remove from "points-of-interest" any points located within the RoI we've just created
-			auto iter = points_of_interest.begin();
-			while (iter != points_of_interest.end())
+			else
 			{
-				const auto & p = *iter;
-				if (roi.contains(p))
-				{
-					iter = points_of_interest.erase(iter);
-				}
-				else
-				{
-					iter ++;
-				}
+				iter ++;
 			}
+		}
 
-			// Crop the original image, and at the same time resize it to be the exact dimensions we need.
-			cv::Mat output_mat;
-			cv::resize(original_mat(roi), output_mat, desired_size);
-
-			std::stringstream ss;
-			ss << dir_name << "/" << std::setfill('0') << std::setw(8) << all_output_images.size();
-			const std::string output_base_name = ss.str();
-			const std::string output_image = output_base_name + ".jpg";
-			const std::string output_label = output_base_name + ".txt";
-
-			cv::imwrite(output_image, output_mat, {cv::ImwriteFlags::IMWRITE_JPEG_QUALITY, 75});
-			all_output_images.push_back(output_image);
-
-			// crop the annotations to match the image, and re-calculate the values for the .txt file.
-
-			std::ofstream fs_txt(output_label);
-			fs_txt << std::fixed << std::setprecision(10);
-			size_t number_of_annotations = 0;
-			for (auto j : root["mark"])
-			{
-				int x = j["rect"]["int_x"];
-				int y = j["rect"]["int_y"];
-				int w = j["rect"]["int_w"];
-				int h = j["rect"]["int_h"];
-				const cv::Rect annotation_rect(x, y, w, h);
-				const cv::Rect intersection = annotation_rect & roi;
-				if (intersection.area() == 0)
-				{
-					// this annotation does not appear in our new image
-					continue;
-				}
+		std::stringstream ss;
+		ss << base_name << "_" << std::setfill('0') << std::setw(4) << (item.outputs.size() - first_output);
+		const std::string output_base_name = ss.str();
 
-				const int class_idx = j["class_idx"];
+		ImagePipeline::Output output;
+		output.group			= kZoom;
+		output.image_filename	= output_base_name + ".jpg";
+		output.label_filename	= output_base_name + ".txt";
+		output.reused			= false;
 
-				if (x < roi.x)
-				{
-					// X is beyond the left border, we need to move it to the right
-					int delta = roi.x - x;
-					x += delta;
-					w -= delta;
-				}
-				if (y < roi.y)
-				{
-					// Y is beyond the top border, we need to move it down
-					int delta = roi.y - y;
-					y += delta;
-					h -= delta;
-				}
-				if (x + w > roi.x + roi.width)
-				{
-					// width is beyond the right border
-					w = roi.x + roi.width - x;
-				}
-				if (y + h > roi.y + roi.height)
-				{
-					// height is beyond the bottom border
-					h = roi.y + roi.height - y;
-				}
+		// Crop the original image, and at the same time resize it to be the exact dimensions we need.
+		cv::resize(original_mat(roi), output.mat, desired_size);
 
-				if (w < 5 or h < 5)
-				{
-					// ignore extremely tiny slices of annotations
-					continue;
-				}
+		// crop the annotations to match the image, and re-calculate the values for the .txt file.
 
-				// bring all the coordinates back down to zero
-				x -= roi.x;
-				y -= roi.y;
+		std::stringstream fs_txt;
+		fs_txt << std::fixed << std::setprecision(10);
+		size_t number_of_annotations = 0;
+		for (const auto id : annotation_index.find(roi))
+		{
+			// only the annotations which appear in our new image are returned by the spatial index
+			const cv::Rect & annotation_rect = annotation_rects.at(id);
+			int x = annotation_rect.x;
+			int y = annotation_rect.y;
+			int w = annotation_rect.width;
+			int h = annotation_rect.height;
 
-				const double normalized_w = static_cast<double>(w) / static_cast<double>(roi.width	);
-				const double normalized_h = static_cast<double>(h) / static_cast<double>(roi.height	);
-				const double normalized_x = static_cast<double>(x) / static_cast<double>(roi.width	) + normalized_w / 2.0;
-				const double normalized_y = static_cast<double>(y) / static_cast<double>(roi.height	) + normalized_h / 2.0;
+			const int class_idx = annotations.at(id).class_idx;
 
-				fs_txt << class_idx << " " << normalized_x <<  " " << normalized_y << " " << normalized_w << " " << normalized_h << std::endl;
-				number_of_annotations ++;
+			if (x < roi.x)
+			{
+				// X is beyond the left border, we need to move it to the right
+				int delta = roi.x - x;
+				x += delta;
+				w -= delta;
+			}
+			if (y < roi.y)
+			{
+				// Y is beyond the top border, we need to move it down
+				int delta = roi.y - y;
+				y += delta;
+				h -= delta;
+			}
+			if (x + w > roi.x + roi.width)
+			{
+				// width is beyond the right border
+				w = roi.x + roi.width - x;
+			}
+			if (y + h > roi.y + roi.height)
+			{
+				// height is beyond the bottom border
+				h = roi.y + roi.height - y;
 			}
 
-			if (number_of_annotations == 0)
+			if (w < 5 or h < 5)
 			{
-				number_of_empty_images ++;
+				// ignore extremely tiny slices of annotations
+				continue;
 			}
-			number_of_marks += number_of_annotations;
-			number_of_zooms_created ++;
 
-			zoom_txt
-				<< original_image
-				<< " [" << original_mat.cols << "x" << original_mat.rows << "]"
-				<< " -> " << output_image
-				<< " [f=" << factor
-				<< " x=" << roi.x
-				<< " y=" << roi.y
-				<< " w=" << roi.width
-				<< " h=" << roi.height
-				<< "]"
-				<< " -> [" << output_mat.cols << "x" << output_mat.rows << "]"
-				<< " [" << number_of_annotations << "/" << root["mark"].size() << "]"
-				<< std::endl;
-		}
+			// bring all the coordinates back down to zero
+			x -= roi.x;
+			y -= roi.y;
 
-		if (points_of_interest.empty() == false)
-		{
-			zoom_txt << original_image << " -> still had " << points_of_interest.size() << " items remaining in the points-of-interest" << std::endl;
+			const double normalized_w = static_cast<double>(w) / static_cast<double>(roi.width	);
+			const double normalized_h = static_cast<double>(h) / static_cast<double>(roi.height	);
+			const double normalized_x = static_cast<double>(x) / static_cast<double>(roi.width	) + normalized_w / 2.0;
+			const double normalized_y = static_cast<double>(y) / static_cast<double>(roi.height	) + normalized_h / 2.0;
+
+			fs_txt << class_idx << " " << normalized_x <<  " " << normalized_y << " " << normalized_w << " " << normalized_h << std::endl;
+			number_of_annotations ++;
 		}
+
+		output.labels			= fs_txt.str();
+		output.number_of_marks	= number_of_annotations;
+		item.outputs.push_back(output);
+
+		zoom_txt
+			<< original_image
+			<< " [" << original_mat.cols << "x" << original_mat.rows << "]"
+			<< " -> " << output.image_filename
+			<< " [f=" << factor
+			<< " x=" << roi.x
+			<< " y=" << roi.y
+			<< " w=" << roi.width
+			<< " h=" << roi.height
+			<< "]"
+			<< " -> [" << output.mat.cols << "x" << output.mat.rows << "]"
+			<< " [" << number_of_annotations << "/" << annotations.size() << "]"
+			<< std::endl;
 	}
 
+	if (points_of_interest.empty() == false)
+	{
+		zoom_txt << original_image << " -> still had " << points_of_interest.size() << " items remaining in the points-of-interest" << std::endl;
+	}
+
+	item.logs[kZoom] += zoom_txt.str();
+
 	return;
 }
@@ -210,6 +210,7 @@ dm::DarknetWnd::DarknetWnd(dm::DMContent & c) :
 	percentage_slider			= nullptr;
 	recalculate_anchors_toggle	= nullptr;
 	class_imbalance_toggle		= nullptr;
+	evolve_anchors_toggle		= nullptr;
 
 	setContentNonOwned		(&canvas, true	);
 	setUsingNativeTitleBar	(true			);
@@ -237,6 +238,7 @@ dm::DarknetWnd::DarknetWnd(dm::DMContent & c) :
 	v_train_with_all_images			= info.train_with_all_images;
 	v_training_images_percentage	= std::round(100.0 * info.training_images_percentage);
 	v_limit_validation_images		= info.limit_validation_images;
+	v_group_near_duplicates			= info.group_near_duplicates;
 	v_image_width					= info.image_width;
 	v_image_height					= info.image_height;
 	v_batch_size					= info.batch_size;
@@ -252,6 +254,7 @@ dm::DarknetWnd::DarknetWnd(dm::DMContent & c) :
 	v_recalculate_anchors			= info.recalculate_anchors;
 	v_anchor_clusters				= info.anchor_clusters;
 	v_class_imbalance				= info.class_imbalance;
+	v_evolve_anchors				= info.evolve_anchors;
 	v_restart_training				= info.restart_training;
 	v_delete_temp_weights			= info.delete_temp_weights;
 	v_saturation					= info.saturation;
@@ -371,6 +374,10 @@ dm::DarknetWnd::DarknetWnd(dm::DMContent & c) :
 	setTooltip(b, "Limit the number of validation images to a maximum based on the number of classes.");
 	properties.add(b);
 
+	b = new BooleanPropertyComponent(v_group_near_duplicates, getText("keep similar images together"), getText("keep similar images together"));
+	setTooltip(b, "Images which are near-duplicates of each other (such as consecutive frames from a video) and all of the tiles and zooms created from them will be placed together either in the training images or in the validation images, but never split across both.");
+	properties.add(b);
+
 	pp.addSection(getText("images"), properties, true);
 	properties.clear();
 
@@ -396,10 +403,21 @@ dm::DarknetWnd::DarknetWnd(dm::DMContent & c) :
 			b->setEnabled(false);
 		}
 		properties.add(b);
+
+		b = new BooleanPropertyComponent(v_evolve_anchors, getText("evolve anchors"), getText("evolve anchors"));
+		setTooltip(b, "After recalculating the anchors with k-means, spend some extra time mutating the anchors to increase the number of bounding boxes which are a good match for the anchors in each YOLO section.");
+		evolve_anchors_toggle = b;
+		if (v_recalculate_anchors.getValue().operator bool() == false)
+		{
+			v_evolve_anchors = false;
+			b->setEnabled(false);
+		}
+		properties.add(b);
 	}
 	else
 	{
 		v_class_imbalance = false;
+		v_evolve_anchors = false;
 	}
 
 	pp.addSection(getText("yolo"), properties, false);
@@ -693,6 +711,7 @@ void dm::DarknetWnd::buttonClicked(Button * button)
 	cfg().setValue(content.cfg_prefix + "darknet_train_with_all_images"	, v_train_with_all_images		);
 	cfg().setValue(content.cfg_prefix + "darknet_training_percentage"	, v_training_images_percentage	);
 	cfg().setValue(content.cfg_prefix + "darknet_limit_validation_images",v_limit_validation_images		);
+	cfg().setValue(content.cfg_prefix + "darknet_group_near_duplicates"	, v_group_near_duplicates		);
 	cfg().setValue(content.cfg_prefix + "darknet_image_width"			, v_image_width					);
 	cfg().setValue(content.cfg_prefix + "darknet_image_height"			, v_image_height				);
 	cfg().setValue(content.cfg_prefix + "darknet_batch_size"			, v_batch_size					);
@@ -708,6 +727,7 @@ void dm::DarknetWnd::buttonClicked(Button * button)
 	cfg().setValue(content.cfg_prefix + "darknet_recalculate_anchors"	, v_recalculate_anchors			);
 	cfg().setValue(content.cfg_prefix + "darknet_anchor_clusters"		, v_anchor_clusters				);
 	cfg().setValue(content.cfg_prefix + "darknet_class_imbalance"		, v_class_imbalance				);
+	cfg().setValue(content.cfg_prefix + "darknet_evolve_anchors"		, v_evolve_anchors				);
 	cfg().setValue(content.cfg_prefix + "darknet_restart_training"		, v_restart_training			);
 	cfg().setValue(content.cfg_prefix + "darknet_delete_temp_weights"	, v_delete_temp_weights			);
 	cfg().setValue(content.cfg_prefix + "darknet_saturation"			, v_saturation					);
@@ -724,6 +744,7 @@ void dm::DarknetWnd::buttonClicked(Button * button)
 	info.train_with_all_images		= v_train_with_all_images	.getValue();
 	info.training_images_percentage	= static_cast<double>(v_training_images_percentage.getValue()) / 100.0;
 	info.limit_validation_images	= v_limit_validation_images	.getValue();
+	info.group_near_duplicates		= v_group_near_duplicates	.getValue();
 	info.image_width				= v_image_width				.getValue();
 	info.image_height				= v_image_height			.getValue();
 	info.batch_size					= v_batch_size				.getValue();
@@ -739,6 +760,7 @@ void dm::DarknetWnd::buttonClicked(Button * button)
 	info.recalculate_anchors		= v_recalculate_anchors		.getValue();
 	info.anchor_clusters			= v_anchor_clusters			.getValue();
 	info.class_imbalance			= v_class_imbalance			.getValue();
+	info.evolve_anchors				= v_evolve_anchors			.getValue();
 	info.restart_training			= v_restart_training		.getValue();
 	info.delete_temp_weights		= v_delete_temp_weights		.getValue();
 	info.saturation					= v_saturation				.getValue();
@@ -801,9 +823,14 @@ void dm::DarknetWnd::valueChanged(Value & value)
 		{
 			class_imbalance_toggle->setEnabled(should_be_enabled);
 		}
+		if (evolve_anchors_toggle)
+		{
+			evolve_anchors_toggle->setEnabled(should_be_enabled);
+		}
 		if (should_be_enabled == false)
 		{
 			v_class_imbalance = false;
+			v_evolve_anchors = false;
 		}
 	}
 
@@ -888,42 +915,11 @@ void dm::DarknetWnd::create_Darknet_configuration_file(ThreadWithProgressWindow
 		progress_window.setStatusMessage(dm::getText("Recalculating anchors..."));
 		progress_window.setProgress(0.0);
 
-		/* Make many attempts at figuring out the best anchors.  In tests, I've seen the best anchors found as high
-		 * as the 98th attempt!  Also keep track of the time in case it is taking too long and we want to abort.
-		 */
-		std::time_t now = std::time(nullptr);
-		const std::time_t end_time = now + 30;
-		const size_t max_attempts = 100;
-		float best_avg_iou = 0.0f;
-
-		for (size_t attempt = 0; attempt < max_attempts and std::time(nullptr) < end_time; attempt ++)
-		{
-			progress_window.setProgress(double(attempt) / double(max_attempts));
-
-			std::string counters_per_class;
-			std::string anchors;
-			float avg_iou = 0.0f;
-
-			calc_anchors(info.train_filename, anchor_clusters, info.image_width, info.image_height, number_of_classes, anchors, counters_per_class, avg_iou);
-			if (avg_iou > best_avg_iou)
-			{
-				dm::Log("attempt #" + std::to_string(attempt) + ": avg IoU ........ " + std::to_string(avg_iou));
-				dm::Log("attempt #" + std::to_string(attempt) + ": new anchors .... " + anchors);
-				dm::Log("attempt #" + std::to_string(attempt) + ": new counters ... " + counters_per_class);
-
-				best_avg_iou = avg_iou;
-				m["anchors"] = anchors;
-
-				if (class_imbalance)
-				{
-					m["counters_per_class"] = counters_per_class;
-				}
-			}
-		}
-
 		/* In YOLOv3-tiny and YOLOv4-tiny, there is a typo in the masks.  It
 		 * should be 0,1,2 but instead appears as 1,2,3.  Fix this when the
-		 * user has chosen to re-calculate the anchors.
+		 * user has chosen to re-calculate the anchors.  This needs to be done
+		 * before the anchors are evolved since the masks decide which anchors
+		 * are used by each YOLO section.
 		 *
 		 * https://github.com/AlexeyAB/darknet/issues/7856#issuecomment-874147909
 		 */
@@ -941,6 +937,64 @@ void dm::DarknetWnd::create_Darknet_configuration_file(ThreadWithProgressWindow
 				}
 			}
 		}
+
+		/* Make many attempts at figuring out the best anchors.  In tests, I've seen the best anchors found as high
+		 * as the 98th attempt!  The boxes are only read once, and the attempts are spread across all the cores.
+		 */
+		const AnchorBoxes boxes = load_anchor_boxes(info.train_filename, info.image_width, info.image_height, number_of_classes);
+		if (boxes.size() == 0)
+		{
+			// k-means needs at least one box, and counters_per_class would be all zeros
+			dm::Log("no bounding boxes found in " + info.train_filename + ", so the anchors from the template are not modified");
+		}
+		else
+		{
+			Anchors anchors = kmeans_anchors(boxes, anchor_clusters, 1000, 15.0, dm::get_random_engine()(),
+				[&](const double progress) { progress_window.setProgress(progress); });
+
+			const std::string counters_per_class = counters_to_string(boxes);
+			dm::Log("k-means: " + std::to_string(boxes.size()) + " boxes, " + std::to_string(anchors.restarts) + " restarts, best found on restart #" + std::to_string(anchors.best_restart));
+			dm::Log("k-means: avg IoU ........ " + std::to_string(anchors.avg_iou));
+			dm::Log("k-means: new anchors .... " + anchors_to_string(anchors));
+			dm::Log("k-means: new counters ... " + counters_per_class);
+
+			if (info.evolve_anchors)
+			{
+				progress_window.setStatusMessage(dm::getText("Evolving anchors..."));
+				progress_window.setProgress(0.0);
+
+				const AnchorMasks masks = cfg_handler.yolo_masks(anchor_clusters);
+				const AnchorFitness before = anchor_fitness(boxes, anchors, masks);
+
+				anchors = evolve_anchors(boxes, anchors, masks, width, height, 15.0, dm::get_random_engine()(),
+					[&](const double progress) { progress_window.setProgress(progress); });
+
+				const AnchorFitness after = anchor_fitness(boxes, anchors, masks);
+
+				auto describe = [](const AnchorFitness & f)
+				{
+					std::stringstream ss;
+					ss << std::fixed << std::setprecision(4) << "fitness=" << f.fitness << " BPR=" << f.bpr << " AAT=" << f.aat << " boxes per head=";
+					for (size_t idx = 0; idx < f.boxes_per_head.size(); idx ++)
+					{
+						ss << (idx ? "," : "") << f.boxes_per_head[idx];
+					}
+					return ss.str();
+				};
+
+				dm::Log("evolve: " + std::to_string(anchors.generations) + " generations across " + std::to_string(masks.size()) + " YOLO sections");
+				dm::Log("evolve: before ......... " + describe(before));
+				dm::Log("evolve: after .......... " + describe(after));
+				dm::Log("evolve: avg IoU ........ " + std::to_string(anchors.avg_iou));
+				dm::Log("evolve: new anchors .... " + anchors_to_string(anchors));
+			}
+
+			m["anchors"] = anchors_to_string(anchors);
+			if (class_imbalance)
+			{
+				m["counters_per_class"] = counters_per_class;
+			}
+		}
 	}
 
 	m["classes"] = std::to_string(number_of_classes);
@@ -988,9 +1042,24 @@ void dm::DarknetWnd::create_Darknet_training_and_validation_files(
 	number_of_images_not_resized	= 0;
 	number_of_tiles_created			= 0;
 	number_of_zooms_created			= 0;
+	output_source_images.clear();
 
+	// the thumbnails are not related to the darknet files, and generate_images() reuses and cleans up the images it
+	// needs, so only delete the output of the generators which are no longer enabled
 	File dir = File(info.project_dir).getChildFile("darkmark_image_cache");
-	dir.deleteRecursively();
+	const std::map<std::string, bool> subdirectories =
+	{
+		{"resize"	, info.resize_images	},
+		{"tiles"	, info.tile_images		},
+		{"zoom"		, info.zoom_images		}
+	};
+	for (const auto & iter : subdirectories)
+	{
+		if (iter.second == false)
+		{
+			dir.getChildFile(iter.first).deleteRecursively();
+		}
+	}
 
 	// these vectors will have the full path of the images we need to use (or which have been skipped)
 	VStr negative_samples;
@@ -1018,24 +1087,24 @@ void dm::DarknetWnd::create_Darknet_training_and_validation_files(
 		number_of_empty_images = 0;
 	}
 
-	if (info.resize_images)
-	{
-		Log("resizing all images");
-		resize_images(progress_window, annotated_images, all_output_images, number_of_resized_images, number_of_images_not_resized, number_of_marks, number_of_empty_images);
-		Log("number of images resized ................. " + std::to_string(number_of_resized_images		));
-		Log("number of images not resized ............. " + std::to_string(number_of_images_not_resized	));
-	}
-	if (info.tile_images)
+	if (info.resize_images or info.tile_images or info.zoom_images)
 	{
-		Log("tiling all images");
-		tile_images(progress_window, annotated_images, all_output_images, number_of_marks, number_of_tiles_created, number_of_empty_images);
-		Log("number of tiles created .................. " + std::to_string(number_of_tiles_created));
-	}
-	if (info.zoom_images)
-	{
-		Log("crop+zoom all images");
-		random_zoom_images(progress_window, annotated_images, all_output_images, number_of_marks, number_of_zooms_created, number_of_empty_images);
-		Log("number of crop+zoom images created ....... " + std::to_string(number_of_zooms_created));
+		Log("creating images (resize=" + std::to_string(info.resize_images) + " tile=" + std::to_string(info.tile_images) + " crop+zoom=" + std::to_string(info.zoom_images) + ")");
+		generate_images(progress_window, annotated_images, all_output_images, number_of_resized_images, number_of_images_not_resized, number_of_tiles_created, number_of_zooms_created, number_of_marks, number_of_empty_images);
+
+		if (info.resize_images)
+		{
+			Log("number of images resized ................. " + std::to_string(number_of_resized_images		));
+			Log("number of images not resized ............. " + std::to_string(number_of_images_not_resized	));
+		}
+		if (info.tile_images)
+		{
+			Log("number of tiles created .................. " + std::to_string(number_of_tiles_created));
+		}
+		if (info.zoom_images)
+		{
+			Log("number of crop+zoom images created ....... " + std::to_string(number_of_zooms_created));
+		}
 	}
 
 	std::shuffle(all_output_images.begin(), all_output_images.end(), get_random_engine());
@@ -1114,6 +1183,14 @@ void dm::DarknetWnd::create_Darknet_training_and_validation_files(
 		}
 	}
 
+	if (info.group_near_duplicates and not use_all_images)
+	{
+		// the validation cap is applied when choosing the group boundary so no images are left out of both files
+		group_near_duplicate_images(progress_window, all_output_images, number_of_files_train, info.limit_validation_images ? maximum_number_of_validation_images : all_output_images.size());
+		number_of_files_valid = all_output_images.size() - number_of_files_train;
+		progress_window.setStatusMessage(dm::getText("Writing training and validation files..."));
+	}
+
 	number_of_annotated_images = all_output_images.size() - number_of_empty_images;
 	Log("total number of annotated images ......... " + std::to_string(number_of_annotated_images	));
 	Log("total number of marks .................... " + std::to_string(number_of_marks				));
@@ -1153,6 +1230,109 @@ void dm::DarknetWnd::create_Darknet_training_and_validation_files(
 }
 
 
+void dm::DarknetWnd::group_near_duplicate_images(ThreadWithProgressWindow & progress_window, VStr & all_output_images, size_t & number_of_files_train, const size_t maximum_number_of_validation_images)
+{
+	if (number_of_files_train == 0 or number_of_files_train >= all_output_images.size())
+	{
+		// all the images are on the same side of the split, so there is nothing to keep apart
+		return;
+	}
+
+	double work_done = 0.0;
+	double work_to_do = all_output_images.size() + 1.0;
+	progress_window.setProgress(0.0);
+	progress_window.setStatusMessage(dm::getText("Finding similar images..."));
+
+	// find the original images, in the order in which they first appear in the (already shuffled) output images
+	VStr source_images;
+	std::map<std::string, size_t> source_index;
+	VSizet output_to_source;
+	for (const auto & fn : all_output_images)
+	{
+		const std::string & source = (output_source_images.count(fn) ? output_source_images.at(fn) : fn);
+		if (source_index.count(source) == 0)
+		{
+			source_index[source] = source_images.size();
+			source_images.push_back(source);
+		}
+		output_to_source.push_back(source_index.at(source));
+	}
+
+	// the perceptual hash is normally already in the thumbnail cache
+	std::vector<uint64_t> hashes;
+	for (const auto & fn : source_images)
+	{
+		work_done ++;
+		progress_window.setProgress(work_done / work_to_do);
+
+		ThumbnailCache::Info thumbnail_info;
+		if (content.thumbnail_cache.get_info(fn, thumbnail_info) == false)
+		{
+			cv::Mat mat = cv::imread(fn);
+			thumbnail_info.dhash = 0;
+			if (mat.empty() == false)
+			{
+				thumbnail_info = content.thumbnail_cache.create(fn, mat);
+			}
+		}
+		hashes.push_back(thumbnail_info.dhash);
+	}
+
+	const auto groups = group_near_duplicates(hashes, cfg().get_int("near_duplicate_distance"));
+
+	// keep the groups in the order in which they first appear so the output is still shuffled
+	std::map<size_t, VStr> group_images;
+	VSizet group_order;
+	for (size_t idx = 0; idx < all_output_images.size(); idx ++)
+	{
+		const size_t group = groups.at(output_to_source.at(idx));
+		if (group_images.count(group) == 0)
+		{
+			group_order.push_back(group);
+		}
+		group_images[group].push_back(all_output_images.at(idx));
+	}
+
+	/* Rebuild the list of images one group at a time, and find the group boundary closest to the original split.  Both
+	 * sides of the split must have images, and boundaries which would put too many images in the validation set are
+	 * skipped, meaning those groups go into the training set instead.
+	 */
+	const auto distance = [&](const size_t split) { return std::abs(static_cast<double>(split) - static_cast<double>(number_of_files_train)); };
+	VStr output;
+	size_t best_split = 0;
+	for (const auto & group : group_order)
+	{
+		const auto & v = group_images.at(group);
+		output.insert(output.end(), v.begin(), v.end());
+
+		const size_t split = output.size();
+		if (split < all_output_images.size() and all_output_images.size() - split <= maximum_number_of_validation_images)
+		{
+			if (best_split == 0 or distance(split) < distance(best_split))
+			{
+				best_split = split;
+			}
+		}
+	}
+
+	Log("near-duplicate groups .................... " + std::to_string(group_order.size()) + " groups for " + std::to_string(source_images.size()) + " source images");
+
+	if (best_split == 0)
+	{
+		// for example, a single group which contains most of the images
+		Log("Warning: cannot keep similar images together without leaving the training or validation set empty, so the images have not been grouped");
+		return;
+	}
+
+	Log("training images moved to keep groups together: " + std::to_string(static_cast<long>(best_split) - static_cast<long>(number_of_files_train)));
+
+	all_output_images.swap(output);
+	number_of_files_train = best_split;
+
+	return;
+}
+
+
 void dm::DarknetWnd::create_Darknet_shell_scripts()
 {
 	if (simplified_interface)
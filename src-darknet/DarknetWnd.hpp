@@ -42,22 +42,69 @@ namespace dm
 
 			void find_all_annotated_images(ThreadWithProgressWindow & progress_window, VStr & annotated_images, VStr & skipped_images, size_t & number_of_marks, size_t & number_of_empty_images);
 
-			void resize_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_resized_images, size_t & number_of_images_not_resized, size_t & number_of_marks, size_t & number_of_empty_images);
-
-			void tile_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_marks, size_t & number_of_tiles_created, size_t & number_of_empty_images);
-
-			void random_zoom_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_marks, size_t & number_of_zooms_created, size_t & number_of_empty_images);
+			/// The different kinds of images which can be created from each annotated image.
+			enum Generator
+			{
+				kResize		,
+				kTile		,
+				kZoom		,
+				kNumberOfGenerators
+			};
+
+			/// Annotation read from the .json file of an annotated image, in image coordinates.
+			struct Annotation
+			{
+				int class_idx;
+				cv::Rect rect;
+			};
+			typedef std::vector<Annotation> VAnnotations;
+
+			/** Create the resized, tiled, and zoomed images.  This is done in a single pass, so each annotated image is only
+			 * decoded and its annotations parsed once regardless of how many of the generators are enabled.  Images are named
+			 * using a hash of the source image, the annotations, and the generator parameters, so images from the previous run
+			 * are reused when nothing has changed.
+			 */
+			void generate_images(ThreadWithProgressWindow & progress_window, const VStr & annotated_images, VStr & all_output_images, size_t & number_of_resized_images, size_t & number_of_images_not_resized, size_t & number_of_tiles_created, size_t & number_of_zooms_created, size_t & number_of_marks, size_t & number_of_empty_images);
+
+			/// Called from the image pipeline threads.  These must not modify anything shared.  @{
+			void resize_image(ImagePipeline::Item & item, const VAnnotations & annotations, const std::string & base_name) const;
+			void tile_image(ImagePipeline::Item & item, const VAnnotations & annotations, const std::string & base_name) const;
+			void zoom_image(ImagePipeline::Item & item, const VAnnotations & annotations, const std::string & base_name) const;
+
+			/** Called instead of @ref resize_image() when the dimensions in the image file header show the image is already the
+			 * right size, in which case the original image is linked into the cache without being decoded or re-encoded.
+			 * @returns @p false if the image needs to be resized.
+			 */
+			bool link_resized_image(ImagePipeline::Item & item, const std::string & base_name) const;
+
+			/// Add the outputs which were created by a previous run.  @returns @p false if the images need to be created.
+			bool reuse_generated_images(ImagePipeline::Item & item, const size_t group, const std::string & base_name) const;
+
+			/// Remember the outputs which were created so they can be reused by the next run.
+			void save_generated_images(const ImagePipeline::Item & item, const size_t group, const std::string & base_name) const;
+			/// @}
+
+			/** Re-order the output images so images created from near-duplicate source images are all on the same side of
+			 * the split between training and validation images, and move the split to the nearest group boundary which
+			 * doesn't result in more than @p maximum_number_of_validation_images.  If no such boundary leaves images on both
+			 * sides of the split, then the images and the split are left as they were.
+			 */
+			void group_near_duplicate_images(ThreadWithProgressWindow & progress_window, VStr & all_output_images, size_t & number_of_files_train, const size_t maximum_number_of_validation_images);
 
 			void create_Darknet_configuration_file(ThreadWithProgressWindow & progress_window);
 			void create_Darknet_shell_scripts();
 
 			CfgHandler cfg_handler;
 
+			/// Key is the resized, tiled, or zoomed image, value is the original image from which it was created.
+			MStr output_source_images;
+
 			Value v_darknet_dir;
 			Value v_cfg_template;
 			Value v_train_with_all_images;
 			Value v_training_images_percentage;
 			Value v_limit_validation_images;
+			Value v_group_near_duplicates;
 			Value v_image_width;
 			Value v_image_height;
 			Value v_batch_size;
@@ -73,6 +120,7 @@ namespace dm
 			Value v_recalculate_anchors;
 			Value v_anchor_clusters;
 			Value v_class_imbalance;
+			Value v_evolve_anchors;
 			Value v_restart_training;
 			Value v_delete_temp_weights;
 			Value v_saturation;
@@ -97,5 +145,6 @@ namespace dm
 			SliderPropertyComponent * percentage_slider;
 			BooleanPropertyComponent * recalculate_anchors_toggle;
 			BooleanPropertyComponent * class_imbalance_toggle;
+			BooleanPropertyComponent * evolve_anchors_toggle;
 	};
 }
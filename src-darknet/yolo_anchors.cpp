@@ -1,12 +1,18 @@
 // DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <fstream>
 #include <limits>
+#include <mutex>
+#include <numeric>
 #include <random>
 #include <string>
+#include <thread>
 #include <vector>
-#include <map>
+#include <stdexcept>
 #include "yolo_anchors.hpp"
 #include "Tools.hpp"
 
@@ -27,254 +33,255 @@ struct box_label
 typedef std::vector<box_label> Boxes;
 
 
-struct matrix
+static bool read_boxes(const std::string & filename, Boxes & boxes)
 {
-	size_t rows;
-	size_t cols;
-	VFloat vals;
+	boxes.clear();
 
-	matrix(const size_t r, const size_t c)
-	{
-		rows = r;
-		cols = c;
-		vals = VFloat(std::max<size_t>(1lu, r * c), 0.0f);
-		return;
-	}
-
-	matrix() : matrix(0, 0)
-	{
-		return;
-	}
-
-	float & row_and_col(const size_t r, const size_t c)
+	std::ifstream ifs(filename);
+	while (ifs.good())
 	{
-		if (rows == 0 or cols == 0)
-		{
-			throw std::invalid_argument("cannot get cell r=" + std::to_string(r) + " c=" + std::to_string(c) + " when rows=" + std::to_string(rows) + " and cols=" + std::to_string(cols));
-		}
-		if (r >= rows or c >= cols)
+		box_label box;
+		ifs >> box.class_idx >> box.x >> box.y >> box.w >> box.h;
+		if (ifs.eof())
 		{
-			throw std::invalid_argument("invalid cell r=" + std::to_string(r) + " c=" + std::to_string(c) + " when rows=" + std::to_string(rows) + " and cols=" + std::to_string(cols));
+			// ran into EOF, meaning we didn't read all 5 entries we need, don't use this entry!
+			break;
 		}
-
-		return vals.at(r * cols + c);
+		boxes.push_back(box);
 	}
 
-	float * row(const size_t r)
-	{
-		return & row_and_col(r, 0);
-	}
-};
+	return boxes.empty() == false;
+}
 
 
-struct model
+static inline float iou(const float box_w, const float box_h, const float anchor_w, const float anchor_h)
 {
-	VInt assignments;
-	matrix centers;
-};
-
+	const float min_w			= (box_w < anchor_w) ? box_w : anchor_w;
+	const float min_h			= (box_h < anchor_h) ? box_h : anchor_h;
+	const float box_intersect	= min_w * min_h;
+	const float box_union		= box_w * box_h + anchor_w * anchor_h - box_intersect;
 
-float dist(float *x, float *y, int n)
-{
-	float mw = (x[0] < y[0]) ? x[0] : y[0];
-	float mh = (x[1] < y[1]) ? x[1] : y[1];
-	float inter = mw * mh;
-	float sum = x[0] * x[1] + y[0] * y[1];
-	float un = sum - inter;
-	float iou = inter / un;
-
-	return 1.0f - iou;
+	return box_intersect / box_union;
 }
 
 
-VInt random_samples(const size_t maximum_number_of_samples)
+/** Seed the centers using k-means++, where each new center is chosen from the boxes with a probability proportional to the
+ * square of the distance (1 - IoU) to the closest center chosen so far.
+ */
+static void kmeans_plus_plus(const AnchorBoxes & boxes, VFloat & center_w, VFloat & center_h, std::mt19937 & rng)
 {
-	VInt v;
-	v.reserve(maximum_number_of_samples);
-	while (v.size() < maximum_number_of_samples)
-	{
-		v.push_back(v.size());
-	}
+	const size_t number_of_boxes	= boxes.size();
+	const size_t number_of_clusters	= center_w.size();
+	const float * w					= boxes.widths.data();
+	const float * h					= boxes.heights.data();
 
-	#if 0
-	//
-	// If using a stand-alone version of yolo anchors, you'll have to use this
-	// (or something similar) as your random number generator.
-	//
-	std::random_device rd;
-	std::mt19937 rng(rd());
-	#else
-	auto & rng = dm::get_random_engine();
-	#endif
+	VFloat min_dist(number_of_boxes, std::numeric_limits<float>::max());
 
-	std::shuffle(v.begin(), v.end(), rng);
-
-	return v;
-}
-
-
-void random_centers(matrix & data, matrix & centers)
-{
-	const VInt s = random_samples(data.rows);
-	for (size_t row = 0; row < centers.rows; row ++)
+	size_t idx = std::uniform_int_distribution<size_t>(0, number_of_boxes - 1)(rng);
+	for (size_t j = 0; j < number_of_clusters; j ++)
 	{
-		for (size_t col = 0; col < data.cols; col ++)
+		center_w[j] = w[idx];
+		center_h[j] = h[idx];
+		if (j + 1 == number_of_clusters)
 		{
-			centers.row_and_col(row, col) = data.row_and_col(s[row], col);
+			break;
 		}
-	}
 
-	return;
-}
+		const float cw = center_w[j];
+		const float ch = center_h[j];
+		double total = 0.0;
+		for (size_t i = 0; i < number_of_boxes; i ++)
+		{
+			const float d = 1.0f - iou(w[i], h[i], cw, ch);
+			min_dist[i] = (d < min_dist[i]) ? d : min_dist[i];
+			total += min_dist[i] * min_dist[i];
+		}
 
+		if (total <= 0.0)
+		{
+			// every box is identical to one of the centers, so there is nothing left to spread out
+			idx = std::uniform_int_distribution<size_t>(0, number_of_boxes - 1)(rng);
+			continue;
+		}
 
-int closest_center(float *datum, matrix & centers)
-{
-	int best = 0;
-	float best_dist = dist(datum, centers.row(best), centers.cols);
-	for (size_t j = 0; j < centers.rows; ++j)
-	{
-		float new_dist = dist(datum, centers.row(j), centers.cols);
-		if (new_dist < best_dist)
+		double target = std::uniform_real_distribution<double>(0.0, total)(rng);
+		idx = number_of_boxes - 1;
+		for (size_t i = 0; i < number_of_boxes; i ++)
 		{
-			best_dist = new_dist;
-			best = j;
+			target -= min_dist[i] * min_dist[i];
+			if (target < 0.0)
+			{
+				idx = i;
+				break;
+			}
 		}
 	}
 
-	return best;
+	return;
 }
 
 
-int kmeans_expectation(matrix & data, VInt & assignments, matrix & centers)
+/** Assign each box to the closest center.  The outer loop is over the centers and the inner loop over the boxes so the
+ * inner loop is branchless, works on contiguous arrays, and can be auto-vectorized by the compiler.
+ *
+ * @returns @p true if none of the assignments changed.
+ */
+static bool kmeans_expectation(const AnchorBoxes & boxes, const VFloat & center_w, const VFloat & center_h, VInt & assignments, VInt & closest, VFloat & best_dist)
 {
-	int converged = 1;
-	for (size_t i = 0; i < data.rows; ++i)
+	const size_t number_of_boxes	= boxes.size();
+	const size_t number_of_clusters	= center_w.size();
+	const float * w					= boxes.widths.data();
+	const float * h					= boxes.heights.data();
+	int * c							= closest.data();
+	float * best					= best_dist.data();
+
+	std::fill(best_dist.begin(), best_dist.end(), std::numeric_limits<float>::max());
+	std::fill(closest.begin(), closest.end(), 0);
+
+	for (size_t j = 0; j < number_of_clusters; j ++)
 	{
-		int closest = closest_center(data.row(i), centers);
-		if (closest != assignments[i])
+		const float cw		= center_w[j];
+		const float ch		= center_h[j];
+		const float c_area	= cw * ch;
+		const int cluster	= j;
+
+		for (size_t i = 0; i < number_of_boxes; i ++)
 		{
-			converged = 0;
+			const float min_w	= (w[i] < cw) ? w[i] : cw;
+			const float min_h	= (h[i] < ch) ? h[i] : ch;
+			const float inter	= min_w * min_h;
+			const float d		= 1.0f - inter / (w[i] * h[i] + c_area - inter);
+			const bool closer	= d < best[i];
+			best[i]				= closer ? d : best[i];
+			c[i]				= closer ? cluster : c[i];
 		}
-		assignments[i] = closest;
 	}
 
+	const bool converged = (closest == assignments);
+	assignments.swap(closest);
+
 	return converged;
 }
 
 
-void kmeans_maximization(matrix & data, VInt & assignments, matrix & centers)
+/// Move each center to the mean of the boxes assigned to it.  Centers without any boxes are left where they are.
+static void kmeans_maximization(const AnchorBoxes & boxes, const VInt & assignments, VFloat & center_w, VFloat & center_h)
 {
-	matrix old_centers(centers.rows, centers.cols);
+	const size_t number_of_clusters = center_w.size();
 
-	VInt counts(centers.rows, 0);
+	std::vector<double> sum_w(number_of_clusters, 0.0);
+	std::vector<double> sum_h(number_of_clusters, 0.0);
+	std::vector<size_t> counts(number_of_clusters, 0);
 
-	for (size_t i = 0; i < centers.rows; ++i)
+	for (size_t i = 0; i < boxes.size(); i ++)
 	{
-		for (size_t j = 0; j < centers.cols; ++j)
-		{
-			old_centers.row_and_col(i, j) = centers.row_and_col(i, j);
-			centers.row_and_col(i, j) = 0;
-		}
+		const int cluster = assignments[i];
+		sum_w[cluster] += boxes.widths[i];
+		sum_h[cluster] += boxes.heights[i];
+		counts[cluster] ++;
 	}
 
-	for (size_t i = 0; i < data.rows; ++i)
+	for (size_t j = 0; j < number_of_clusters; j ++)
 	{
-		++counts[assignments[i]];
-		for (size_t j = 0; j < data.cols; ++j)
+		if (counts[j])
 		{
-			centers.row_and_col(assignments[i], j) += data.row_and_col(i, j);
+			center_w[j] = sum_w[j] / counts[j];
+			center_h[j] = sum_h[j] / counts[j];
 		}
 	}
 
-	for (size_t i = 0; i < centers.rows; ++i)
+	return;
+}
+
+
+/** Average IoU as a percentage between each box and the closest anchor.  Same as the original Darknet code, boxes which
+ * don't overlap any anchor or which perfectly match an anchor are not added to the sum but are still counted.
+ */
+static float average_iou(const AnchorBoxes & boxes, const VFloat & center_w, const VFloat & center_h)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < boxes.size(); i ++)
 	{
-		if (counts[i])
+		float best_iou = 0.0f;
+		for (size_t j = 0; j < center_w.size(); j ++)
 		{
-			for (size_t j = 0; j < centers.cols; ++j)
-			{
-				centers.row_and_col(i, j) /= counts[i];
-			}
+			best_iou = std::max(best_iou, iou(boxes.widths[i], boxes.heights[i], center_w[j], center_h[j]));
 		}
-	}
 
-	for (size_t i = 0; i < centers.rows; ++i)
-	{
-		for (size_t j = 0; j < centers.cols; ++j)
+		if (best_iou > 0.0f and best_iou < 1.0f)
 		{
-			if(centers.row_and_col(i, j) == 0)
-			{
-				centers.row_and_col(i, j) = old_centers.row_and_col(i, j);
-			}
+			sum += best_iou;
 		}
 	}
 
-	return;
+	return 100.0 * sum / static_cast<double>(boxes.size());
 }
 
 
-model do_kmeans(matrix & data, const size_t number_of_clusters)
+/// Sort the anchors by area, from smallest to largest.
+static void sort_by_area(Anchors & anchors)
 {
-	matrix centers(number_of_clusters, data.cols);
-
-	VInt assignments(data.rows, 0);
-
-	random_centers(data, centers);
+	std::vector<size_t> order(anchors.widths.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](const size_t lhs, const size_t rhs) { return anchors.widths[lhs] * anchors.heights[lhs] < anchors.widths[rhs] * anchors.heights[rhs]; });
 
-	for (int i = 0; i < 1000 and not kmeans_expectation(data, assignments, centers); ++i)
+	const VFloat w = anchors.widths;
+	const VFloat h = anchors.heights;
+	for (size_t idx = 0; idx < order.size(); idx ++)
 	{
-		kmeans_maximization(data, assignments, centers);
+		anchors.widths[idx]		= w[order[idx]];
+		anchors.heights[idx]	= h[order[idx]];
 	}
 
-	model m;
-	m.assignments = assignments;
-	m.centers = centers;
-
-	return m;
+	return;
 }
 
 
-Boxes read_boxes(const std::string & filename)
+/// A single k-means attempt.  Each restart uses its own random engine so the results are the same regardless of threads.
+static Anchors do_kmeans(const AnchorBoxes & boxes, const size_t number_of_clusters, const uint32_t seed, const size_t restart)
 {
-	Boxes boxes;
-	boxes.reserve(20);
-
-	std::ifstream ifs(filename);
-	while (ifs.good())
+	std::seed_seq seq{seed, static_cast<uint32_t>(restart)};
+	std::mt19937 rng(seq);
+
+	Anchors anchors;
+	anchors.widths			.resize(number_of_clusters, 0.0f);
+	anchors.heights			.resize(number_of_clusters, 0.0f);
+	anchors.restarts		= 1;
+	anchors.best_restart	= restart;
+	anchors.generations		= 0;
+
+	kmeans_plus_plus(boxes, anchors.widths, anchors.heights, rng);
+
+	VInt assignments(boxes.size(), -1);
+	VInt closest(boxes.size(), 0);
+	VFloat best_dist(boxes.size(), 0.0f);
+	for (int i = 0; i < 1000 and not kmeans_expectation(boxes, anchors.widths, anchors.heights, assignments, closest, best_dist); ++i)
 	{
-		box_label box;
-		ifs >> box.class_idx >> box.x >> box.y >> box.w >> box.h;
-		if (ifs.eof())
-		{
-			// ran into EOF, meaning we didn't read all 5 entries we need, don't use this entry!
-			break;
-		}
-		boxes.push_back(box);
+		kmeans_maximization(boxes, assignments, anchors.widths, anchors.heights);
 	}
 
-	return boxes;
+	anchors.avg_iou = average_iou(boxes, anchors.widths, anchors.heights);
+
+	return anchors;
 }
 
 
-void calc_anchors(const std::string & train_images_filename, const size_t number_of_clusters, const size_t width, const size_t height, const size_t number_of_classes, std::string & new_anchors, std::string & new_counters_per_class, float & new_avg_iou)
+AnchorBoxes load_anchor_boxes(const std::string & train_images_filename, const size_t width, const size_t height, const size_t number_of_classes)
 {
-	new_anchors				= "";
-	new_counters_per_class	= "";
-	new_avg_iou				= 0.0f;
-
 	if (width	< 32 or
 		width	% 32 or
 		height	< 32 or
 		height	% 32 or
-		number_of_clusters <= 1 or
 		train_images_filename.empty())
 	{
-		throw std::invalid_argument("width and height must both be multiples of 32, and number_of_clusters must be greater than 1");
+		throw std::invalid_argument("width and height must both be multiples of 32");
 	}
 
-	VFloat rel_width_height_array;
-	VInt counter_per_class(number_of_classes, 0);
-	size_t number_of_boxes = 0;
+	AnchorBoxes anchor_boxes;
+	anchor_boxes.counters_per_class.resize(number_of_classes, 0);
+
+	Boxes boxes;
+	boxes.reserve(20);
 	std::string path;
 	std::ifstream ifs(train_images_filename);
 	while (std::getline(ifs, path))
@@ -293,92 +300,385 @@ void calc_anchors(const std::string & train_images_filename, const size_t number
 		}
 		labelpath += ".txt";
 
-		for (const auto & box : read_boxes(labelpath))
+		if (read_boxes(labelpath, boxes) == false)
 		{
-			number_of_boxes ++;
-			counter_per_class[box.class_idx] ++;
-			rel_width_height_array.push_back(box.w * static_cast<float>(width));
-			rel_width_height_array.push_back(box.h * static_cast<float>(height));
+			continue;
+		}
+
+		for (const auto & box : boxes)
+		{
+			if (box.class_idx >= 0 and static_cast<size_t>(box.class_idx) < number_of_classes)
+			{
+				anchor_boxes.counters_per_class[box.class_idx] ++;
+			}
+			anchor_boxes.widths	.push_back(box.w * static_cast<float>(width));
+			anchor_boxes.heights.push_back(box.h * static_cast<float>(height));
 		}
 	}
 
-	matrix boxes_data(number_of_boxes, 2);
-	for (size_t i = 0; i < number_of_boxes; ++i)
+	return anchor_boxes;
+}
+
+
+Anchors kmeans_anchors(const AnchorBoxes & boxes, const size_t number_of_clusters, const size_t max_restarts, const double max_seconds, const uint32_t seed, std::function<void(double)> progress)
+{
+	if (number_of_clusters <= 1)
 	{
-		boxes_data.row_and_col(i, 0) = rel_width_height_array[i * 2 + 0];
-		boxes_data.row_and_col(i, 1) = rel_width_height_array[i * 2 + 1];
+		throw std::invalid_argument("number_of_clusters must be greater than 1");
+	}
+	if (boxes.size() == 0)
+	{
+		throw std::invalid_argument("cannot calculate anchors without any bounding boxes");
 	}
 
-	// K-means
-	model anchors_data = do_kmeans(boxes_data, number_of_clusters);
+	const auto start_time	= std::chrono::high_resolution_clock::now();
+	const auto end_time		= start_time + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(max_seconds));
+	const size_t restarts	= std::max(size_t(1), max_restarts);
+	const size_t threads	= std::max(size_t(1), std::min(restarts, static_cast<size_t>(std::thread::hardware_concurrency())));
+
+	std::atomic<size_t> next_restart(0);
+	std::atomic<size_t> completed(0);
+	std::atomic<size_t> running(threads);
+	std::mutex best_lock;
+	std::exception_ptr error;
+	Anchors best;
+	best.avg_iou		= -1.0f;
+	best.best_restart	= 0;
+
+	auto worker = [&]()
+	{
+		try
+		{
+			while (true)
+			{
+				const size_t restart = next_restart ++;
+
+				// always complete the first restart, even if the time budget is tiny
+				if (restart >= restarts or (restart > 0 and std::chrono::high_resolution_clock::now() >= end_time))
+				{
+					break;
+				}
+
+				Anchors anchors = do_kmeans(boxes, number_of_clusters, seed, restart);
+				completed ++;
+
+				std::lock_guard<std::mutex> lock(best_lock);
+				if (anchors.avg_iou > best.avg_iou or (anchors.avg_iou == best.avg_iou and restart < best.best_restart))
+				{
+					best = anchors;
+				}
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(best_lock);
+			if (error == nullptr)
+			{
+				error = std::current_exception();
+			}
+			next_restart = restarts;
+		}
+
+		running --;
+
+		return;
+	};
+
+	std::vector<std::thread> v;
+	for (size_t idx = 0; idx < threads; idx ++)
+	{
+		v.emplace_back(worker);
+	}
+
+	while (running > 0)
+	{
+		if (progress)
+		{
+			const double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+			progress(std::min(1.0, std::max(double(completed) / double(restarts), max_seconds > 0.0 ? elapsed / max_seconds : 0.0)));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
 
-	// Store all the sizes in a multimap.  The key is the total area, and the value is the width+height stored as strings.
-	// This way the multimap will automatically sort all the values for us from smallest to largest, and all that we need
-	// to do is create the final string from all the values.
-	std::multimap<float, std::string> mm;
-	for (size_t row = 0; row < number_of_clusters; row ++)
+	for (auto & t : v)
 	{
-		const float w				= anchors_data.centers.row_and_col(row, 0);
-		const float h				= anchors_data.centers.row_and_col(row, 1);
-		const float area			= w * h;
-		const size_t round_width	= std::round(w);
-		const size_t round_height	= std::round(h);
-		const std::string text	= std::to_string(round_width) + ", " + std::to_string(round_height);
-		mm.insert(std::make_pair(area, text));
+		t.join();
 	}
-	for (auto [key, val] : mm)
+
+	if (error)
 	{
-		(void)key; // silence "unused variable" warning on older compilers (Ubuntu 18.04 and g++ 7.5.0)
+		std::rethrow_exception(error);
+	}
+
+	best.restarts = completed;
+
+	sort_by_area(best);
+
+	return best;
+}
+
+
+AnchorFitness anchor_fitness(const AnchorBoxes & boxes, const Anchors & anchors, const AnchorMasks & masks)
+{
+	// same as YOLOv5, a box matches an anchor when the width and height are both within 4x of the anchor
+	const float threshold = 0.25f;
 
-		if (not new_anchors.empty())
+	const size_t number_of_boxes	= boxes.size();
+	const size_t number_of_anchors	= anchors.widths.size();
+	const float * w					= boxes.widths.data();
+	const float * h					= boxes.heights.data();
+
+	// remember which head uses each anchor; anchors which are not in any mask are never used by Darknet
+	VInt head_of_anchor(number_of_anchors, -1);
+	for (size_t head = 0; head < masks.size(); head ++)
+	{
+		for (const size_t idx : masks[head])
 		{
-			new_anchors += ", ";
+			if (idx < number_of_anchors and head_of_anchor[idx] < 0)
+			{
+				head_of_anchor[idx] = head;
+			}
+		}
+	}
+	if (masks.empty())
+	{
+		std::fill(head_of_anchor.begin(), head_of_anchor.end(), 0);
+	}
+
+	VFloat best_ratio(number_of_boxes, 0.0f);
+	VInt best_anchor(number_of_boxes, -1);
+	VInt above(number_of_boxes, 0);
+	float * best	= best_ratio.data();
+	int * c			= best_anchor.data();
+	int * a			= above.data();
+
+	for (size_t j = 0; j < number_of_anchors; j ++)
+	{
+		if (head_of_anchor[j] < 0)
+		{
+			continue;
+		}
+
+		const float aw		= anchors.widths[j];
+		const float ah		= anchors.heights[j];
+		const int anchor	= j;
+
+		for (size_t i = 0; i < number_of_boxes; i ++)
+		{
+			const float rw		= w[i] / aw;
+			const float rh		= h[i] / ah;
+			const float min_rw	= (rw < 1.0f / rw) ? rw : 1.0f / rw;
+			const float min_rh	= (rh < 1.0f / rh) ? rh : 1.0f / rh;
+			const float ratio	= (min_rw < min_rh) ? min_rw : min_rh;
+			const bool better	= ratio > best[i];
+			best[i]				= better ? ratio : best[i];
+			c[i]				= better ? anchor : c[i];
+			a[i]				+= (ratio > threshold) ? 1 : 0;
 		}
-		new_anchors += val;
 	}
 
-	// now we figure out the values for counters_per_class
+	AnchorFitness result;
+	result.boxes_per_head.resize(std::max(size_t(1), masks.size()), 0);
 
-	float avg_iou = 0.0f;
-	for (size_t i = 0; i < number_of_boxes; ++i)
+	double sum		= 0.0;
+	size_t matched	= 0;
+	size_t total	= 0;
+	for (size_t i = 0; i < number_of_boxes; i ++)
 	{
-		float box_w		= rel_width_height_array[i * 2 + 0];
-		float box_h		= rel_width_height_array[i * 2 + 1];
-		float min_dist	= std::numeric_limits<float>::max();
-		float best_iou	= 0.0f;
-		for (size_t j = 0; j < number_of_clusters; ++j)
+		if (best[i] > threshold)
 		{
-			const float anchor_w		= anchors_data.centers.row_and_col(j, 0);
-			const float anchor_h		= anchors_data.centers.row_and_col(j, 1);
-			const float min_w			= (box_w < anchor_w) ? box_w : anchor_w;
-			const float min_h			= (box_h < anchor_h) ? box_h : anchor_h;
-			const float box_intersect	= min_w * min_h;
-			const float box_union		= box_w * box_h + anchor_w * anchor_h - box_intersect;
-			const float iou				= box_intersect / box_union;
-			const float distance		= 1 - iou;
-			if (distance < min_dist)
+			sum += best[i];
+			matched ++;
+		}
+		total += a[i];
+		if (c[i] >= 0)
+		{
+			result.boxes_per_head[head_of_anchor[c[i]]] ++;
+		}
+	}
+
+	result.fitness	= number_of_boxes ? sum / number_of_boxes : 0.0;
+	result.bpr		= number_of_boxes ? double(matched) / number_of_boxes : 0.0;
+	result.aat		= number_of_boxes ? double(total) / number_of_boxes : 0.0;
+
+	return result;
+}
+
+
+Anchors evolve_anchors(const AnchorBoxes & boxes, const Anchors & initial, const AnchorMasks & masks, const size_t width, const size_t height, const double max_seconds, const uint32_t seed, std::function<void(double)> progress)
+{
+	if (boxes.size() == 0 or initial.widths.empty())
+	{
+		throw std::invalid_argument("cannot evolve anchors without any bounding boxes or initial anchors");
+	}
+
+	// how much each width and height is scaled when mutated, and the probability of each value being mutated
+	const float sigma					= 0.1f;
+	const float mutation_probability	= 0.9f;
+	const float min_size				= 2.0f;
+
+	const auto start_time	= std::chrono::high_resolution_clock::now();
+	const auto end_time		= start_time + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(max_seconds));
+	const size_t threads	= std::max(1U, std::thread::hardware_concurrency());
+
+	Anchors best = initial;
+	sort_by_area(best);
+	AnchorFitness best_fitness = anchor_fitness(boxes, best, masks);
+
+	std::atomic<size_t> generations(0);
+	std::atomic<size_t> running(threads);
+	std::mutex best_lock;
+	std::exception_ptr error;
+
+	auto worker = [&](const size_t thread_idx)
+	{
+		try
+		{
+			std::seed_seq seq{seed, static_cast<uint32_t>(thread_idx)};
+			std::mt19937 rng(seq);
+			std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+			std::normal_distribution<float> normal(0.0f, 1.0f);
+
+			while (std::chrono::high_resolution_clock::now() < end_time)
 			{
-				min_dist = distance;
-				best_iou = iou;
+				Anchors candidate;
+				if (true)
+				{
+					std::lock_guard<std::mutex> lock(best_lock);
+					candidate = best;
+				}
+
+				// keep trying until at least one of the values has been changed
+				bool mutated = false;
+				while (not mutated)
+				{
+					for (size_t idx = 0; idx < candidate.widths.size(); idx ++)
+					{
+						for (float * value : {&candidate.widths[idx], &candidate.heights[idx]})
+						{
+							if (uniform(rng) < mutation_probability)
+							{
+								const float factor = std::clamp(1.0f + sigma * normal(rng) * uniform(rng), 0.3f, 3.0f);
+								mutated = mutated or factor != 1.0f;
+								*value *= factor;
+							}
+						}
+						candidate.widths[idx]	= std::clamp(candidate.widths[idx]	, min_size, static_cast<float>(width	));
+						candidate.heights[idx]	= std::clamp(candidate.heights[idx]	, min_size, static_cast<float>(height	));
+					}
+				}
+				sort_by_area(candidate);
+
+				const AnchorFitness fitness = anchor_fitness(boxes, candidate, masks);
+				generations ++;
+
+				std::lock_guard<std::mutex> lock(best_lock);
+				if (fitness.is_better_than(best_fitness))
+				{
+					best			= candidate;
+					best_fitness	= fitness;
+				}
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(best_lock);
+			if (error == nullptr)
+			{
+				error = std::current_exception();
 			}
 		}
 
-		if (best_iou > 0.0f and best_iou < 1.0f)
+		running --;
+
+		return;
+	};
+
+	std::vector<std::thread> v;
+	for (size_t idx = 0; idx < threads; idx ++)
+	{
+		v.emplace_back(worker, idx);
+	}
+
+	while (running > 0)
+	{
+		if (progress)
+		{
+			const double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+			progress(max_seconds > 0.0 ? std::min(1.0, elapsed / max_seconds) : 1.0);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	for (auto & t : v)
+	{
+		t.join();
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+
+	best.avg_iou		= average_iou(boxes, best.widths, best.heights);
+	best.generations	= generations;
+
+	return best;
+}
+
+
+std::string anchors_to_string(const Anchors & anchors)
+{
+	std::string str;
+	for (size_t idx = 0; idx < anchors.widths.size(); idx ++)
+	{
+		const size_t round_width	= std::round(anchors.widths[idx]);
+		const size_t round_height	= std::round(anchors.heights[idx]);
+		if (not str.empty())
 		{
-			avg_iou += best_iou;
+			str += ", ";
 		}
+		str += std::to_string(round_width) + ", " + std::to_string(round_height);
 	}
 
-	for (size_t i = 0; i < number_of_classes; i++)
+	return str;
+}
+
+
+std::string counters_to_string(const AnchorBoxes & boxes)
+{
+	std::string str;
+	for (size_t i = 0; i < boxes.counters_per_class.size(); i++)
 	{
 		if (i > 0)
 		{
-			new_counters_per_class += ", ";
+			str += ", ";
 		}
-		new_counters_per_class += std::to_string(counter_per_class[i]);
+		str += std::to_string(boxes.counters_per_class[i]);
 	}
 
-	new_avg_iou = 100.0f * avg_iou / static_cast<float>(number_of_boxes);
+	return str;
+}
+
+
+void calc_anchors(const std::string & train_images_filename, const size_t number_of_clusters, const size_t width, const size_t height, const size_t number_of_classes, std::string & new_anchors, std::string & new_counters_per_class, float & new_avg_iou)
+{
+	new_anchors				= "";
+	new_counters_per_class	= "";
+	new_avg_iou				= 0.0f;
+
+	const AnchorBoxes boxes	= load_anchor_boxes(train_images_filename, width, height, number_of_classes);
+	if (boxes.size() == 0)
+	{
+		// leave the results empty so the caller keeps the existing anchors
+		return;
+	}
+
+	const Anchors anchors	= kmeans_anchors(boxes, number_of_clusters, 1, 0.0, dm::get_random_engine()());
+
+	new_anchors				= anchors_to_string(anchors);
+	new_counters_per_class	= counters_to_string(boxes);
+	new_avg_iou				= anchors.avg_iou;
 
 	return;
 }
@@ -2,8 +2,87 @@
 
 #pragma once
 
+#include <functional>
+#include <string>
+#include <vector>
+
+
+/** Width and height of every bounding box in the training images, scaled to the network dimensions.  The boxes are read
+ * once and stored in contiguous arrays so k-means can be restarted many times without reading the label files again.
+ */
+struct AnchorBoxes
+{
+	std::vector<float> widths;
+	std::vector<float> heights;
+	std::vector<int> counters_per_class;
+
+	size_t size() const { return widths.size(); }
+};
+
+
+/// Anchors found by @ref kmeans_anchors(), sorted by area from smallest to largest.
+struct Anchors
+{
+	std::vector<float> widths;
+	std::vector<float> heights;
+	float avg_iou;			///< Average IoU (as a percentage) between each box and the anchor it is closest to.
+	size_t restarts;		///< Number of k-means restarts which were completed.
+	size_t best_restart;	///< The restart which found these anchors.
+	size_t generations;		///< Number of candidates evaluated by @ref evolve_anchors(), or zero for k-means.
+};
+
+
+/** The anchor indexes used by each detection head, such as @p {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}}.  This comes from the
+ * @p mask line in each of the @p [yolo] sections.  When empty, all of the anchors are treated as a single head.
+ */
+typedef std::vector<std::vector<size_t>> AnchorMasks;
+
+
+/** How well a set of anchors covers the boxes.  A box is considered to match an anchor when neither the width nor the
+ * height of the box is more than 4 times larger or smaller than the anchor.  Only the anchors referenced by a mask are used.
+ */
+struct AnchorFitness
+{
+	float fitness;	///< Average width/height ratio between each box and its best anchor, where boxes without a match count as zero.
+	float bpr;		///< Best possible recall:  the fraction of boxes which match at least one anchor.
+	float aat;		///< Anchors above threshold:  the average number of anchors each box matches.
+	std::vector<size_t> boxes_per_head;	///< Number of boxes where the best anchor belongs to each detection head.
+
+	/// A higher best possible recall is always better; the fitness is only used when the recall is the same.
+	bool is_better_than(const AnchorFitness & rhs) const { return bpr > rhs.bpr or (bpr == rhs.bpr and fitness > rhs.fitness); }
+};
+
+
+/// Read the bounding boxes from the .txt label files of every image listed in @p train_images_filename.
+AnchorBoxes load_anchor_boxes(const std::string & train_images_filename, const size_t width, const size_t height, const size_t number_of_classes);
+
+/** Run k-means using IoU as the distance and k-means++ seeding.  The restarts are spread across all the CPU cores and the
+ * anchors with the best average IoU are returned.  New restarts stop being started once @p max_seconds has elapsed, but at
+ * least one restart is always completed.  Each restart has its own random engine seeded from @p seed and the restart
+ * number, so the results don't depend on the number of threads.  If set, @p progress is called from the calling thread
+ * with a value between 0.0 and 1.0.
+ */
+Anchors kmeans_anchors(const AnchorBoxes & boxes, const size_t number_of_clusters, const size_t max_restarts, const double max_seconds, const uint32_t seed, std::function<void(double)> progress = nullptr);
+
+/// Measure how well the anchors cover the boxes at the network size.  See @ref AnchorFitness.
+AnchorFitness anchor_fitness(const AnchorBoxes & boxes, const Anchors & anchors, const AnchorMasks & masks);
+
+/** Start with the anchors from @ref kmeans_anchors() and keep mutating them until @p max_seconds has elapsed.  Every core
+ * repeatedly takes the best anchors found so far, randomly scales some of the widths and heights, and keeps the result if
+ * @ref AnchorFitness::is_better_than() the best anchors.  The anchors are kept sorted by area so the masks continue to
+ * assign the smallest anchors to the same detection head.  The anchors cannot be larger than the network dimensions.
+ */
+Anchors evolve_anchors(const AnchorBoxes & boxes, const Anchors & initial, const AnchorMasks & masks, const size_t width, const size_t height, const double max_seconds, const uint32_t seed, std::function<void(double)> progress = nullptr);
+
+/// Format the anchors the way they are written to the @p [yolo] sections, such as @p "10, 14, 23, 27, 37, 58".
+std::string anchors_to_string(const Anchors & anchors);
+
+/// Format the number of boxes for each class the way @p counters_per_class is written to the @p [yolo] sections.
+std::string counters_to_string(const AnchorBoxes & boxes);
+
 /** The original @p calc_anchors() code from Darknet was taken from src/detector.c.  The code was then heavily modified
  * to bring it up to C++, remove memory leaks, cut out unneeded functionality, and remove all console output.  This new
- * function returns 3 values:  @p new_anchors, @p new_counters_per_class, and @p new_avg_iou.
+ * function returns 3 values:  @p new_anchors, @p new_counters_per_class, and @p new_avg_iou.  It runs a single k-means
+ * attempt; see @ref load_anchor_boxes() and @ref kmeans_anchors() to run many attempts.
  */
 void calc_anchors(const std::string & train_images_filename, const size_t number_of_clusters, const size_t width, const size_t height, const size_t number_of_classes, std::string & new_anchors, std::string & new_counters_per_class, float & new_avg_iou);
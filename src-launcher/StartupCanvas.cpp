@@ -2,9 +2,6 @@
 
 #include "DarkMark.hpp"
 
-#include "json.hpp"
-using json = nlohmann::json;
-
 
 std::string format_bytes(double bytes)
 {
@@ -238,8 +235,18 @@ void dm::StartupCanvas::initialize_on_thread()
 
 	if (image_filenames.empty() == false)
 	{
-		auto image = ImageCache::getFromFile(File(image_filenames[std::rand() % image_filenames.size()]));
-		thumbnail.setImage(image, RectanglePlacement::xLeft);
+		// the thumbnail is small, so use the thumbnail cache or a reduced-resolution decode instead of loading the full image
+		const std::string fn = image_filenames[std::rand() % image_filenames.size()];
+		cv::Mat mat;
+		ThumbnailCache thumbnail_cache(project_directory.toString().toStdString());
+		if (thumbnail_cache.get(fn, 400, mat, false) == false)
+		{
+			mat = imread_reduced(fn, cv::Size(400, 300));
+		}
+		if (mat.empty() == false)
+		{
+			thumbnail.setImage(convert_opencv_mat_to_juce_image(mat), RectanglePlacement::xLeft);
+		}
 	}
 
 	find_all_darknet_files();
@@ -256,6 +263,9 @@ void dm::StartupCanvas::initialize_on_thread()
 			std::time_t newest = 0;
 			std::size_t count = 0;
 
+			AnnotationIndex annotation_index(dir.getFullPathName().toStdString());
+			annotation_index.load();
+
 			for (const auto & filename : json_filenames)
 			{
 				if (done)
@@ -263,14 +273,19 @@ void dm::StartupCanvas::initialize_on_thread()
 					break;
 				}
 
-				json j = json::parse(File(filename).loadFileAsString().toStdString());
-				count += j["mark"].size();
-				if (j.value("completely_empty", false) == true)
+				const AnnotationSummary summary = annotation_index.get(File(filename));
+				if (summary.is_valid == false)
+				{
+					throw std::runtime_error(filename + ": " + summary.error);
+				}
+
+				count += summary.marks.size();
+				if (summary.completely_empty)
 				{
 					// count empty images as well...but not the same way as marks
 					empty_images ++;
 				}
-				std::time_t timestamp = j["timestamp"].get<std::time_t>();
+				std::time_t timestamp = summary.timestamp;
 				if (oldest == 0 || timestamp < oldest)
 				{
 					oldest = timestamp;
@@ -281,6 +296,8 @@ void dm::StartupCanvas::initialize_on_thread()
 				}
 			}
 
+			annotation_index.save();
+
 			if (empty_images)
 			{
 				// since we have some empty images, update the text counter to include those stats as well
@@ -60,6 +60,16 @@ namespace dm
 	class SettingsWnd;
 	class FilterWnd;
 	class ProjectInfo;
+	class AnnotationIndex;
+	class ImagePrefetcher;
+	class ImagePyramid;
+	class BKTree;
+	class SpatialIndex;
+	class ImagePipeline;
+	class PredictionCache;
+	class ThumbnailCache;
+	class RunningStats;
+	class QuantileSketch;
 	class DMContentReview;
 	class DMReviewWnd;
 	class DMReviewCanvas;
@@ -68,10 +78,13 @@ namespace dm
 	class DMContentFlipImages;
 	class DMContentDeleteRotateAndFlipImages;
 	class DMContentImportTxt;
+	class DMContentPredictAll;
+	class DMContentPredictionThread;
 	class ScrollField;
 	class CrosshairComponent;
 	class DarkMarkApplication;
 	struct ReviewInfo;
+	struct ReviewImage;
 
 	typedef std::vector<std::string> VStr;
 	typedef std::set<std::string> SStr;
@@ -90,12 +103,23 @@ namespace dm
 #include "Bitmaps.hpp"
 #include "Mark.hpp"
 #include "Tools.hpp"
+#include "BinaryStream.hpp"
 #include "CrosshairComponent.hpp"
 #include "ProjectInfo.hpp"
+#include "AnnotationIndex.hpp"
+#include "ImagePrefetcher.hpp"
+#include "ImagePyramid.hpp"
+#include "PerceptualHash.hpp"
+#include "SpatialIndex.hpp"
+#include "ImagePipeline.hpp"
+#include "PredictionCache.hpp"
+#include "ThumbnailCache.hpp"
+#include "StreamingStats.hpp"
 #include "Notebook.hpp"
 #include "DMJumpWnd.hpp"
 #include "ScrollField.hpp"
 #include "DMCanvas.hpp"
+#include "DMContentPredictionThread.hpp"
 #include "DMContent.hpp"
 #include "DMStatsWnd.hpp"
 #include "AboutWnd.hpp"
@@ -112,6 +136,7 @@ namespace dm
 #include "StartupCanvas.hpp"
 #include "DMContentImportTxt.hpp"
 #include "DMContentReloadResave.hpp"
+#include "DMContentPredictAll.hpp"
 #include "DMContentRotateImages.hpp"
 #include "DMContentFlipImages.hpp"
 #include "DMContentDeleteRotateAndFlipImages.hpp"
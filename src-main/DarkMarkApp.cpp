@@ -309,9 +309,9 @@ void dm::DarkMarkApplication::initialise(const String & commandLine)
 			dm::Log("DarkMark v" DARKMARK_VERSION);
 			systemRequestedQuit();
 		}
-		else if (key == "editor" and val == "gen-darknet")
+		else if (key == "editor" and (val == "gen-darknet" or val == "predict-all"))
 		{
-			// if "editor" is specified, the only action currently supported is "gen-darknet"
+			// if "editor" is specified, the only actions currently supported are "gen-darknet" and "predict-all"
 		}
 		else if (key == "darknet" and val == "run")
 		{
@@ -442,6 +442,15 @@ void dm::DarkMarkApplication::initialise(const String & commandLine)
 				throw std::runtime_error("cannot find template \"" + val + "\"");
 			}
 		}
+		else if (key == "threads")
+		{
+			// this is used by the "predict all" worker threads, each of which loads a copy of the neural network
+			if (validPositiveInt(val) == false or std::stoi(val) < 1 or std::stoi(val) > 64)
+			{
+				dm::Log("Error: the number of threads must be between 1 and 64: \"" + val + "\"");
+				throw std::runtime_error("CLI parameter is invalid: \"" + key + "\"");
+			}
+		}
 		else if (
 			validPositiveInt(val) and (
 				key == "width"					or
@@ -460,8 +469,10 @@ void dm::DarkMarkApplication::initialise(const String & commandLine)
 				key == "zoom_images"				or
 				key == "limit_neg_samples"			or
 				key == "limit_validation_images"	or
+				key == "group_near_duplicates"		or
 				key == "yolo_anchors"				or
 				key == "class_imbalance"			or
+				key == "evolve_anchors"				or
 				key == "mosaic"						or
 				key == "cutmix"						or
 				key == "mixup"						or
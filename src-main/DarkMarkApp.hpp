@@ -34,6 +34,11 @@ namespace dm
 			std::unique_ptr<Cfg>			cfg;
 			std::unique_ptr<DMWnd>			wnd;
 			std::unique_ptr<DarkHelp::NN>	darkhelp_nn;
+
+			/** DarkHelp is not thread-safe, and inference runs on @ref DMContentPredictionThread.  This lock must be held
+			 * when reading or writing the DarkHelp configuration, when calling @p predict(), and when replacing @ref darkhelp_nn.
+			 */
+			std::mutex						darkhelp_nn_lock;
 			std::unique_ptr<DMStatsWnd>		stats_wnd;
 			std::unique_ptr<AboutWnd>		about_wnd;
 			std::unique_ptr<DMJumpWnd>		jump_wnd;
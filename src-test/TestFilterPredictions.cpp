@@ -0,0 +1,140 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include <gtest/gtest.h>
+#include "DarkMark.hpp"
+
+
+/// Create a raw prediction the way DarkHelp returns it when the threshold is low and NMS is disabled.
+static DarkHelp::PredictionResult make_prediction(const cv::Rect & r, const DarkHelp::MClassProbabilities & probabilities)
+{
+	DarkHelp::PredictionResult prediction;
+	prediction.rect					= r;
+	prediction.all_probabilities	= probabilities;
+	prediction.best_class			= 0;
+	prediction.best_probability		= 0.0f;
+	for (const auto & iter : probabilities)
+	{
+		if (iter.second > prediction.best_probability)
+		{
+			prediction.best_class		= iter.first;
+			prediction.best_probability	= iter.second;
+		}
+	}
+
+	return prediction;
+}
+
+
+TEST(FilterPredictions, Empty)
+{
+	ASSERT_TRUE(dm::filter_predictions({}, 0.5f, 0.45f).empty());
+}
+
+
+TEST(FilterPredictions, Threshold)
+{
+	const DarkHelp::PredictionResults raw =
+	{
+		make_prediction(cv::Rect(0, 0, 10, 10), {{0, 0.30f}, {1, 0.60f}, {2, 0.55f}}),
+		make_prediction(cv::Rect(100, 0, 10, 10), {{0, 0.49f}, {3, 0.20f}}),
+		make_prediction(cv::Rect(200, 0, 10, 10), {{4, 0.50f}}),
+	};
+
+	const auto results = dm::filter_predictions(raw, 0.5f, 0.45f);
+	ASSERT_EQ(results.size(), 2);
+
+	// only the probabilities at or above the threshold are kept
+	ASSERT_EQ(results[0].rect, cv::Rect(0, 0, 10, 10));
+	ASSERT_EQ(results[0].best_class, 1);
+	ASSERT_FLOAT_EQ(results[0].best_probability, 0.60f);
+	ASSERT_EQ(results[0].all_probabilities.size(), 2);
+	ASSERT_EQ(results[0].all_probabilities.count(0), 0);
+	ASSERT_FLOAT_EQ(results[0].all_probabilities.at(2), 0.55f);
+
+	// the threshold is inclusive
+	ASSERT_EQ(results[1].rect, cv::Rect(200, 0, 10, 10));
+	ASSERT_EQ(results[1].best_class, 4);
+
+	// a higher threshold changes which predictions and classes are kept
+	const auto strict = dm::filter_predictions(raw, 0.58f, 0.45f);
+	ASSERT_EQ(strict.size(), 1);
+	ASSERT_EQ(strict[0].all_probabilities.size(), 1);
+	ASSERT_EQ(strict[0].best_class, 1);
+}
+
+
+TEST(FilterPredictions, BestProbabilityWithoutAllProbabilities)
+{
+	// some predictions only have the best class and probability
+	DarkHelp::PredictionResult prediction = make_prediction(cv::Rect(0, 0, 10, 10), {});
+	prediction.best_class		= 7;
+	prediction.best_probability	= 0.8f;
+
+	const auto results = dm::filter_predictions({prediction}, 0.5f, 0.45f);
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0].best_class, 7);
+	ASSERT_EQ(results[0].all_probabilities.size(), 1);
+	ASSERT_FLOAT_EQ(results[0].all_probabilities.at(7), 0.8f);
+
+	ASSERT_TRUE(dm::filter_predictions({prediction}, 0.9f, 0.45f).empty());
+}
+
+
+TEST(FilterPredictions, SortedByProbability)
+{
+	const DarkHelp::PredictionResults raw =
+	{
+		make_prediction(cv::Rect(0, 0, 10, 10), {{0, 0.6f}}),
+		make_prediction(cv::Rect(100, 0, 10, 10), {{0, 0.9f}}),
+		make_prediction(cv::Rect(200, 0, 10, 10), {{0, 0.7f}}),
+	};
+
+	const auto results = dm::filter_predictions(raw, 0.5f, 0.45f);
+	ASSERT_EQ(results.size(), 3);
+	ASSERT_FLOAT_EQ(results[0].best_probability, 0.9f);
+	ASSERT_FLOAT_EQ(results[1].best_probability, 0.7f);
+	ASSERT_FLOAT_EQ(results[2].best_probability, 0.6f);
+}
+
+
+TEST(FilterPredictions, PerClassSuppression)
+{
+	const DarkHelp::PredictionResults raw =
+	{
+		make_prediction(cv::Rect(0, 0, 100, 100), {{0, 0.7f}}),
+		make_prediction(cv::Rect(5, 5, 100, 100), {{0, 0.9f}}),		// overlaps the first one with IoU ~0.82
+		make_prediction(cv::Rect(0, 0, 100, 100), {{1, 0.8f}}),		// same rectangle, but a different class
+		make_prediction(cv::Rect(60, 0, 100, 100), {{0, 0.6f}}),	// IoU 0.25 with the first one
+	};
+
+	const auto results = dm::filter_predictions(raw, 0.5f, 0.45f);
+	ASSERT_EQ(results.size(), 3);
+	ASSERT_EQ(results[0].rect, cv::Rect(5, 5, 100, 100));
+	ASSERT_EQ(results[0].best_class, 0);
+	ASSERT_EQ(results[1].rect, cv::Rect(0, 0, 100, 100));
+	ASSERT_EQ(results[1].best_class, 1);
+	ASSERT_EQ(results[2].rect, cv::Rect(60, 0, 100, 100));
+
+	// with a NMS threshold of 1.0 nothing is suppressed, even identical rectangles
+	ASSERT_EQ(dm::filter_predictions(raw, 0.5f, 1.0f).size(), 4);
+	ASSERT_EQ(dm::filter_predictions({raw[0], raw[0]}, 0.5f, 1.0f).size(), 2);
+	ASSERT_EQ(dm::filter_predictions({raw[0], raw[0]}, 0.5f, 0.45f).size(), 1);
+}
+
+
+TEST(FilterPredictions, SuppressedPredictionsDontSuppress)
+{
+	// B overlaps both A and C, but A and C only overlap a little, so once B is suppressed by A then C must be kept
+	const DarkHelp::PredictionResults raw =
+	{
+		make_prediction(cv::Rect(0, 0, 100, 100), {{0, 0.9f}}),		// A
+		make_prediction(cv::Rect(30, 0, 100, 100), {{0, 0.8f}}),	// B
+		make_prediction(cv::Rect(60, 0, 100, 100), {{0, 0.7f}}),	// C
+	};
+
+	const auto results = dm::filter_predictions(raw, 0.5f, 0.45f);
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_EQ(results[0].rect, cv::Rect(0, 0, 100, 100));
+	ASSERT_EQ(results[1].rect, cv::Rect(60, 0, 100, 100));
+}
+
@@ -0,0 +1,167 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include <gtest/gtest.h>
+#include "DarkMark.hpp"
+
+
+TEST(PerceptualHash, HammingDistance)
+{
+	ASSERT_EQ(dm::hamming_distance(0, 0), 0);
+	ASSERT_EQ(dm::hamming_distance(0, 1), 1);
+	ASSERT_EQ(dm::hamming_distance(0b1010, 0b0101), 4);
+	ASSERT_EQ(dm::hamming_distance(0, ~0ULL), 64);
+	ASSERT_EQ(dm::hamming_distance(0x8000000000000001ULL, 1), 1);
+	ASSERT_EQ(dm::hamming_distance(0x0123456789abcdefULL, 0x0123456789abcdefULL), 0);
+}
+
+
+TEST(PerceptualHash, DHash)
+{
+	// pixels which get darker from left to right set every bit, while pixels which get brighter don't set any bits
+	cv::Mat darker(80, 90, CV_8UC1);
+	cv::Mat brighter(80, 90, CV_8UC1);
+	for (int x = 0; x < darker.cols; x ++)
+	{
+		darker	.colRange(x, x + 1).setTo(cv::Scalar(255 - x * 2));
+		brighter.colRange(x, x + 1).setTo(cv::Scalar(x * 2));
+	}
+	ASSERT_EQ(dm::dhash(darker), ~0ULL);
+	ASSERT_EQ(dm::dhash(brighter), 0);
+
+	// colour images are converted to greyscale
+	cv::Mat colour;
+	cv::cvtColor(darker, colour, cv::COLOR_GRAY2BGR);
+	ASSERT_EQ(dm::dhash(colour), ~0ULL);
+
+	// a resized copy of the same image has the same hash
+	cv::Mat resized;
+	cv::resize(darker, resized, cv::Size(450, 400));
+	ASSERT_EQ(dm::dhash(resized), dm::dhash(darker));
+
+	// blank images and images which failed to decode have a hash of zero
+	ASSERT_EQ(dm::dhash(cv::Mat(100, 100, CV_8UC3, cv::Scalar(0, 0, 0))), 0);
+	ASSERT_EQ(dm::dhash(cv::Mat(100, 100, CV_8UC3, cv::Scalar(128, 128, 128))), 0);
+	ASSERT_EQ(dm::dhash(cv::Mat()), 0);
+}
+
+
+TEST(BKTree, Empty)
+{
+	dm::BKTree tree;
+
+	ASSERT_EQ(tree.size(), 0);
+	ASSERT_TRUE(tree.find(0, 64).empty());
+}
+
+
+TEST(BKTree, RadiusBoundary)
+{
+	dm::BKTree tree;
+	tree.insert(0b0000, 0);
+	tree.insert(0b0001, 1);	// distance 1
+	tree.insert(0b0011, 2);	// distance 2
+	tree.insert(0b0111, 3);	// distance 3
+	tree.insert(0b1111, 4);	// distance 4
+	tree.insert(0b0110, 5);	// distance 2
+	ASSERT_EQ(tree.size(), 6);
+
+	auto find = [&](const uint64_t hash, const int radius)
+	{
+		auto ids = tree.find(hash, radius);
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	};
+
+	// hashes exactly at the radius are included, and those one bit further are not
+	ASSERT_EQ(find(0, 0), std::vector<size_t>({0}));
+	ASSERT_EQ(find(0, 1), std::vector<size_t>({0, 1}));
+	ASSERT_EQ(find(0, 2), std::vector<size_t>({0, 1, 2, 5}));
+	ASSERT_EQ(find(0, 3), std::vector<size_t>({0, 1, 2, 3, 5}));
+	ASSERT_EQ(find(0, 4), std::vector<size_t>({0, 1, 2, 3, 4, 5}));
+	ASSERT_EQ(find(0b1111, 1), std::vector<size_t>({3, 4}));
+	ASSERT_TRUE(find(~0ULL, 59).empty());
+}
+
+
+TEST(BKTree, MatchesBruteForce)
+{
+	std::mt19937_64 rng(42);
+	std::vector<uint64_t> hashes;
+	dm::BKTree tree;
+	for (size_t idx = 0; idx < 500; idx ++)
+	{
+		// flip a few bits of a small number of base hashes so there are many near neighbours
+		uint64_t hash = (idx % 10) * 0x0101010101010101ULL;
+		for (int bit = 0; bit < 3; bit ++)
+		{
+			hash ^= (1ULL << (rng() % 64));
+		}
+		hashes.push_back(hash);
+		tree.insert(hash, idx);
+	}
+
+	for (const int radius : {0, 3, 8, 20})
+	{
+		for (size_t idx = 0; idx < hashes.size(); idx += 7)
+		{
+			std::vector<size_t> expected;
+			for (size_t other = 0; other < hashes.size(); other ++)
+			{
+				if (dm::hamming_distance(hashes[idx], hashes[other]) <= radius)
+				{
+					expected.push_back(other);
+				}
+			}
+
+			auto ids = tree.find(hashes[idx], radius);
+			std::sort(ids.begin(), ids.end());
+			ASSERT_EQ(ids, expected) << "radius=" << radius << " idx=" << idx;
+		}
+	}
+}
+
+
+TEST(GroupNearDuplicates, Empty)
+{
+	ASSERT_TRUE(dm::group_near_duplicates({}, 5).empty());
+}
+
+
+TEST(GroupNearDuplicates, Transitive)
+{
+	const std::vector<uint64_t> hashes =
+	{
+		0xff00,		// 0
+		0x00ff,		// 1: far from everything
+		0xff01,		// 2: 1 bit from #0
+		0xff03,		// 3: 1 bit from #2, 2 bits from #0
+		0xff07,		// 4: 1 bit from #3, 3 bits from #0
+		0x00ff0000,	// 5: far from everything
+	};
+
+	// each hash is linked to the previous one, so they all join the group of the first hash
+	ASSERT_EQ(dm::group_near_duplicates(hashes, 1), std::vector<size_t>({0, 1, 0, 0, 0, 5}));
+
+	// nothing is grouped when only identical hashes match
+	ASSERT_EQ(dm::group_near_duplicates(hashes, 0), std::vector<size_t>({0, 1, 2, 3, 4, 5}));
+}
+
+
+TEST(GroupNearDuplicates, LowestIndexIsRoot)
+{
+	// #2 starts in the group of #1, then #3 is near both #0 and #1 so it joins both groups together
+	const std::vector<uint64_t> hashes = {0x100, 0x1ff, 0x1fc, 0x10f, 0x1fe};
+	ASSERT_EQ(dm::group_near_duplicates({0x100, 0x1ff, 0x1fc}, 4), std::vector<size_t>({0, 1, 1}));
+	ASSERT_EQ(dm::group_near_duplicates(hashes, 4), std::vector<size_t>({0, 0, 0, 0, 0}));
+	ASSERT_EQ(dm::group_near_duplicates({7, 7, 7}, 0), std::vector<size_t>({0, 0, 0}));
+}
+
+
+TEST(GroupNearDuplicates, ZeroHashesAreNotGrouped)
+{
+	// blank images and failed decodes have a hash of zero, which must not put them all in the same group
+	const std::vector<uint64_t> hashes = {0, 0, 1, 0, 3, 0};
+	const auto groups = dm::group_near_duplicates(hashes, 4);
+
+	ASSERT_EQ(groups, std::vector<size_t>({0, 1, 2, 3, 2, 5}));
+}
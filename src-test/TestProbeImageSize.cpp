@@ -0,0 +1,170 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include <gtest/gtest.h>
+#include "DarkMark.hpp"
+
+
+typedef std::vector<uint8_t> Bytes;
+
+
+/// Write the bytes to a temporary file and call @ref dm::probe_image_size() on it.
+static cv::Size probe(const Bytes & bytes, const std::string & extension)
+{
+	File f = File::createTempFile(extension);
+	f.replaceWithData(bytes.data(), bytes.size());
+	const cv::Size size = dm::probe_image_size(f.getFullPathName().toStdString());
+	f.deleteFile();
+
+	return size;
+}
+
+
+static Bytes & append(Bytes & bytes, const Bytes & more)
+{
+	bytes.insert(bytes.end(), more.begin(), more.end());
+	return bytes;
+}
+
+
+/// Minimal JPEG with a start-of-frame (SOF0) marker, preceded by whatever @p before_sof contains.
+static Bytes jpeg(const Bytes & before_sof, const int width, const int height)
+{
+	Bytes bytes = {0xFF, 0xD8};
+	append(bytes, before_sof);
+	append(bytes,
+	{
+		0xFF, 0xC0, 0x00, 0x11, 0x08,
+		uint8_t(height >> 8), uint8_t(height & 0xFF),
+		uint8_t(width >> 8), uint8_t(width & 0xFF),
+		0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01
+	});
+	append(bytes, {0xFF, 0xD9});
+
+	return bytes;
+}
+
+
+/// The APP0 segment written by most encoders.
+static const Bytes jfif =
+{
+	0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+};
+
+
+TEST(ProbeImageSize, JPEG)
+{
+	ASSERT_EQ(probe(jpeg(jfif, 640, 480), ".jpg"), cv::Size(640, 480));
+	ASSERT_EQ(probe(jpeg(jfif, 1, 65535), ".jpg"), cv::Size(1, 65535));
+
+	// progressive JPEG uses SOF2 instead of SOF0
+	Bytes progressive = jpeg(jfif, 800, 600);
+	progressive[2 + jfif.size() + 1] = 0xC2;
+	ASSERT_EQ(probe(progressive, ".jpg"), cv::Size(800, 600));
+
+	// the huffman table (DHT) uses one of the SOF marker numbers, but doesn't contain the dimensions
+	Bytes dht = {0xFF, 0xC4, 0x00, 0x06, 0x00, 0x01, 0x00, 0x00};
+	ASSERT_EQ(probe(jpeg(append(dht, jfif), 1024, 768), ".jpg"), cv::Size(1024, 768));
+}
+
+
+TEST(ProbeImageSize, JPEGFillBytes)
+{
+	// any number of 0xFF fill bytes may come before a marker
+	Bytes before = {0xFF, 0xFF, 0xFF};
+	append(before, jfif);
+	append(before, {0xFF, 0xFF});
+	ASSERT_EQ(probe(jpeg(before, 320, 200), ".jpg"), cv::Size(320, 200));
+}
+
+
+TEST(ProbeImageSize, JPEGStandaloneMarkers)
+{
+	// TEM, RSTn, and SOI don't have a length, so the next marker immediately follows
+	Bytes before = {0xFF, 0x01, 0xFF, 0xD0, 0xFF, 0xD7};
+	append(before, jfif);
+	append(before, {0xFF, 0xD8});
+	ASSERT_EQ(probe(jpeg(before, 123, 456), ".jpg"), cv::Size(123, 456));
+}
+
+
+TEST(ProbeImageSize, JPEGWithoutFrame)
+{
+	// the start-of-scan comes before the start-of-frame, or the segments are garbage
+	Bytes sos = {0xFF, 0xDA, 0x00, 0x02};
+	ASSERT_EQ(probe(jpeg(append(sos, jfif), 640, 480), ".jpg"), cv::Size());
+
+	Bytes garbage = jfif;
+	garbage.push_back(0x42);
+	ASSERT_EQ(probe(jpeg(garbage, 640, 480), ".jpg"), cv::Size());
+
+	Bytes bad_length = {0xFF, 0xE1, 0x00, 0x01};
+	ASSERT_EQ(probe(jpeg(append(bad_length, jfif), 640, 480), ".jpg"), cv::Size());
+}
+
+
+TEST(ProbeImageSize, PNG)
+{
+	const Bytes png =
+	{
+		0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A,
+		0x00, 0x00, 0x00, 0x0D, 'I', 'H', 'D', 'R',
+		0x00, 0x00, 0x07, 0x80,	// 1920
+		0x00, 0x00, 0x04, 0x38,	// 1080
+		0x08, 0x02, 0x00, 0x00, 0x00
+	};
+	ASSERT_EQ(probe(png, ".png"), cv::Size(1920, 1080));
+}
+
+
+TEST(ProbeImageSize, BMP)
+{
+	Bytes bmp(54, 0);
+	bmp[0] = 'B';
+	bmp[1] = 'M';
+	bmp[14] = 40;	// BITMAPINFOHEADER
+	bmp[18] = 0x20;	// width = 800
+	bmp[19] = 0x03;
+	bmp[22] = 0x58;	// height = 600
+	bmp[23] = 0x02;
+	ASSERT_EQ(probe(bmp, ".bmp"), cv::Size(800, 600));
+
+	// top-down bitmaps have a negative height
+	bmp[22] = 0xA8;	// height = -600
+	bmp[23] = 0xFD;
+	bmp[24] = 0xFF;
+	bmp[25] = 0xFF;
+	ASSERT_EQ(probe(bmp, ".bmp"), cv::Size(800, 600));
+}
+
+
+TEST(ProbeImageSize, TIFF)
+{
+	// little-endian, IFD at offset 8 with ImageWidth as a SHORT and ImageLength as a LONG
+	const Bytes little =
+	{
+		'I', 'I', 42, 0, 8, 0, 0, 0,
+		3, 0,
+		0x03, 0x01, 3, 0, 1, 0, 0, 0, 1, 0, 0, 0,			// Compression = 1
+		0x00, 0x01, 3, 0, 1, 0, 0, 0, 0x80, 0x02, 0, 0,		// ImageWidth = 640
+		0x01, 0x01, 4, 0, 1, 0, 0, 0, 0xE0, 0x01, 0, 0,		// ImageLength = 480
+	};
+	ASSERT_EQ(probe(little, ".tif"), cv::Size(640, 480));
+
+	// big-endian, where the SHORT is stored in the first 2 bytes of the value
+	const Bytes big =
+	{
+		'M', 'M', 0, 42, 0, 0, 0, 8,
+		0, 2,
+		0x01, 0x01, 0, 3, 0, 0, 0, 1, 0x03, 0x00, 0, 0,		// ImageLength = 768
+		0x01, 0x00, 0, 4, 0, 0, 0, 1, 0, 0, 0x04, 0x00,		// ImageWidth = 1024
+	};
+	ASSERT_EQ(probe(big, ".tif"), cv::Size(1024, 768));
+}
+
+
+TEST(ProbeImageSize, Unknown)
+{
+	ASSERT_EQ(probe({}, ".jpg"), cv::Size());
+	ASSERT_EQ(probe(Bytes(100, 0), ".jpg"), cv::Size());
+	ASSERT_EQ(dm::probe_image_size("/this/file/does/not/exist.jpg"), cv::Size());
+}
@@ -0,0 +1,143 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include <gtest/gtest.h>
+#include "DarkMark.hpp"
+
+
+/// Find the rectangles the slow way, to compare against the spatial index.
+static std::vector<size_t> linear_find(const std::vector<cv::Rect> & rects, const cv::Rect & r)
+{
+	std::vector<size_t> results;
+	for (size_t id = 0; id < rects.size(); id ++)
+	{
+		if ((rects[id] & r).empty() == false)
+		{
+			results.push_back(id);
+		}
+	}
+
+	return results;
+}
+
+
+static std::vector<size_t> linear_find(const std::vector<cv::Rect> & rects, const cv::Point & p)
+{
+	std::vector<size_t> results;
+	for (size_t id = 0; id < rects.size(); id ++)
+	{
+		if (rects[id].contains(p))
+		{
+			results.push_back(id);
+		}
+	}
+
+	return results;
+}
+
+
+TEST(SpatialIndex, Empty)
+{
+	dm::SpatialIndex index;
+
+	ASSERT_EQ(index.size(), 0);
+	ASSERT_TRUE(index.find(cv::Point(0, 0)).empty());
+	ASSERT_TRUE(index.find(cv::Rect(-1000, -1000, 5000, 5000)).empty());
+
+	index.build({});
+	ASSERT_EQ(index.size(), 0);
+	ASSERT_TRUE(index.find(cv::Rect(0, 0, 10, 10)).empty());
+}
+
+
+TEST(SpatialIndex, InsertReturnsIdsInOrder)
+{
+	dm::SpatialIndex index;
+
+	ASSERT_EQ(index.insert(cv::Rect(10, 10, 20, 20)), 0);
+	ASSERT_EQ(index.insert(cv::Rect(0, 0, 0, 0)), 1);
+	ASSERT_EQ(index.insert(cv::Rect(15, 15, 5, 5)), 2);
+	ASSERT_EQ(index.size(), 3);
+	ASSERT_EQ(index.at(2), cv::Rect(15, 15, 5, 5));
+
+	// empty rectangles have an ID but are never found
+	ASSERT_EQ(index.find(cv::Point(0, 0)), std::vector<size_t>());
+	ASSERT_EQ(index.find(cv::Point(16, 16)), std::vector<size_t>({0, 2}));
+	ASSERT_EQ(index.find(cv::Rect(0, 0, 100, 100)), std::vector<size_t>({0, 2}));
+
+	index.clear();
+	ASSERT_EQ(index.size(), 0);
+	ASSERT_EQ(index.insert(cv::Rect(1, 1, 1, 1)), 0);
+}
+
+
+TEST(SpatialIndex, Boundaries)
+{
+	dm::SpatialIndex index(cv::Size(10, 10));
+	index.insert(cv::Rect(0, 0, 10, 10));	// exactly one cell
+	index.insert(cv::Rect(10, 0, 10, 10));	// the next cell
+	index.insert(cv::Rect(-15, -15, 10, 10));	// negative coordinates
+
+	// the bottom-right edge of a rectangle is exclusive
+	ASSERT_EQ(index.find(cv::Point(9, 9)), std::vector<size_t>({0}));
+	ASSERT_EQ(index.find(cv::Point(10, 9)), std::vector<size_t>({1}));
+	ASSERT_EQ(index.find(cv::Point(-6, -6)), std::vector<size_t>({2}));
+	ASSERT_EQ(index.find(cv::Point(-5, -5)), std::vector<size_t>());
+
+	// rectangles which only touch along an edge don't overlap
+	ASSERT_EQ(index.find(cv::Rect(-5, -5, 5, 5)), std::vector<size_t>());
+	ASSERT_EQ(index.find(cv::Rect(9, 9, 2, 2)), std::vector<size_t>({0, 1}));
+	ASSERT_EQ(index.find(cv::Rect(0, 0, 0, 0)), std::vector<size_t>());
+}
+
+
+TEST(SpatialIndex, OversizedRectangles)
+{
+	dm::SpatialIndex index(cv::Size(8, 8));
+	index.insert(cv::Rect(100, 100, 4, 4));
+	index.insert(cv::Rect(0, 0, 2000, 2000));	// far too many cells, so this goes in the list of large rectangles
+	index.insert(cv::Rect(50, 50, 4, 4));
+	index.insert(cv::Rect(-3000, 10, 6000, 5));
+
+	// the large rectangles are returned in ID order together with the ones from the grid
+	ASSERT_EQ(index.find(cv::Point(101, 101)), std::vector<size_t>({0, 1}));
+	ASSERT_EQ(index.find(cv::Point(1999, 1999)), std::vector<size_t>({1}));
+	ASSERT_EQ(index.find(cv::Point(-2000, 12)), std::vector<size_t>({3}));
+	ASSERT_EQ(index.find(cv::Rect(49, 9, 60, 95)), std::vector<size_t>({0, 1, 2, 3}));
+	ASSERT_EQ(index.find(cv::Rect(2000, 2000, 10, 10)), std::vector<size_t>());
+}
+
+
+TEST(SpatialIndex, BuildMatchesLinearScan)
+{
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> position(-200, 2000);
+	std::uniform_int_distribution<int> size(0, 150);
+	std::uniform_int_distribution<int> large(500, 3000);
+
+	std::vector<cv::Rect> rects;
+	for (size_t idx = 0; idx < 500; idx ++)
+	{
+		// include the occasional very large rectangle so both the grid and the list of large rectangles are used
+		const bool is_large = (idx % 50 == 0);
+		rects.emplace_back(position(rng), position(rng), is_large ? large(rng) : size(rng), is_large ? large(rng) : size(rng));
+	}
+
+	dm::SpatialIndex index;
+	index.build(rects);
+	ASSERT_EQ(index.size(), rects.size());
+
+	for (size_t idx = 0; idx < 300; idx ++)
+	{
+		const cv::Point p(position(rng), position(rng));
+		ASSERT_EQ(index.find(p), linear_find(rects, p)) << "idx=" << idx;
+
+		// the small areas use the grid, while the very large areas are compared against every rectangle
+		const cv::Rect r(p.x, p.y, (idx % 10 == 0 ? large(rng) : size(rng)), (idx % 10 == 0 ? large(rng) : size(rng)));
+		ASSERT_EQ(index.find(r), linear_find(rects, r)) << "idx=" << idx;
+	}
+
+	// rebuilding replaces the previous content
+	index.build({cv::Rect(5, 5, 5, 5)});
+	ASSERT_EQ(index.size(), 1);
+	ASSERT_EQ(index.find(cv::Rect(0, 0, 3000, 3000)), std::vector<size_t>({0}));
+}
@@ -0,0 +1,154 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include <gtest/gtest.h>
+#include "DarkMark.hpp"
+
+
+TEST(RunningStats, Empty)
+{
+	dm::RunningStats stats;
+
+	ASSERT_EQ(stats.count(), 0);
+	ASSERT_EQ(stats.mean(), 0.0);
+	ASSERT_EQ(stats.variance(), 0.0);
+	ASSERT_EQ(stats.standard_deviation(), 0.0);
+}
+
+
+TEST(RunningStats, SinglePass)
+{
+	dm::RunningStats stats;
+	for (const double value : {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0})
+	{
+		stats.add(value);
+	}
+
+	ASSERT_EQ(stats.count(), 8);
+	ASSERT_DOUBLE_EQ(stats.mean(), 5.0);
+	ASSERT_DOUBLE_EQ(stats.variance(), 4.0);
+	ASSERT_DOUBLE_EQ(stats.standard_deviation(), 2.0);
+	ASSERT_EQ(stats.min(), 2.0);
+	ASSERT_EQ(stats.max(), 9.0);
+}
+
+
+TEST(RunningStats, MergeMatchesSinglePass)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+
+	dm::RunningStats single;
+	std::vector<dm::RunningStats> parts(7);
+	for (size_t idx = 0; idx < 10000; idx ++)
+	{
+		const double value = uniform(rng);
+		single.add(value);
+
+		// uneven split so the parts don't all have the same number of values
+		parts[(idx * idx) % parts.size()].add(value);
+	}
+
+	dm::RunningStats merged;
+	for (const auto & part : parts)
+	{
+		merged.merge(part);
+	}
+
+	ASSERT_EQ(merged.count(), single.count());
+	ASSERT_NEAR(merged.mean(), single.mean(), 1e-9);
+	ASSERT_NEAR(merged.variance(), single.variance(), single.variance() * 1e-9);
+	ASSERT_EQ(merged.min(), single.min());
+	ASSERT_EQ(merged.max(), single.max());
+}
+
+
+TEST(RunningStats, MergeEmpty)
+{
+	dm::RunningStats stats;
+	stats.add(3.0).add(5.0);
+
+	dm::RunningStats empty;
+	stats.merge(empty);
+	ASSERT_EQ(stats.count(), 2);
+	ASSERT_DOUBLE_EQ(stats.mean(), 4.0);
+
+	empty.merge(stats);
+	ASSERT_EQ(empty.count(), 2);
+	ASSERT_DOUBLE_EQ(empty.mean(), 4.0);
+	ASSERT_DOUBLE_EQ(empty.variance(), 1.0);
+	ASSERT_EQ(empty.min(), 3.0);
+	ASSERT_EQ(empty.max(), 5.0);
+}
+
+
+TEST(QuantileSketch, Empty)
+{
+	dm::QuantileSketch sketch;
+
+	ASSERT_EQ(sketch.count(), 0);
+	ASSERT_EQ(sketch.quantile(0.5), 0.0);
+}
+
+
+TEST(QuantileSketch, RelativeAccuracy)
+{
+	for (const double accuracy : {0.01, 0.05})
+	{
+		std::mt19937 rng(5678);
+		std::lognormal_distribution<double> lognormal(3.0, 2.0);
+
+		dm::QuantileSketch sketch(accuracy);
+		std::vector<double> values;
+		for (size_t idx = 0; idx < 20000; idx ++)
+		{
+			const double value = lognormal(rng);
+			values.push_back(value);
+			sketch.add(value);
+		}
+		std::sort(values.begin(), values.end());
+
+		ASSERT_EQ(sketch.count(), values.size());
+		for (const double q : {0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 1.0})
+		{
+			// this uses the same rank as QuantileSketch::quantile()
+			const double exact = values[std::round(q * (values.size() - 1))];
+			ASSERT_NEAR(sketch.quantile(q), exact, exact * accuracy) << "accuracy=" << accuracy << " q=" << q;
+		}
+	}
+}
+
+
+TEST(QuantileSketch, Zeros)
+{
+	dm::QuantileSketch sketch;
+	sketch.add(0.0, 50).add(-3.0, 10).add(100.0, 40);
+
+	ASSERT_EQ(sketch.count(), 100);
+	ASSERT_EQ(sketch.quantile(0.0), 0.0);
+	ASSERT_EQ(sketch.quantile(0.5), 0.0);
+	ASSERT_NEAR(sketch.quantile(0.9), 100.0, 1.0);
+	ASSERT_NEAR(sketch.quantile(1.0), 100.0, 1.0);
+}
+
+
+TEST(QuantileSketch, MergeMatchesSinglePass)
+{
+	dm::QuantileSketch single;
+	dm::QuantileSketch lhs;
+	dm::QuantileSketch rhs;
+	for (size_t idx = 1; idx <= 1000; idx ++)
+	{
+		single.add(idx);
+		(idx % 3 == 0 ? rhs : lhs).add(idx);
+	}
+	lhs.merge(rhs);
+
+	ASSERT_EQ(lhs.count(), single.count());
+	for (const double q : {0.0, 0.1, 0.5, 0.9, 1.0})
+	{
+		ASSERT_EQ(lhs.quantile(q), single.quantile(q));
+	}
+
+	dm::QuantileSketch different(0.05);
+	ASSERT_THROW(lhs.merge(different), std::invalid_argument);
+}
@@ -0,0 +1,404 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+#include <cstring>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+
+const std::string dm::AnnotationIndex::filename = "darkmark_annotation_index.dat";
+
+
+/** Increment this every time the layout of the index file changes.  Index files with a different version are ignored
+ * and the index is rebuilt from the .json files.
+ */
+static const uint32_t index_file_version = 2;
+
+static const char index_file_magic[4] = {'D', 'M', 'A', 'I'};
+
+
+/// Convert the .json content into a summary.  Throws if the .json is not what DarkMark expects.
+static dm::AnnotationSummary summarize(const json & root)
+{
+	dm::AnnotationSummary summary;
+	summary.exists				= true;
+	summary.is_valid			= true;
+	summary.completely_empty	= root.value("completely_empty", false);
+	summary.timestamp			= root.value("timestamp", std::time_t(0));
+
+	if (root.contains("image"))
+	{
+		summary.image_size.width	= root["image"].value("width"	, 0);
+		summary.image_size.height	= root["image"].value("height"	, 0);
+	}
+
+	if (root.contains("mark"))
+	{
+		for (const auto & j : root["mark"])
+		{
+			dm::MarkSummary m;
+			m.class_idx = j["class_idx"].get<size_t>();
+			if (j.contains("rect"))
+			{
+				const auto & r = j["rect"];
+				m.rect = cv::Rect(r.value("int_x", 0), r.value("int_y", 0), r.value("int_w", 0), r.value("int_h", 0));
+			}
+			summary.marks.push_back(m);
+		}
+	}
+
+	return summary;
+}
+
+
+size_t dm::AnnotationSummary::count_marks(const bool for_sorting_purposes) const
+{
+	size_t result = 0;
+
+	if (exists and is_valid)
+	{
+		result = marks.size();
+
+		if (result > 0 and for_sorting_purposes)
+		{
+			// add 1 when we're counting for sorting purposes, that way
+			// empty images wont be mixed up with images that have 1 mark
+			result ++;
+		}
+
+		if (result == 0 and completely_empty)
+		{
+			// if there are zero marks, then see if the image has been identified
+			// as completely empty, and if so count that as if it was a mark
+			result = 1;
+		}
+	}
+
+	return result;
+}
+
+
+dm::AnnotationIndex::AnnotationIndex(const std::string & project_directory) :
+	project_dir(File(project_directory).getFullPathName().toStdString()),
+	index_file(File(project_directory).getChildFile(filename)),
+	need_to_save(false)
+{
+	return;
+}
+
+
+dm::AnnotationIndex::~AnnotationIndex()
+{
+	return;
+}
+
+
+std::string dm::AnnotationIndex::key_for(const File & json_file) const
+{
+	std::string key = json_file.getFullPathName().toStdString();
+
+	// store the names relative to the project so the index remains valid if the project directory is moved
+	if (key.size() > project_dir.size() + 1 and key.compare(0, project_dir.size(), project_dir) == 0)
+	{
+		key.erase(0, project_dir.size() + 1);
+	}
+
+	return key;
+}
+
+
+dm::AnnotationIndex & dm::AnnotationIndex::load()
+{
+	std::lock_guard<std::mutex> lock(index_lock);
+
+	entries.clear();
+	need_to_save = false;
+
+	if (index_file.existsAsFile() == false)
+	{
+		return *this;
+	}
+
+	const std::string fn = index_file.getFullPathName().toStdString();
+
+	try
+	{
+		std::ifstream ifs(fn, std::ifstream::binary);
+
+		char magic[4] = {0};
+		ifs.read(magic, sizeof(magic));
+		if (std::memcmp(magic, index_file_magic, sizeof(magic)) != 0 or read_pod<uint32_t>(ifs) != index_file_version)
+		{
+			Log("annotation index " + fn + " has an unknown format or version and will be rebuilt");
+			need_to_save = true;
+			return *this;
+		}
+
+		const uint64_t number_of_entries = read_pod<uint64_t>(ifs);
+		entries.reserve(number_of_entries);
+
+		for (uint64_t idx = 0; idx < number_of_entries; idx ++)
+		{
+			const std::string key = read_str(ifs);
+
+			AnnotationSummary & summary = entries[key];
+			summary.exists				= true;
+			summary.file_time			= read_pod<int64>(ifs);
+			summary.file_size			= read_pod<int64>(ifs);
+			const uint8_t flags			= read_pod<uint8_t>(ifs);
+			summary.is_valid			= (flags & 0x01) != 0;
+			summary.completely_empty	= (flags & 0x02) != 0;
+			summary.timestamp			= read_pod<int64_t>(ifs);
+			summary.image_size.width	= read_pod<int32_t>(ifs);
+			summary.image_size.height	= read_pod<int32_t>(ifs);
+			summary.probed_image_size.width		= read_pod<int32_t>(ifs);
+			summary.probed_image_size.height	= read_pod<int32_t>(ifs);
+			summary.image_file_time				= read_pod<int64>(ifs);
+			summary.image_file_size				= read_pod<int64>(ifs);
+			if (summary.is_valid == false)
+			{
+				summary.error = read_str(ifs);
+			}
+
+			const uint32_t number_of_marks = read_pod<uint32_t>(ifs);
+			summary.marks.resize(number_of_marks);
+			for (auto & m : summary.marks)
+			{
+				m.class_idx		= read_pod<uint32_t>(ifs);
+				m.rect.x		= read_pod<int32_t>(ifs);
+				m.rect.y		= read_pod<int32_t>(ifs);
+				m.rect.width	= read_pod<int32_t>(ifs);
+				m.rect.height	= read_pod<int32_t>(ifs);
+			}
+		}
+
+		Log("loaded " + std::to_string(entries.size()) + " entries from annotation index " + fn);
+	}
+	catch (const std::exception & e)
+	{
+		Log("failed to load annotation index " + fn + ": " + e.what());
+		entries.clear();
+		need_to_save = true;
+	}
+
+	return *this;
+}
+
+
+dm::AnnotationIndex & dm::AnnotationIndex::save()
+{
+	std::lock_guard<std::mutex> lock(index_lock);
+
+	if (need_to_save == false)
+	{
+		return *this;
+	}
+
+	// write to a temporary file and then rename it so the index is never left half-written
+	const File tmp = index_file.getSiblingFile(filename + ".tmp");
+	const std::string fn = tmp.getFullPathName().toStdString();
+
+	try
+	{
+		std::ofstream ofs(fn, std::ofstream::binary | std::ofstream::trunc);
+		ofs.write(index_file_magic, sizeof(index_file_magic));
+		write_pod<uint32_t>(ofs, index_file_version);
+		write_pod<uint64_t>(ofs, entries.size());
+
+		for (const auto & iter : entries)
+		{
+			const auto & summary = iter.second;
+
+			write_str(ofs, iter.first);
+			write_pod<int64>(ofs, summary.file_time);
+			write_pod<int64>(ofs, summary.file_size);
+			write_pod<uint8_t>(ofs, (summary.is_valid ? 0x01 : 0x00) | (summary.completely_empty ? 0x02 : 0x00));
+			write_pod<int64_t>(ofs, summary.timestamp);
+			write_pod<int32_t>(ofs, summary.image_size.width);
+			write_pod<int32_t>(ofs, summary.image_size.height);
+			write_pod<int32_t>(ofs, summary.probed_image_size.width);
+			write_pod<int32_t>(ofs, summary.probed_image_size.height);
+			write_pod<int64>(ofs, summary.image_file_time);
+			write_pod<int64>(ofs, summary.image_file_size);
+			if (summary.is_valid == false)
+			{
+				write_str(ofs, summary.error);
+			}
+
+			write_pod<uint32_t>(ofs, summary.marks.size());
+			for (const auto & m : summary.marks)
+			{
+				write_pod<uint32_t>(ofs, m.class_idx);
+				write_pod<int32_t>(ofs, m.rect.x);
+				write_pod<int32_t>(ofs, m.rect.y);
+				write_pod<int32_t>(ofs, m.rect.width);
+				write_pod<int32_t>(ofs, m.rect.height);
+			}
+		}
+
+		ofs.close();
+		if (ofs.fail())
+		{
+			throw std::runtime_error("failed to write " + fn);
+		}
+
+		if (tmp.moveFileTo(index_file) == false)
+		{
+			throw std::runtime_error("failed to rename " + fn);
+		}
+
+		need_to_save = false;
+	}
+	catch (const std::exception & e)
+	{
+		Log("failed to save annotation index: " + std::string(e.what()));
+		tmp.deleteFile();
+	}
+
+	return *this;
+}
+
+
+dm::AnnotationSummary dm::AnnotationIndex::get(const File & json_file)
+{
+	const std::string key = key_for(json_file);
+
+	if (json_file.existsAsFile() == false)
+	{
+		std::lock_guard<std::mutex> lock(index_lock);
+		if (entries.erase(key))
+		{
+			need_to_save = true;
+		}
+
+		return AnnotationSummary();
+	}
+
+	const int64 file_time = json_file.getLastModificationTime().toMilliseconds();
+	const int64 file_size = json_file.getSize();
+
+	{
+		std::lock_guard<std::mutex> lock(index_lock);
+		auto iter = entries.find(key);
+		if (iter != entries.end() and iter->second.file_time == file_time and iter->second.file_size == file_size)
+		{
+			return iter->second;
+		}
+	}
+
+	// if we get here then the .json file is new or has changed, so we need to parse it (without holding the lock)
+
+	AnnotationSummary summary;
+	try
+	{
+		summary = summarize(json::parse(json_file.loadFileAsString().toStdString()));
+	}
+	catch (const std::exception & e)
+	{
+		summary = AnnotationSummary();
+		summary.exists		= true;
+		summary.is_valid	= false;
+		summary.error		= e.what();
+	}
+	summary.file_time = file_time;
+	summary.file_size = file_size;
+
+	std::lock_guard<std::mutex> lock(index_lock);
+	store(key, summary);
+
+	return summary;
+}
+
+
+dm::AnnotationSummary dm::AnnotationIndex::get_for_image(const std::string & image_filename)
+{
+	return get(File(image_filename).withFileExtension(".json"));
+}
+
+
+dm::AnnotationIndex & dm::AnnotationIndex::update(const File & json_file, AnnotationSummary summary)
+{
+	if (json_file.existsAsFile() == false)
+	{
+		return remove(json_file);
+	}
+
+	summary.exists		= true;
+	summary.is_valid	= true;
+	summary.file_time	= json_file.getLastModificationTime().toMilliseconds();
+	summary.file_size	= json_file.getSize();
+
+	std::lock_guard<std::mutex> lock(index_lock);
+	store(key_for(json_file), summary);
+
+	return *this;
+}
+
+
+void dm::AnnotationIndex::store(const std::string & key, AnnotationSummary & summary)
+{
+	auto iter = entries.find(key);
+	if (iter != entries.end())
+	{
+		summary.probed_image_size	= iter->second.probed_image_size;
+		summary.image_file_time		= iter->second.image_file_time;
+		summary.image_file_size		= iter->second.image_file_size;
+	}
+
+	entries[key] = summary;
+	need_to_save = true;
+
+	return;
+}
+
+
+cv::Size dm::AnnotationIndex::get_image_size(const std::string & image_filename)
+{
+	const File image_file(image_filename);
+	const File json_file = image_file.withFileExtension(".json");
+	const int64 file_time = image_file.getLastModificationTime().toMilliseconds();
+	const int64 file_size = image_file.getSize();
+
+	// this also takes care of re-parsing the .json file if it has changed
+	const AnnotationSummary summary = get(json_file);
+	if (summary.probed_image_size.area() > 0 and summary.image_file_time == file_time and summary.image_file_size == file_size)
+	{
+		return summary.probed_image_size;
+	}
+
+	cv::Size size = probe_image_size(image_filename);
+	if (size.area() > 0 and summary.exists)
+	{
+		// the size is only remembered for images which have a .json file, since the entries are for the .json files
+		std::lock_guard<std::mutex> lock(index_lock);
+		auto iter = entries.find(key_for(json_file));
+		if (iter != entries.end())
+		{
+			iter->second.probed_image_size	= size;
+			iter->second.image_file_time	= file_time;
+			iter->second.image_file_size	= file_size;
+			need_to_save = true;
+		}
+	}
+
+	if (size.area() <= 0)
+	{
+		// this is not an image format we know how to probe, so use the size which was last seen when annotating the image
+		size = summary.image_size;
+	}
+
+	return size;
+}
+
+
+dm::AnnotationIndex & dm::AnnotationIndex::remove(const File & json_file)
+{
+	std::lock_guard<std::mutex> lock(index_lock);
+	if (entries.erase(key_for(json_file)))
+	{
+		need_to_save = true;
+	}
+
+	return *this;
+}
@@ -0,0 +1,143 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/// Summary of a single mark as stored in a .json file.  @see @ref AnnotationSummary
+	struct MarkSummary
+	{
+		size_t		class_idx;
+		cv::Rect	rect;		///< The non-normalized rectangle, same as @p int_x, @p int_y, @p int_w, and @p int_h in the .json file.
+
+		MarkSummary() : class_idx(0) {}
+	};
+	typedef std::vector<MarkSummary> VMarkSummary;
+
+
+	/** Everything most of DarkMark needs to know about a .json annotation file, without needing to parse the .json file.
+	 * @see @ref AnnotationIndex
+	 */
+	struct AnnotationSummary
+	{
+		/// Set to @p true if the .json file exists.  When @p false, all other fields are meaningless.
+		bool exists;
+
+		/// Set to @p false if the .json file exists but could not be parsed.  See @ref error for details.
+		bool is_valid;
+
+		/// Modification time (milliseconds) and size (bytes) of the .json file.  This is used to know if the summary is stale.  @{
+		int64 file_time;
+		int64 file_size;
+		/// @}
+
+		/// The @p completely_empty field from the .json file.
+		bool completely_empty;
+
+		/// The @p timestamp field from the .json file, or zero if it was not set.
+		std::time_t timestamp;
+
+		/// The @p width and @p height fields from the .json file.
+		cv::Size image_size;
+
+		/// Dimensions read from the image file header by @ref AnnotationIndex::get_image_size(), or empty if not yet known.
+		cv::Size probed_image_size;
+
+		/// Modification time (milliseconds) and size (bytes) of the image file when @ref probed_image_size was read.  @{
+		int64 image_file_time;
+		int64 image_file_size;
+		/// @}
+
+		/// All of the marks in the .json file.
+		VMarkSummary marks;
+
+		/// Error message from nlohmann::json when @ref is_valid is @p false.
+		std::string error;
+
+		AnnotationSummary() :
+			exists(false),
+			is_valid(true),
+			file_time(0),
+			file_size(0),
+			completely_empty(false),
+			timestamp(0),
+			image_file_time(0),
+			image_file_size(0)
+		{
+			return;
+		}
+
+		/** Similar to the old behaviour of parsing .json files:  returns the number of marks, but will return @p 1 for
+		 * negative samples.  When @p for_sorting_purposes is set, images with marks are given 1 extra count so they are
+		 * sorted after negative samples.
+		 */
+		size_t count_marks(const bool for_sorting_purposes = false) const;
+	};
+
+
+	/** Persistent index of all the .json annotation files in a project.  Many parts of DarkMark need to know how many marks
+	 * exist in an image, which classes are used, the timestamp, etc.  Parsing every .json file each time is very slow on
+	 * large projects, so instead the summaries are kept in a compact binary file within the project directory.
+	 *
+	 * Each entry is validated against the .json file's modification time and size.  If the .json file has changed since
+	 * it was last indexed, then it is re-parsed.  All methods are thread-safe.
+	 */
+	class AnnotationIndex final
+	{
+		public:
+
+			AnnotationIndex(const std::string & project_directory);
+
+			~AnnotationIndex();
+
+			/// Load the index from disk.  Any problems will result in an empty index which will be rebuilt as needed.
+			AnnotationIndex & load();
+
+			/// Write the index to disk, but only if something has changed since it was last loaded or saved.
+			AnnotationIndex & save();
+
+			/// Get the summary for the given .json file.  The .json file is only parsed if it has changed since it was indexed.
+			AnnotationSummary get(const File & json_file);
+
+			/// Get the summary for the .json file which belongs to the given image.
+			AnnotationSummary get_for_image(const std::string & image_filename);
+
+			/** Get the dimensions of an image without decoding it.  The image file header is only read (see @ref
+			 * probe_image_size()) if the image has changed since it was last probed, otherwise the size comes from the index.
+			 * If the header cannot be parsed then the size stored in the .json file is used.  @returns an empty size if the
+			 * dimensions are not known.
+			 */
+			cv::Size get_image_size(const std::string & image_filename);
+
+			/** Update the entry for the given .json file using a summary built by the caller, such as @ref DMContent::save_json()
+			 * which already knows all of the marks and doesn't need the .json file to be parsed again.  The file time and size
+			 * are read from the .json file, so this must be called after the file has been written.
+			 */
+			AnnotationIndex & update(const File & json_file, AnnotationSummary summary);
+
+			/// Remove the entry for the given .json file.
+			AnnotationIndex & remove(const File & json_file);
+
+			/// The name of the file within the project directory where the index is stored.
+			static const std::string filename;
+
+		private:
+
+			/// Convert the full .json filename into the key used to store it.
+			std::string key_for(const File & json_file) const;
+
+			/** Store the summary, keeping the probed image size from the previous entry since that doesn't depend on the .json
+			 * file.  The caller must hold @ref index_lock.
+			 */
+			void store(const std::string & key, AnnotationSummary & summary);
+
+			std::string project_dir;
+			File index_file;
+			std::mutex index_lock;
+			std::unordered_map<std::string, AnnotationSummary> entries;
+			bool need_to_save;
+	};
+}
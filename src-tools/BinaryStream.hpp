@@ -0,0 +1,63 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Helpers to read and write the compact binary cache files DarkMark keeps in the project directory, such as the
+	 * @ref AnnotationIndex.  These are only meant for simple fixed-size types and strings.  Files are written in the native
+	 * byte order, which is fine since the caches are rebuilt if they cannot be read.
+	 * @{
+	 */
+	template <typename T>
+	inline void write_pod(std::ostream & os, const T & value)
+	{
+		os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+
+		return;
+	}
+
+
+	template <typename T>
+	inline T read_pod(std::istream & is)
+	{
+		T value = T();
+		is.read(reinterpret_cast<char *>(&value), sizeof(T));
+		if (not is.good())
+		{
+			throw std::runtime_error("unexpected end of binary file");
+		}
+
+		return value;
+	}
+
+
+	inline void write_str(std::ostream & os, const std::string & str)
+	{
+		write_pod<uint32_t>(os, str.size());
+		os.write(str.data(), str.size());
+
+		return;
+	}
+
+
+	inline std::string read_str(std::istream & is)
+	{
+		const uint32_t len = read_pod<uint32_t>(is);
+		std::string str(len, '\0');
+		if (len > 0)
+		{
+			is.read(&str[0], len);
+			if (not is.good())
+			{
+				throw std::runtime_error("unexpected end of binary file");
+			}
+		}
+
+		return str;
+	}
+	/// @}
+}
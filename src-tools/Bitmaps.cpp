@@ -52,6 +52,33 @@ Image dm::convert_opencv_mat_to_juce_image(cv::Mat mat)
 }
 
 
+void dm::copy_opencv_mat_to_juce_image(cv::Mat mat, Image & image, const cv::Rect & r)
+{
+	if (mat.channels() != 3 or mat.cols != image.getWidth() or mat.rows != image.getHeight())
+	{
+		throw std::logic_error("cannot copy cv::Mat to a JUCE image of a different size or format");
+	}
+
+	const cv::Rect roi = r & cv::Rect(0, 0, mat.cols, mat.rows);
+	if (roi.empty())
+	{
+		return;
+	}
+
+	const size_t number_of_bytes_to_copy = 3 * roi.width;
+	Image::BitmapData bitmap_data(image, roi.x, roi.y, roi.width, roi.height, Image::BitmapData::ReadWriteMode::writeOnly);
+	for (int row_index = 0; row_index < roi.height; row_index ++)
+	{
+		const uint8_t * src_ptr = mat.ptr(roi.y + row_index) + 3 * roi.x;
+		uint8_t * dst_ptr = bitmap_data.getLinePointer(row_index);
+
+		std::memcpy(dst_ptr, src_ptr, number_of_bytes_to_copy);
+	}
+
+	return;
+}
+
+
 Image dm::AboutLogoWhiteBackground()
 {
 	return ImageCache::getFromMemory(ccr_darkmark_logo_white_background_png, sizeof(ccr_darkmark_logo_white_background_png));
@@ -11,6 +11,9 @@ namespace dm
 
 	Image convert_opencv_mat_to_juce_image(cv::Mat mat);
 
+	/// Copy the region @p r of a 3-channel image to an existing JUCE image of the exact same size.
+	void copy_opencv_mat_to_juce_image(cv::Mat mat, Image & image, const cv::Rect & r);
+
 	Image AboutLogoWhiteBackground();
 	Image AboutLogoRedSwirl();
 	Image AboutLogoDarknet();
@@ -69,6 +69,11 @@ dm::Cfg & dm::Cfg::first_time_initialization(void)
 	insert_if_not_exist("snap_horizontal_tolerance"		, 5													);
 	insert_if_not_exist("snap_vertical_tolerance"		, 1													);
 	insert_if_not_exist("snapping_enabled"				, false												);
+	insert_if_not_exist("prefetch_image_count"			, 3													);
+	insert_if_not_exist("prefetch_memory_budget_mb"		, 512												);
+	insert_if_not_exist("predict_all_threads"			, 0													); // zero means one thread per CPU core
+	insert_if_not_exist("prediction_cache_max_entries"	, 50000												);
+	insert_if_not_exist("near_duplicate_distance"		, 6													); // number of bits which may differ in the perceptual hash
 
 	removeValue("darknet_enable_hue");	// this was changed to the float value darknet_hue
 	removeValue("darknet_trailing_percentage");	// typo:  "trailing" -> "training"
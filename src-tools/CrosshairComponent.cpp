@@ -21,6 +21,7 @@ dm::CrosshairComponent::CrosshairComponent(DMContent & c) :
 	mouse_down_loc(invalid_point),
 	mouse_drag_rectangle(invalid_rectangle),
 	need_to_rebuild_cache_image(true),
+	cached_image_origin(0, 0),
 	zoom_image_offset(0, 0)
 {
 	setBufferedToImage(false);
@@ -80,7 +81,7 @@ void dm::CrosshairComponent::paint(Graphics & g)
 	{
 		const int h = getHeight();
 		const int w = getWidth();
-		g.drawImage(cached_image, 0, 0, w, h, zoom_image_offset.x, zoom_image_offset.y, w, h);
+		g.drawImage(cached_image, 0, 0, w, h, zoom_image_offset.x - cached_image_origin.x, zoom_image_offset.y - cached_image_origin.y, w, h);
 
 		if (mouse_drag_is_enabled and mouse_drag_rectangle != invalid_rectangle)
 		{
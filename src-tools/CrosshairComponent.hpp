@@ -71,6 +71,11 @@ namespace dm
 			juce::Image cached_image;
 			bool need_to_rebuild_cache_image;
 
+			/** The location of the top-left corner of @ref cached_image within the image.  This is (0, 0) unless the
+			 * cached image only contains the portion of the image which is visible.  @see @ref zoom_image_offset
+			 */
+			cv::Point cached_image_origin;
+
 			/** The top-left offset into the image so we know what needs to be displayed.
 			 * Normally, this value will be (0, 0) unless the image is zoomed in.
 			 */
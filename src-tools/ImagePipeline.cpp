@@ -0,0 +1,411 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+
+
+class dm::ImagePipeline::Queue final
+{
+	public:
+
+		Queue(const size_t c) :
+			capacity(std::max(c, size_t(1))),
+			closed(false),
+			aborted(false)
+		{
+			return;
+		}
+
+		/// Blocks while the queue is full.  @returns @p false if the pipeline has been aborted.
+		bool push(const size_t idx)
+		{
+			std::unique_lock<std::mutex> lock(m);
+			not_full.wait(lock, [&] { return aborted or q.size() < capacity; });
+			if (aborted)
+			{
+				return false;
+			}
+			q.push_back(idx);
+			not_empty.notify_one();
+
+			return true;
+		}
+
+		/// Blocks while the queue is empty.  @returns @p false once the queue has been closed and is empty, or if aborted.
+		bool pop(size_t & idx)
+		{
+			std::unique_lock<std::mutex> lock(m);
+			not_empty.wait(lock, [&] { return aborted or closed or q.empty() == false; });
+			if (aborted or q.empty())
+			{
+				return false;
+			}
+			idx = q.front();
+			q.pop_front();
+			not_full.notify_one();
+
+			return true;
+		}
+
+		/// Nothing else will be pushed, so the consumers can stop once the queue is empty.
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(m);
+			closed = true;
+			not_empty.notify_all();
+
+			return;
+		}
+
+		/// Wake up all the producers and consumers, which then discard anything left in the queue.
+		void abort()
+		{
+			std::lock_guard<std::mutex> lock(m);
+			aborted = true;
+			not_empty.notify_all();
+			not_full.notify_all();
+
+			return;
+		}
+
+	private:
+
+		const size_t capacity;
+		bool closed;
+		bool aborted;
+		std::deque<size_t> q;
+		std::mutex m;
+		std::condition_variable not_full;
+		std::condition_variable not_empty;
+};
+
+
+static uint64_t microseconds_since(const std::chrono::high_resolution_clock::time_point & start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+dm::ImagePipeline::ImagePipeline(const std::string & n) :
+	jpeg_quality(75),
+	name(n)
+{
+	// split the cores between the 3 stages; the queues are bounded so a stage which falls behind will slow down the others
+	const size_t number_of_cores = std::max(1U, std::thread::hardware_concurrency());
+	decode_threads		= std::max(size_t(1), number_of_cores / 3);
+	transform_threads	= std::max(size_t(1), number_of_cores / 3);
+	encode_threads		= std::max(size_t(1), number_of_cores / 3);
+
+	decode_stage	.name = "decode";
+	transform_stage	.name = "transform";
+	encode_stage	.name = "encode";
+
+	return;
+}
+
+
+dm::ImagePipeline::~ImagePipeline()
+{
+	return;
+}
+
+
+std::vector<dm::ImagePipeline::Item> dm::ImagePipeline::run(ThreadWithProgressWindow & progress_window, const VStr & source_images, Transform transform, Prepare prepare)
+{
+	const size_t number_of_images = source_images.size();
+
+	// the seeds are taken from the shared random engine in the original order, so the results don't depend on the threads
+	auto & rng = get_random_engine();
+	items.clear();
+	items.resize(number_of_images);
+	for (size_t idx = 0; idx < number_of_images; idx ++)
+	{
+		Item & item			= items[idx];
+		item.idx			= idx;
+		item.source_image	= source_images[idx];
+		item.seed			= rng();
+		item.needs_decoding	= true;
+		item.modified		= false;
+	}
+
+	next_decode_idx	= 0;
+	items_finished	= 0;
+	items_reused	= 0;
+	error			= nullptr;
+
+	for (Stage * stage : {&decode_stage, &transform_stage, &encode_stage})
+	{
+		stage->items				= 0;
+		stage->outputs				= 0;
+		stage->busy_microseconds	= 0;
+	}
+	decode_stage	.threads = std::max(size_t(1), std::min(decode_threads		, number_of_images));
+	transform_stage	.threads = std::max(size_t(1), std::min(transform_threads	, number_of_images));
+	encode_stage	.threads = std::max(size_t(1), std::min(encode_threads		, number_of_images));
+	decode_stage	.running = decode_stage		.threads;
+	transform_stage	.running = transform_stage	.threads;
+	encode_stage	.running = encode_stage		.threads;
+
+	// a couple of extra slots per queue so the consumers don't sit idle while the producers are busy
+	transform_queue	.reset(new Queue(transform_stage	.threads + 2));
+	encode_queue	.reset(new Queue(encode_stage		.threads + 2));
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < decode_stage.threads; idx ++)
+	{
+		threads.emplace_back(&ImagePipeline::decode_worker, this, std::ref(prepare));
+	}
+	for (size_t idx = 0; idx < transform_stage.threads; idx ++)
+	{
+		threads.emplace_back(&ImagePipeline::transform_worker, this, std::ref(transform));
+	}
+	for (size_t idx = 0; idx < encode_stage.threads; idx ++)
+	{
+		threads.emplace_back(&ImagePipeline::encode_worker, this);
+	}
+
+	bool cancelled = false;
+	while (encode_stage.running > 0)
+	{
+		if (progress_window.threadShouldExit() and cancelled == false)
+		{
+			cancelled = true;
+			transform_queue->abort();
+			encode_queue->abort();
+		}
+		progress_window.setProgress(static_cast<double>(items_finished) / (number_of_images + 1.0));
+		progress_window.wait(100);
+	}
+
+	for (auto & t : threads)
+	{
+		t.join();
+	}
+
+	const double seconds = microseconds_since(start_time) / 1000000.0;
+	Log(name + " pipeline: processed " + std::to_string(items_finished) + " of " + std::to_string(number_of_images) + " images in " + std::to_string(seconds) + " seconds (" + std::to_string(items_reused) + " images did not need to be decoded)");
+	for (const Stage * stage : {&decode_stage, &transform_stage, &encode_stage})
+	{
+		log_stage(*stage, seconds);
+	}
+
+	transform_queue.reset();
+	encode_queue.reset();
+
+	if (error)
+	{
+		items.clear();
+		std::rethrow_exception(error);
+	}
+
+	if (cancelled)
+	{
+		items.clear();
+		throw std::runtime_error("image processing was cancelled");
+	}
+
+	std::vector<Item> results;
+	results.swap(items);
+
+	return results;
+}
+
+
+void dm::ImagePipeline::decode_worker(Prepare & prepare)
+{
+	try
+	{
+		while (true)
+		{
+			const size_t idx = next_decode_idx ++;
+			if (idx >= items.size())
+			{
+				break;
+			}
+
+			const auto start_time = std::chrono::high_resolution_clock::now();
+
+			Item & item = items[idx];
+			if (prepare)
+			{
+				prepare(item);
+			}
+
+			if (item.needs_decoding)
+			{
+				item.mat = cv::imread(item.source_image);
+				if (item.mat.empty())
+				{
+					// something has gone *very* wrong if we cannot read the image
+					throw std::runtime_error("failed to open or read the image " + item.source_image);
+				}
+				decode_stage.items ++;
+			}
+			else
+			{
+				items_reused ++;
+			}
+
+			decode_stage.busy_microseconds += microseconds_since(start_time);
+
+			if (transform_queue->push(idx) == false)
+			{
+				break;
+			}
+		}
+	}
+	catch (...)
+	{
+		fail(std::current_exception());
+	}
+
+	if (-- decode_stage.running == 0)
+	{
+		transform_queue->close();
+	}
+
+	return;
+}
+
+
+void dm::ImagePipeline::transform_worker(Transform & transform)
+{
+	try
+	{
+		size_t idx = 0;
+		while (transform_queue->pop(idx))
+		{
+			const auto start_time = std::chrono::high_resolution_clock::now();
+
+			Item & item = items[idx];
+			if (item.needs_decoding)
+			{
+				transform(item);
+
+				// the outputs hold on to whatever they need from the source image, so it can be released now
+				item.mat.release();
+
+				transform_stage.busy_microseconds += microseconds_since(start_time);
+				transform_stage.items ++;
+				transform_stage.outputs += std::count_if(item.outputs.begin(), item.outputs.end(), [](const Output & output) { return output.reused == false; });
+			}
+
+			if (encode_queue->push(idx) == false)
+			{
+				break;
+			}
+		}
+	}
+	catch (...)
+	{
+		fail(std::current_exception());
+	}
+
+	if (-- transform_stage.running == 0)
+	{
+		encode_queue->close();
+	}
+
+	return;
+}
+
+
+void dm::ImagePipeline::encode_worker()
+{
+	try
+	{
+		size_t idx = 0;
+		while (encode_queue->pop(idx))
+		{
+			const auto start_time = std::chrono::high_resolution_clock::now();
+
+			Item & item = items[idx];
+			for (auto & output : item.outputs)
+			{
+				if (output.reused)
+				{
+					continue;
+				}
+
+				/* The output files might be hard links to the source images from a previous run where no resize was needed.
+				 * Remove them first, otherwise writing to them would modify the original image and annotations.
+				 */
+				std::error_code ec;
+				std::filesystem::remove(output.image_filename, ec);
+				std::filesystem::remove(output.label_filename, ec);
+
+				if (cv::imwrite(output.image_filename, output.mat, {cv::ImwriteFlags::IMWRITE_JPEG_QUALITY, jpeg_quality}) == false)
+				{
+					throw std::runtime_error("failed to write the image " + output.image_filename);
+				}
+				output.mat.release();
+
+				std::ofstream ofs(output.label_filename);
+				ofs << output.labels;
+				if (ofs.fail())
+				{
+					throw std::runtime_error("failed to write the annotations " + output.label_filename);
+				}
+				output.labels.clear();
+				encode_stage.outputs ++;
+			}
+
+			encode_stage.busy_microseconds += microseconds_since(start_time);
+			encode_stage.items ++;
+			items_finished ++;
+		}
+	}
+	catch (...)
+	{
+		fail(std::current_exception());
+	}
+
+	encode_stage.running --;
+
+	return;
+}
+
+
+void dm::ImagePipeline::fail(std::exception_ptr e)
+{
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(error_lock);
+		if (error == nullptr)
+		{
+			error = e;
+		}
+	}
+
+	// stop all the other threads; the decode threads notice when they next try to push an image
+	transform_queue->abort();
+	encode_queue->abort();
+
+	return;
+}
+
+
+void dm::ImagePipeline::log_stage(const Stage & stage, const double seconds) const
+{
+	const double busy_seconds = stage.busy_microseconds / 1000000.0;
+
+	std::stringstream ss;
+	ss	<< std::fixed << std::setprecision(1)
+		<< name << " pipeline " << stage.name << " stage: "
+		<< stage.threads << " thread" << (stage.threads == 1 ? "" : "s") << ", "
+		<< stage.items << " image" << (stage.items == 1 ? "" : "s");
+	if (&stage != &decode_stage)
+	{
+		ss << " (" << stage.outputs << " output" << (stage.outputs == 1 ? "" : "s") << ")";
+	}
+	ss	<< ", " << (seconds > 0.0 ? stage.items / seconds : 0.0) << " images/sec"
+		<< ", " << (busy_seconds > 0.0 ? stage.items / busy_seconds : 0.0) << " images/sec/thread"
+		<< ", " << (seconds > 0.0 ? 100.0 * busy_seconds / (seconds * stage.threads) : 0.0) << "% busy";
+	Log(ss.str());
+
+	return;
+}
@@ -0,0 +1,124 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Multi-threaded pipeline used to create new images from the images in a project, such as when resizing or tiling
+	 * images for darknet.  There are 3 stages, each with its own threads, and bounded queues between the stages so only a
+	 * few decoded images are ever in memory at once:
+	 *
+	 * @li decode:  read the source image from disk
+	 * @li transform:  call the user-supplied function to create the output images and the annotations
+	 * @li encode:  write the output images and the annotations to disk
+	 *
+	 * The results are stored in the same order as the source images, regardless of which thread processed them, so as long
+	 * as the transform function names the outputs using something like @ref Item::idx or @ref Item::key the output is deterministic.
+	 */
+	class ImagePipeline final
+	{
+		public:
+
+			/// A single image to write to disk.
+			struct Output
+			{
+				size_t group;					///< When a transform creates several kinds of outputs, used to tell them apart.
+				std::string image_filename;
+				cv::Mat mat;					///< Released once the image has been written to disk.
+				std::string label_filename;
+				std::string labels;				///< Content of the darknet .txt file.
+				size_t number_of_marks;			///< Number of annotations in @ref labels.
+				bool reused;					///< Already exists on disk, such as from a previous run, so there is nothing to write.
+			};
+
+			/// Everything needed to process a single source image.
+			struct Item
+			{
+				size_t idx;						///< Index into the vector of source images.
+				std::string source_image;
+				uint32_t seed;					///< Used to seed a random engine, since the shared random engine is not thread-safe.
+				std::string key;				///< Set by the prepare function, meaning is specific to each function.
+				bool needs_decoding;			///< Cleared by the prepare function when all the outputs already exist.
+				std::vector<bool> reused;		///< Set by the prepare function, indexed by @ref Output::group.
+				cv::Mat mat;					///< Decoded source image.  Released once the image has been transformed.
+				std::vector<Output> outputs;	///< Set by the transform function.
+				VStr logs;						///< Set by the transform function, and written to the log files in the original order.  Indexed by @ref Output::group.
+				bool modified;					///< Set by the transform function, meaning is specific to each function.
+			};
+
+			/** Called from several threads at once to create the outputs from a decoded image.  Should throw if something goes
+			 * wrong, in which case the pipeline is stopped and the exception is re-thrown from @ref run().
+			 */
+			typedef std::function<void(Item & item)> Transform;
+
+			/** Optional function called from the decode threads before an image is decoded.  This can fill in the outputs
+			 * which already exist from a previous run, and clear @ref Item::needs_decoding when nothing else needs to be done
+			 * for the image, in which case neither the decode nor the transform stage is run for that image.
+			 */
+			typedef std::function<void(Item & item)> Prepare;
+
+			ImagePipeline(const std::string & name);
+
+			~ImagePipeline();
+
+			/** Process all of the source images and wait until all the output images have been written to disk.  @returns
+			 * the items in the same order as @p source_images, without any of the decoded images.
+			 */
+			std::vector<Item> run(ThreadWithProgressWindow & progress_window, const VStr & source_images, Transform transform, Prepare prepare = nullptr);
+
+			/// Number of threads for each stage.  @{
+			size_t decode_threads;
+			size_t transform_threads;
+			size_t encode_threads;
+			/// @}
+
+			/// JPEG quality used when writing the output images.
+			int jpeg_quality;
+
+		private:
+
+			/// Bounded queue of item indexes between two stages.  Defined in the .cpp file.
+			class Queue;
+
+			/// Throughput counters for one of the stages, written to the log once the pipeline has finished.
+			struct Stage
+			{
+				std::string name;
+				size_t threads;
+				std::atomic<size_t> running;			///< Once this reaches zero, the queue to the next stage is closed.
+				std::atomic<size_t> items;
+				std::atomic<size_t> outputs;
+				std::atomic<uint64_t> busy_microseconds;	///< Total of all threads, does not include time spent waiting on a queue.
+			};
+
+			void decode_worker(Prepare & prepare);
+			void transform_worker(Transform & transform);
+			void encode_worker();
+
+			/// Remember the first exception and tell all the threads to stop.
+			void fail(std::exception_ptr e);
+
+			void log_stage(const Stage & stage, const double seconds) const;
+
+			/// Name shown in the log, such as @p "resize".
+			std::string name;
+
+			std::vector<Item> items;
+			std::atomic<size_t> next_decode_idx;
+			std::atomic<size_t> items_finished;
+			std::atomic<size_t> items_reused;		///< Images which didn't need to be decoded.
+
+			Stage decode_stage;
+			Stage transform_stage;
+			Stage encode_stage;
+
+			std::unique_ptr<Queue> transform_queue;
+			std::unique_ptr<Queue> encode_queue;
+
+			std::mutex error_lock;
+			std::exception_ptr error;
+	};
+}
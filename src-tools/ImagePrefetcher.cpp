@@ -0,0 +1,245 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+
+dm::ImagePrefetcher::ImagePrefetcher() :
+	Thread("image prefetch thread"),
+	generation(0),
+	memory_budget(0),
+	memory_used(0)
+{
+	return;
+}
+
+
+dm::ImagePrefetcher::~ImagePrefetcher()
+{
+	if (isThreadRunning())
+	{
+		cancel();
+		signalThreadShouldExit();
+		work_available.signal();
+
+		// never kill the thread while it is inside imread(); large TIFFs or images on a network share can take a while
+		waitForThreadToExit(-1);
+	}
+
+	return;
+}
+
+
+dm::ImagePrefetcher & dm::ImagePrefetcher::set_memory_budget(const size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(cache_lock);
+	memory_budget = bytes;
+	evict();
+
+	return *this;
+}
+
+
+dm::ImagePrefetcher & dm::ImagePrefetcher::prefetch(const VStr & filenames)
+{
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(cache_lock);
+
+		if (memory_budget == 0)
+		{
+			// prefetching has been disabled
+			return *this;
+		}
+
+		pending.clear();
+		for (const auto & fn : filenames)
+		{
+			if (cache.count(fn) == 0)
+			{
+				pending.push_back(fn);
+			}
+		}
+	}
+
+	if (isThreadRunning() == false)
+	{
+		startThread(3); // use a lower priority than the GUI thread
+	}
+	work_available.signal();
+
+	return *this;
+}
+
+
+dm::ImagePrefetcher & dm::ImagePrefetcher::cancel()
+{
+	std::lock_guard<std::mutex> lock(cache_lock);
+	pending.clear();
+	generation ++;
+
+	return *this;
+}
+
+
+dm::ImagePrefetcher & dm::ImagePrefetcher::clear()
+{
+	std::lock_guard<std::mutex> lock(cache_lock);
+	pending.clear();
+	generation ++;
+	cache.clear();
+	lru.clear();
+	memory_used = 0;
+
+	return *this;
+}
+
+
+dm::ImagePrefetcher & dm::ImagePrefetcher::invalidate(const std::string & filename)
+{
+	std::lock_guard<std::mutex> lock(cache_lock);
+
+	auto iter = cache.find(filename);
+	if (iter != cache.end())
+	{
+		memory_used -= iter->second.bytes;
+		lru.erase(iter->second.lru);
+		cache.erase(iter);
+	}
+
+	return *this;
+}
+
+
+bool dm::ImagePrefetcher::get(const std::string & filename, cv::Mat & mat)
+{
+	const int64 file_time = File(filename).getLastModificationTime().toMilliseconds();
+
+	std::lock_guard<std::mutex> lock(cache_lock);
+
+	// since we're about to load this image, there is no need to also decode it on the secondary thread
+	auto pending_iter = std::find(pending.begin(), pending.end(), filename);
+	if (pending_iter != pending.end())
+	{
+		pending.erase(pending_iter);
+	}
+
+	auto iter = cache.find(filename);
+	if (iter == cache.end())
+	{
+		return false;
+	}
+
+	Entry & entry = iter->second;
+	if (entry.file_time != file_time)
+	{
+		// the image on disk has changed since it was decoded
+		memory_used -= entry.bytes;
+		lru.erase(entry.lru);
+		cache.erase(iter);
+		return false;
+	}
+
+	// move this image to the front of the LRU list
+	lru.splice(lru.begin(), lru, entry.lru);
+
+	mat = entry.mat;
+
+	return true;
+}
+
+
+void dm::ImagePrefetcher::run()
+{
+	DarkMarkApplication::setup_signal_handling();
+
+	while (threadShouldExit() == false)
+	{
+		std::string filename;
+		size_t expected_generation = 0;
+
+		if (true)
+		{
+			std::lock_guard<std::mutex> lock(cache_lock);
+			while (pending.empty() == false and cache.count(pending.front()) > 0)
+			{
+				pending.pop_front();
+			}
+			if (pending.empty() == false)
+			{
+				filename = pending.front();
+				pending.pop_front();
+				expected_generation = generation;
+			}
+		}
+
+		if (filename.empty())
+		{
+			// nothing to do until prefetch() is called again
+			work_available.wait(500);
+			continue;
+		}
+
+		const int64 file_time = File(filename).getLastModificationTime().toMilliseconds();
+
+		cv::Mat mat;
+		try
+		{
+			mat = cv::imread(filename);
+		}
+		catch (const std::exception & e)
+		{
+			Log("prefetch failed to read " + filename + ": " + e.what());
+		}
+
+		if (mat.empty())
+		{
+			// DMContent::load_image() will deal with the error when the user gets to this image
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(cache_lock);
+		if (expected_generation != generation or cache.count(filename) > 0)
+		{
+			// cancel() was called while we were decoding this image, so the results are no longer wanted
+			continue;
+		}
+
+		lru.push_front(filename);
+
+		Entry & entry	= cache[filename];
+		entry.mat		= mat;
+		entry.file_time	= file_time;
+		entry.bytes		= mat.total() * mat.elemSize();
+		entry.lru		= lru.begin();
+		memory_used		+= entry.bytes;
+
+		evict();
+	}
+
+	return;
+}
+
+
+void dm::ImagePrefetcher::evict()
+{
+	// always keep at least 1 image, even if it is larger than the entire memory budget
+	while (memory_used > memory_budget and lru.size() > 1)
+	{
+		auto iter = cache.find(lru.back());
+		if (iter != cache.end())
+		{
+			memory_used -= iter->second.bytes;
+			cache.erase(iter);
+		}
+		lru.pop_back();
+	}
+
+	if (memory_budget == 0)
+	{
+		cache.clear();
+		lru.clear();
+		memory_used = 0;
+	}
+
+	return;
+}
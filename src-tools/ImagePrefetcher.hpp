@@ -0,0 +1,80 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Decode images on a secondary thread ahead of when they are needed, and keep the results in a bounded LRU cache.
+	 * This way when the user presses @p LEFT or @p RIGHT the next image has already been read from disk and decoded.
+	 *
+	 * @li Call @ref prefetch() with the list of images most likely to be needed next, in order of importance.
+	 * @li Call @ref get() to retrieve an image from the cache.
+	 * @li Call @ref cancel() when the sort order or filters change and the pending list is no longer relevant.
+	 */
+	class ImagePrefetcher final : public Thread
+	{
+		public:
+
+			ImagePrefetcher();
+
+			virtual ~ImagePrefetcher();
+
+			/// Set the maximum amount of memory (in bytes) used by the decoded images.  Older images are evicted as needed.
+			ImagePrefetcher & set_memory_budget(const size_t bytes);
+
+			/** Replace the list of images waiting to be decoded.  Images already in the cache are skipped.  The order is
+			 * important, since images are decoded starting at the front of the list.
+			 */
+			ImagePrefetcher & prefetch(const VStr & filenames);
+
+			/// Forget about all images waiting to be decoded, and discard the image currently being decoded (if any).
+			ImagePrefetcher & cancel();
+
+			/// Remove everything from the cache.
+			ImagePrefetcher & clear();
+
+			/// Remove a specific image from the cache, such as when it has been deleted or modified.
+			ImagePrefetcher & invalidate(const std::string & filename);
+
+			/** Get the decoded image from the cache.  The image will be removed from the list of pending images if it has
+			 * not yet been decoded.  @returns @p false if the image is not in the cache or the file has since been modified.
+			 */
+			bool get(const std::string & filename, cv::Mat & mat);
+
+			/// Decode pending images.  @see @ref prefetch()
+			virtual void run() override;
+
+		private:
+
+			struct Entry
+			{
+				cv::Mat	mat;
+				int64	file_time;
+				size_t	bytes;
+				std::list<std::string>::iterator lru;
+			};
+
+			/// Evict the least-recently-used images until the cache is within the memory budget.  Lock must be held.
+			void evict();
+
+			std::mutex cache_lock;
+			WaitableEvent work_available;
+
+			/// Images waiting to be decoded.
+			std::deque<std::string> pending;
+
+			/// Incremented every time @ref cancel() or @ref clear() is called so stale results can be discarded.
+			size_t generation;
+
+			std::unordered_map<std::string, Entry> cache;
+
+			/// Most recently used filenames are at the front of the list.
+			std::list<std::string> lru;
+
+			size_t memory_budget;
+			size_t memory_used;
+	};
+}
@@ -0,0 +1,165 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+
+dm::ImagePyramid::ImagePyramid() :
+	max_tiles(256)
+{
+	return;
+}
+
+
+dm::ImagePyramid::~ImagePyramid()
+{
+	return;
+}
+
+
+dm::ImagePyramid & dm::ImagePyramid::set_image(cv::Mat image)
+{
+	// level #0 holds a reference to the image, so if the data pointer matches then it cannot be a different image
+	if (levels.empty() == false and levels[0].data == image.data and levels[0].size() == image.size())
+	{
+		return *this;
+	}
+
+	clear();
+	if (image.empty() == false)
+	{
+		levels.push_back(image);
+	}
+
+	return *this;
+}
+
+
+dm::ImagePyramid & dm::ImagePyramid::clear()
+{
+	levels.clear();
+	tiles.clear();
+	lru.clear();
+	tiles_scaled_size = cv::Size(0, 0);
+
+	return *this;
+}
+
+
+dm::ImagePyramid & dm::ImagePyramid::set_max_tiles(const size_t count)
+{
+	max_tiles = std::max(count, size_t(1));
+
+	return *this;
+}
+
+
+const cv::Mat & dm::ImagePyramid::get_level(const cv::Size & scaled_size)
+{
+	size_t idx = 0;
+	while (true)
+	{
+		// the next level would be (w+1)/2 x (h+1)/2, which is what cv::pyrDown() creates
+		const cv::Size & current = (idx < levels.size() ? levels[idx].size() : cv::Size(0, 0));
+		const cv::Size next((current.width + 1) / 2, (current.height + 1) / 2);
+		if (idx >= levels.size() or next.width < scaled_size.width or next.height < scaled_size.height or next.width < 2 or next.height < 2)
+		{
+			break;
+		}
+
+		idx ++;
+		if (idx == levels.size())
+		{
+			cv::Mat mat;
+			cv::pyrDown(levels[idx - 1], mat);
+			levels.push_back(mat);
+		}
+	}
+
+	return levels.at(idx);
+}
+
+
+cv::Mat dm::ImagePyramid::create_tile(const cv::Size & scaled_size, const cv::Point & tl)
+{
+	const cv::Mat & level = get_level(scaled_size);
+
+	const cv::Size size(
+		std::min(tile_size, scaled_size.width	- tl.x),
+		std::min(tile_size, scaled_size.height	- tl.y));
+
+	// ratio between the level and the scaled image, which is >= 1.0 unless the image is being enlarged
+	const double a = static_cast<double>(level.cols) / scaled_size.width;
+	const double b = static_cast<double>(level.rows) / scaled_size.height;
+
+	// only pass the region of the level which is needed (plus a small border for interpolation) to warpAffine()
+	const int x1 = std::max(0			, static_cast<int>(std::floor(tl.x * a)) - 2);
+	const int y1 = std::max(0			, static_cast<int>(std::floor(tl.y * b)) - 2);
+	const int x2 = std::min(level.cols	, static_cast<int>(std::ceil((tl.x + size.width) * a)) + 2);
+	const int y2 = std::min(level.rows	, static_cast<int>(std::ceil((tl.y + size.height) * b)) + 2);
+	const cv::Mat src = level(cv::Rect(x1, y1, x2 - x1, y2 - y1));
+
+	// map the centre of each destination pixel back to the source region
+	const cv::Mat m = (cv::Mat_<double>(2, 3) <<
+		a, 0.0, (tl.x + 0.5) * a - 0.5 - x1,
+		0.0, b, (tl.y + 0.5) * b - 0.5 - y1);
+
+	cv::Mat tile;
+	cv::warpAffine(src, tile, m, size, cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+
+	return tile;
+}
+
+
+cv::Mat dm::ImagePyramid::render(const cv::Size & scaled_size, const cv::Rect & roi)
+{
+	const cv::Rect r = roi & cv::Rect(cv::Point(0, 0), scaled_size);
+	if (levels.empty() or r.empty())
+	{
+		return cv::Mat();
+	}
+
+	if (scaled_size != tiles_scaled_size)
+	{
+		// the zoom has changed, so none of the existing tiles can be used
+		tiles.clear();
+		lru.clear();
+		tiles_scaled_size = scaled_size;
+	}
+
+	cv::Mat output(r.size(), levels[0].type());
+
+	for (int row = r.y / tile_size; row * tile_size < r.y + r.height; row ++)
+	{
+		for (int col = r.x / tile_size; col * tile_size < r.x + r.width; col ++)
+		{
+			const auto key = std::make_pair(col, row);
+			auto iter = tiles.find(key);
+			if (iter == tiles.end())
+			{
+				Tile tile;
+				tile.mat = create_tile(scaled_size, cv::Point(col * tile_size, row * tile_size));
+				lru.push_front(key);
+				tile.lru = lru.begin();
+				iter = tiles.emplace(key, tile).first;
+			}
+			else
+			{
+				lru.splice(lru.begin(), lru, iter->second.lru);
+			}
+
+			const cv::Mat & mat = iter->second.mat;
+			const cv::Rect tile_rect(col * tile_size, row * tile_size, mat.cols, mat.rows);
+			const cv::Rect overlap = tile_rect & r;
+
+			mat(overlap - tile_rect.tl()).copyTo(output(overlap - r.tl()));
+		}
+	}
+
+	while (tiles.size() > max_tiles)
+	{
+		tiles.erase(lru.back());
+		lru.pop_back();
+	}
+
+	return output;
+}
@@ -0,0 +1,75 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Multi-resolution representation of an image, used by @ref DMCanvas so very large images don't have to be resized
+	 * in their entirety every time the canvas is redrawn.
+	 *
+	 * Each level is half the size of the previous one, and is only created the first time it is needed.  When rendering,
+	 * the smallest level which is still at least as large as the requested size is resampled, and only the fixed-size tiles
+	 * which intersect the requested region are created.  Tiles are kept in a bounded LRU cache, so panning around a zoomed
+	 * image only needs to resample the tiles which have scrolled into view.
+	 *
+	 * This is not thread-safe; it is only meant to be used from the thread which paints the canvas.
+	 */
+	class ImagePyramid final
+	{
+		public:
+
+			/// Width and height of each tile, in pixels.
+			static const int tile_size = 256;
+
+			ImagePyramid();
+
+			~ImagePyramid();
+
+			/** Set the image to use.  Nothing happens if this is the same image already in use.  The image must not be
+			 * modified in-place after it has been given to the pyramid.
+			 */
+			ImagePyramid & set_image(cv::Mat image);
+
+			/// Forget the image, all levels, and all cached tiles.
+			ImagePyramid & clear();
+
+			/// Set the maximum number of tiles to keep in the cache.
+			ImagePyramid & set_max_tiles(const size_t count);
+
+			/** Get the portion @p roi of the image as if the entire image had been resized to @p scaled_size.  The returned
+			 * image is always a new copy which the caller can draw on.
+			 */
+			cv::Mat render(const cv::Size & scaled_size, const cv::Rect & roi);
+
+		private:
+
+			/// Get the level to use when resampling the image to @p scaled_size, creating it if necessary.
+			const cv::Mat & get_level(const cv::Size & scaled_size);
+
+			/// Resample one tile.  The top-left corner of the tile is given in scaled image coordinates.
+			cv::Mat create_tile(const cv::Size & scaled_size, const cv::Point & tl);
+
+			/// Level #0 is the original image, and each subsequent level is half the size of the previous one.
+			std::vector<cv::Mat> levels;
+
+			/// The scaled size used to create the tiles currently in the cache.
+			cv::Size tiles_scaled_size;
+
+			struct Tile
+			{
+				cv::Mat mat;
+				std::list<std::pair<int, int>>::iterator lru;
+			};
+
+			/// Tiles indexed by column and row.
+			std::map<std::pair<int, int>, Tile> tiles;
+
+			/// Most recently used tiles are at the front of the list.
+			std::list<std::pair<int, int>> lru;
+
+			size_t max_tiles;
+	};
+}
@@ -0,0 +1,169 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+#include <bitset>
+#include <numeric>
+
+
+uint64_t dm::dhash(const cv::Mat & mat)
+{
+	if (mat.empty())
+	{
+		return 0;
+	}
+
+	cv::Mat grey;
+	if (mat.channels() == 3)
+	{
+		cv::cvtColor(mat, grey, cv::COLOR_BGR2GRAY);
+	}
+	else if (mat.channels() == 4)
+	{
+		cv::cvtColor(mat, grey, cv::COLOR_BGRA2GRAY);
+	}
+	else
+	{
+		grey = mat;
+	}
+
+	cv::Mat small;
+	cv::resize(grey, small, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+
+	uint64_t hash = 0;
+	for (int y = 0; y < small.rows; y ++)
+	{
+		const uint8_t * ptr = small.ptr<uint8_t>(y);
+		for (int x = 0; x < small.cols - 1; x ++)
+		{
+			hash <<= 1;
+			if (ptr[x] > ptr[x + 1])
+			{
+				hash |= 1;
+			}
+		}
+	}
+
+	return hash;
+}
+
+
+int dm::hamming_distance(const uint64_t lhs, const uint64_t rhs)
+{
+	return std::bitset<64>(lhs ^ rhs).count();
+}
+
+
+dm::BKTree::BKTree()
+{
+	return;
+}
+
+
+dm::BKTree & dm::BKTree::insert(const uint64_t hash, const size_t id)
+{
+	Node node;
+	node.hash	= hash;
+	node.id		= id;
+
+	if (nodes.empty())
+	{
+		nodes.push_back(node);
+		return *this;
+	}
+
+	size_t idx = 0;
+	while (true)
+	{
+		const int distance = hamming_distance(hash, nodes[idx].hash);
+		auto iter = nodes[idx].children.find(distance);
+		if (iter == nodes[idx].children.end())
+		{
+			nodes[idx].children[distance] = nodes.size();
+			nodes.push_back(node);
+			break;
+		}
+		idx = iter->second;
+	}
+
+	return *this;
+}
+
+
+std::vector<size_t> dm::BKTree::find(const uint64_t hash, const int radius) const
+{
+	std::vector<size_t> results;
+	if (nodes.empty())
+	{
+		return results;
+	}
+
+	std::vector<size_t> pending = {0};
+	while (pending.empty() == false)
+	{
+		const Node & node = nodes[pending.back()];
+		pending.pop_back();
+
+		const int distance = hamming_distance(hash, node.hash);
+		if (distance <= radius)
+		{
+			results.push_back(node.id);
+		}
+
+		// because of the triangle inequality, only the children within [distance - radius, distance + radius] can match
+		for (auto iter = node.children.lower_bound(distance - radius); iter != node.children.end() and iter->first <= distance + radius; iter ++)
+		{
+			pending.push_back(iter->second);
+		}
+	}
+
+	return results;
+}
+
+
+std::vector<size_t> dm::group_near_duplicates(const std::vector<uint64_t> & hashes, const int radius)
+{
+	// union-find, where the root of each group is always the lowest index in that group
+	std::vector<size_t> parent(hashes.size());
+	std::iota(parent.begin(), parent.end(), 0);
+
+	auto find_root = [&](size_t idx)
+	{
+		while (parent[idx] != idx)
+		{
+			parent[idx] = parent[parent[idx]];
+			idx = parent[idx];
+		}
+		return idx;
+	};
+
+	BKTree tree;
+	for (size_t idx = 0; idx < hashes.size(); idx ++)
+	{
+		if (hashes[idx] == 0)
+		{
+			// blank image, failed decode, or unknown hash -- see the comments in the header file
+			continue;
+		}
+
+		// only compare against the hashes already in the tree, since the later ones will find this one when they are added
+		for (const size_t other : tree.find(hashes[idx], radius))
+		{
+			const size_t a = find_root(idx);
+			const size_t b = find_root(other);
+			if (a != b)
+			{
+				parent[std::max(a, b)] = std::min(a, b);
+			}
+		}
+		tree.insert(hashes[idx], idx);
+	}
+
+	std::vector<size_t> groups(hashes.size());
+	for (size_t idx = 0; idx < hashes.size(); idx ++)
+	{
+		groups[idx] = find_root(idx);
+	}
+
+	return groups;
+}
@@ -0,0 +1,60 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Get the 64-bit "difference hash" of an image.  The image is converted to greyscale and shrunk to 9x8 pixels, and
+	 * each bit is set when a pixel is brighter than the one to its right.  Re-encoded, resized, or slightly modified copies
+	 * of the same image have hashes which differ by very few bits.
+	 */
+	uint64_t dhash(const cv::Mat & mat);
+
+	/// Number of bits which differ between two hashes.
+	int hamming_distance(const uint64_t lhs, const uint64_t rhs);
+
+	/** Burkhard-Keller tree of 64-bit hashes, used to find all the hashes within a given Hamming distance without having to
+	 * compare against every hash.
+	 */
+	class BKTree final
+	{
+		public:
+
+			BKTree();
+
+			/// Add a hash.  The ID is whatever the caller needs to identify the hash, such as an index into a vector.
+			BKTree & insert(const uint64_t hash, const size_t id);
+
+			/// Get the IDs of all the hashes within @p radius bits of @p hash.
+			std::vector<size_t> find(const uint64_t hash, const int radius) const;
+
+			size_t size() const { return nodes.size(); }
+
+		private:
+
+			struct Node
+			{
+				uint64_t hash;
+				size_t id;
+				std::map<int, size_t> children; ///< Key is the distance to the child, value is the index of the child node.
+			};
+
+			/// The first node is the root of the tree.
+			std::vector<Node> nodes;
+	};
+
+	/** Group near-duplicate hashes together.  Groups are transitive, so if A is near B and B is near C, then all three are
+	 * in the same group even if A and C are further apart than @p radius.
+	 *
+	 * @returns A vector the same size as @p hashes.  Each entry is the group of the corresponding hash, which is the index of
+	 * the first hash in that group.  Hashes which don't have any near-duplicates are in a group by themselves.
+	 *
+	 * A hash of zero is what @ref dhash() returns for images which failed to decode and for blank images, and is also used by
+	 * callers when the hash is unknown.  These hashes say nothing about the content of the image, so they are never grouped
+	 * with any other hash; otherwise every blank or unreadable image would end up in the same group.
+	 */
+	std::vector<size_t> group_near_duplicates(const std::vector<uint64_t> & hashes, const int radius);
+}
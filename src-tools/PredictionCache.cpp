@@ -0,0 +1,448 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+#include <cstring>
+
+
+const std::string dm::PredictionCache::filename = "darkmark_prediction_cache.dat";
+
+
+/** Increment this every time the layout of the cache file changes.  Cache files with a different version are ignored
+ * and the predictions are calculated again.
+ */
+static const uint32_t cache_file_version = 1;
+
+static const char cache_file_magic[4] = {'D', 'M', 'P', 'C'};
+
+
+/// Thresholds are stored in the key with a limited precision so rounding errors don't cause cache misses.
+static std::string threshold_to_string(const float f)
+{
+	return std::to_string(static_cast<int>(std::round(f * 1000.0f)));
+}
+
+
+/// Hashes are remembered using a key that looks like @p "path|size|mtime".  @returns @p false if the file has since changed.
+static bool file_hash_is_current(const std::string & key)
+{
+	const size_t p2 = key.rfind('|');
+	const size_t p1 = (p2 == std::string::npos or p2 == 0) ? std::string::npos : key.rfind('|', p2 - 1);
+	if (p1 == std::string::npos)
+	{
+		return false;
+	}
+
+	const File file(key.substr(0, p1));
+	if (file.existsAsFile() == false)
+	{
+		return false;
+	}
+
+	const std::string size	= std::to_string(file.getSize());
+	const std::string mtime	= std::to_string(file.getLastModificationTime().toMilliseconds());
+
+	return size == key.substr(p1 + 1, p2 - p1 - 1) and mtime == key.substr(p2 + 1);
+}
+
+
+dm::PredictionCache::PredictionCache(const std::string & project_directory, const size_t max) :
+	cache_file(File(project_directory).getChildFile(filename)),
+	use_counter(0),
+	max_entries(max),
+	need_to_save(false)
+{
+	return;
+}
+
+
+dm::PredictionCache::~PredictionCache()
+{
+	if (network_thread.joinable())
+	{
+		network_thread.join();
+	}
+
+	return;
+}
+
+
+dm::PredictionCache & dm::PredictionCache::load()
+{
+	std::lock_guard<std::mutex> lock(cache_lock);
+
+	file_hashes.clear();
+	entries.clear();
+	use_counter = 0;
+	need_to_save = false;
+
+	if (cache_file.existsAsFile() == false)
+	{
+		return *this;
+	}
+
+	const std::string fn = cache_file.getFullPathName().toStdString();
+
+	try
+	{
+		std::ifstream ifs(fn, std::ifstream::binary);
+
+		char magic[4] = {0};
+		ifs.read(magic, sizeof(magic));
+		if (std::memcmp(magic, cache_file_magic, sizeof(magic)) != 0 or read_pod<uint32_t>(ifs) != cache_file_version)
+		{
+			Log("prediction cache " + fn + " has an unknown format or version and will be rebuilt");
+			need_to_save = true;
+			return *this;
+		}
+
+		const uint64_t number_of_hashes = read_pod<uint64_t>(ifs);
+		size_t number_of_stale_hashes = 0;
+		for (uint64_t idx = 0; idx < number_of_hashes; idx ++)
+		{
+			const std::string key = read_str(ifs);
+			const std::string md5 = read_str(ifs);
+			if (file_hash_is_current(key))
+			{
+				file_hashes[key] = md5;
+			}
+			else
+			{
+				// the file has been deleted or modified, so this hash will never be used again
+				number_of_stale_hashes ++;
+				need_to_save = true;
+			}
+		}
+		if (number_of_stale_hashes)
+		{
+			Log("prediction cache discarded " + std::to_string(number_of_stale_hashes) + " hashes of files which have changed or no longer exist");
+		}
+
+		const uint64_t number_of_entries = read_pod<uint64_t>(ifs);
+		entries.reserve(number_of_entries);
+		for (uint64_t idx = 0; idx < number_of_entries; idx ++)
+		{
+			// the entries are saved from least to most recently used
+			const std::string key = read_str(ifs);
+			auto & entry = entries[key];
+			entry.last_used = use_counter ++;
+			auto & results = entry.results;
+
+			const uint32_t number_of_results = read_pod<uint32_t>(ifs);
+			results.resize(number_of_results);
+			for (auto & result : results)
+			{
+				result.rect.x				= read_pod<int32_t>(ifs);
+				result.rect.y				= read_pod<int32_t>(ifs);
+				result.rect.width			= read_pod<int32_t>(ifs);
+				result.rect.height			= read_pod<int32_t>(ifs);
+				result.original_point.x		= read_pod<double>(ifs);
+				result.original_point.y		= read_pod<double>(ifs);
+				result.original_size.width	= read_pod<double>(ifs);
+				result.original_size.height	= read_pod<double>(ifs);
+				result.best_class			= read_pod<int32_t>(ifs);
+				result.best_probability		= read_pod<float>(ifs);
+				result.tile					= read_pod<int32_t>(ifs);
+				result.name					= read_str(ifs);
+
+				const uint32_t number_of_probabilities = read_pod<uint32_t>(ifs);
+				for (uint32_t i = 0; i < number_of_probabilities; i ++)
+				{
+					const int32_t class_idx = read_pod<int32_t>(ifs);
+					result.all_probabilities[class_idx] = read_pod<float>(ifs);
+				}
+			}
+		}
+
+		Log("loaded " + std::to_string(entries.size()) + " entries from prediction cache " + fn);
+		evict();
+	}
+	catch (const std::exception & e)
+	{
+		Log("failed to load prediction cache " + fn + ": " + e.what());
+		file_hashes.clear();
+		entries.clear();
+		need_to_save = true;
+	}
+
+	return *this;
+}
+
+
+dm::PredictionCache & dm::PredictionCache::save()
+{
+	std::lock_guard<std::mutex> lock(cache_lock);
+
+	if (need_to_save == false)
+	{
+		return *this;
+	}
+
+	// write to a temporary file and then rename it so the cache is never left half-written
+	const File tmp = cache_file.getSiblingFile(filename + ".tmp");
+	const std::string fn = tmp.getFullPathName().toStdString();
+
+	try
+	{
+		std::ofstream ofs(fn, std::ofstream::binary | std::ofstream::trunc);
+		ofs.write(cache_file_magic, sizeof(cache_file_magic));
+		write_pod<uint32_t>(ofs, cache_file_version);
+
+		write_pod<uint64_t>(ofs, file_hashes.size());
+		for (const auto & iter : file_hashes)
+		{
+			write_str(ofs, iter.first);
+			write_str(ofs, iter.second);
+		}
+
+		// write the entries from least to most recently used so the order can be restored when the cache is loaded
+		std::vector<decltype(entries)::const_iterator> sorted;
+		sorted.reserve(entries.size());
+		for (auto iter = entries.cbegin(); iter != entries.cend(); iter ++)
+		{
+			sorted.push_back(iter);
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const auto & lhs, const auto & rhs) { return lhs->second.last_used < rhs->second.last_used; });
+
+		write_pod<uint64_t>(ofs, entries.size());
+		for (const auto & iter : sorted)
+		{
+			write_str(ofs, iter->first);
+
+			const auto & results = iter->second.results;
+			write_pod<uint32_t>(ofs, results.size());
+			for (const auto & result : results)
+			{
+				write_pod<int32_t>(ofs, result.rect.x);
+				write_pod<int32_t>(ofs, result.rect.y);
+				write_pod<int32_t>(ofs, result.rect.width);
+				write_pod<int32_t>(ofs, result.rect.height);
+				write_pod<double>(ofs, result.original_point.x);
+				write_pod<double>(ofs, result.original_point.y);
+				write_pod<double>(ofs, result.original_size.width);
+				write_pod<double>(ofs, result.original_size.height);
+				write_pod<int32_t>(ofs, result.best_class);
+				write_pod<float>(ofs, result.best_probability);
+				write_pod<int32_t>(ofs, result.tile);
+				write_str(ofs, result.name);
+
+				write_pod<uint32_t>(ofs, result.all_probabilities.size());
+				for (const auto & prob : result.all_probabilities)
+				{
+					write_pod<int32_t>(ofs, prob.first);
+					write_pod<float>(ofs, prob.second);
+				}
+			}
+		}
+
+		ofs.close();
+		if (ofs.fail())
+		{
+			throw std::runtime_error("failed to write " + fn);
+		}
+
+		if (tmp.moveFileTo(cache_file) == false)
+		{
+			throw std::runtime_error("failed to rename " + fn);
+		}
+
+		need_to_save = false;
+	}
+	catch (const std::exception & e)
+	{
+		Log("failed to save prediction cache: " + std::string(e.what()));
+		tmp.deleteFile();
+	}
+
+	return *this;
+}
+
+
+dm::PredictionCache & dm::PredictionCache::set_network(const std::string & cfg_filename, const std::string & weights_filename, const std::string & names_filename)
+{
+	if (network_thread.joinable())
+	{
+		network_thread.join();
+	}
+
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(cache_lock);
+		network_hash.clear();
+	}
+
+	network_thread = std::thread(&PredictionCache::hash_network, this, cfg_filename, weights_filename, names_filename);
+
+	return *this;
+}
+
+
+void dm::PredictionCache::hash_network(const std::string cfg_filename, const std::string weights_filename, const std::string names_filename)
+{
+	try
+	{
+		const std::string cfg_md5		= md5_for(File(cfg_filename		));
+		const std::string weights_md5	= md5_for(File(weights_filename	));
+		const std::string names_md5		= md5_for(File(names_filename	));
+
+		if (cfg_md5.empty() == false and weights_md5.empty() == false)
+		{
+			std::lock_guard<std::mutex> lock(cache_lock);
+			network_hash = MD5((cfg_md5 + weights_md5 + names_md5).c_str(), cfg_md5.size() + weights_md5.size() + names_md5.size()).toHexString().toStdString();
+		}
+	}
+	catch (const std::exception & e)
+	{
+		Log("failed to hash the neural network files for the prediction cache: " + std::string(e.what()));
+	}
+
+	return;
+}
+
+
+dm::PredictionCache & dm::PredictionCache::set_max_entries(const size_t max)
+{
+	std::lock_guard<std::mutex> lock(cache_lock);
+	max_entries = max;
+	evict();
+
+	return *this;
+}
+
+
+void dm::PredictionCache::evict()
+{
+	if (entries.size() <= max_entries)
+	{
+		return;
+	}
+
+	// discard a few extra entries so this doesn't need to run again every time a new entry is added
+	const size_t entries_to_keep = max_entries - max_entries / 10;
+	const size_t entries_to_discard = entries.size() - entries_to_keep;
+
+	std::vector<uint64_t> v;
+	v.reserve(entries.size());
+	for (const auto & iter : entries)
+	{
+		v.push_back(iter.second.last_used);
+	}
+	std::nth_element(v.begin(), v.begin() + entries_to_discard, v.end());
+	const uint64_t oldest_to_keep = v[entries_to_discard];
+
+	for (auto iter = entries.begin(); iter != entries.end(); )
+	{
+		if (iter->second.last_used < oldest_to_keep)
+		{
+			iter = entries.erase(iter);
+		}
+		else
+		{
+			iter ++;
+		}
+	}
+	need_to_save = true;
+
+	Log("prediction cache discarded " + std::to_string(entries_to_discard) + " least recently used entries");
+
+	return;
+}
+
+
+std::string dm::PredictionCache::md5_for(const File & file)
+{
+	if (file.existsAsFile() == false)
+	{
+		return "";
+	}
+
+	const std::string key =
+		file.getFullPathName().toStdString()									+ "|" +
+		std::to_string(file.getSize())											+ "|" +
+		std::to_string(file.getLastModificationTime().toMilliseconds());
+
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(cache_lock);
+		auto iter = file_hashes.find(key);
+		if (iter != file_hashes.end())
+		{
+			return iter->second;
+		}
+	}
+
+	// if we get here then we need to read the file (without holding the lock)
+	const std::string md5 = MD5(file).toHexString().toStdString();
+
+	std::lock_guard<std::mutex> lock(cache_lock);
+	file_hashes[key] = md5;
+	need_to_save = true;
+
+	return md5;
+}
+
+
+std::string dm::PredictionCache::key_for(const std::string & image_filename, const DarkHelp::Config & config)
+{
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(cache_lock);
+		if (network_hash.empty())
+		{
+			return "";
+		}
+	}
+
+	const std::string image_md5 = md5_for(File(image_filename));
+	if (image_md5.empty())
+	{
+		return "";
+	}
+
+	std::lock_guard<std::mutex> lock(cache_lock);
+
+	return
+		network_hash												+ "|" +
+		image_md5													+ "|" +
+		threshold_to_string(config.threshold)						+ "|" +
+		threshold_to_string(config.hierarchy_threshold)				+ "|" +
+		threshold_to_string(config.non_maximal_suppression_threshold)	+ "|" +
+		(config.enable_tiles ? "tiles" : "notiles");
+}
+
+
+bool dm::PredictionCache::get(const std::string & key, DarkHelp::PredictionResults & results)
+{
+	if (key.empty())
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(cache_lock);
+
+	auto iter = entries.find(key);
+	if (iter == entries.end())
+	{
+		return false;
+	}
+
+	iter->second.last_used = use_counter ++;
+	results = iter->second.results;
+
+	return true;
+}
+
+
+dm::PredictionCache & dm::PredictionCache::put(const std::string & key, const DarkHelp::PredictionResults & results)
+{
+	if (key.empty() == false)
+	{
+		std::lock_guard<std::mutex> lock(cache_lock);
+		auto & entry		= entries[key];
+		entry.results		= results;
+		entry.last_used		= use_counter ++;
+		need_to_save		= true;
+		evict();
+	}
+
+	return *this;
+}
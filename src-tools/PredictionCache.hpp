@@ -0,0 +1,97 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Persistent cache of DarkHelp predictions, stored in a binary file within the project directory.  Revisiting an image
+	 * or re-opening a project doesn't need to call into darknet again if the neural network, the image, and the relevant
+	 * DarkHelp settings haven't changed.
+	 *
+	 * Each entry is keyed by:
+	 * @li the MD5 of the neural network files (.cfg, .names, and .weights),
+	 * @li the MD5 of the image file,
+	 * @li the threshold, hierarchy threshold, NMS threshold, and tiling settings.
+	 *
+	 * Calculating MD5 hashes is not free, so the hashes are remembered using the filename, size, and modification time.
+	 * Hashes of files which no longer exist or have changed are discarded when the cache is loaded.
+	 *
+	 * The number of entries is limited.  When the limit is exceeded, the least recently used entries are discarded.
+	 * All methods are thread-safe.
+	 */
+	class PredictionCache final
+	{
+		public:
+
+			PredictionCache(const std::string & project_directory, const size_t max_entries = 50000);
+
+			~PredictionCache();
+
+			/// Load the cache from disk.  Any problems will result in an empty cache.
+			PredictionCache & load();
+
+			/// Write the cache to disk, but only if something has changed since it was last loaded or saved.
+			PredictionCache & save();
+
+			/** Set the neural network files.  This must be called before the cache can be used.  Hashing a large .weights file
+			 * can take several seconds, so the hashes are calculated on a secondary thread.  Until they are ready, @ref key_for()
+			 * returns an empty string and the cache is not used.
+			 */
+			PredictionCache & set_network(const std::string & cfg_filename, const std::string & weights_filename, const std::string & names_filename);
+
+			/// Set the maximum number of entries, discarding the least recently used entries if necessary.
+			PredictionCache & set_max_entries(const size_t max_entries);
+
+			/** Get the key used to look up the predictions for the given image.  This requires the MD5 of the image, which is
+			 * why the key should be calculated once and passed to both @ref get() and @ref put().  @returns an empty string if
+			 * @ref set_network() has not been called or the image cannot be read.
+			 */
+			std::string key_for(const std::string & image_filename, const DarkHelp::Config & config);
+
+			/// Get the cached predictions.  @returns @p false if the key is not in the cache.
+			bool get(const std::string & key, DarkHelp::PredictionResults & results);
+
+			/// Store the predictions in the cache.
+			PredictionCache & put(const std::string & key, const DarkHelp::PredictionResults & results);
+
+			/// The name of the file within the project directory where the cache is stored.
+			static const std::string filename;
+
+		private:
+
+			struct Entry
+			{
+				DarkHelp::PredictionResults results;
+				uint64_t last_used; ///< Compared against @ref use_counter to find the least recently used entries.
+			};
+
+			/// Get the MD5 of the given file, using the remembered value if the file hasn't changed.
+			std::string md5_for(const File & file);
+
+			/// Called on @ref network_thread to calculate @ref network_hash.
+			void hash_network(const std::string cfg_filename, const std::string weights_filename, const std::string names_filename);
+
+			/// Discard the least recently used entries once there are too many.  The lock must be held by the caller.
+			void evict();
+
+			File cache_file;
+			std::mutex cache_lock;
+			std::thread network_thread;
+
+			/// The combined MD5 of the neural network files.  Empty until @ref set_network() is called.
+			std::string network_hash;
+
+			/// MD5 of files, where the key is the filename, size, and modification time.
+			std::unordered_map<std::string, std::string> file_hashes;
+
+			std::unordered_map<std::string, Entry> entries;
+
+			uint64_t use_counter;
+			size_t max_entries;
+
+			bool need_to_save;
+	};
+}
@@ -61,6 +61,7 @@ dm::ProjectInfo::ProjectInfo(const std::string & prefix)
 	train_with_all_images		= cfg().get_bool	(cfg_prefix + "darknet_train_with_all_images"	, true	);
 	training_images_percentage	= cfg().get_int		(cfg_prefix + "darknet_training_percentage"		, 80	) / 100.0;
 	limit_validation_images		= cfg().get_bool	(cfg_prefix + "darknet_limit_validation_images"	, true	);
+	group_near_duplicates		= cfg().get_bool	(cfg_prefix + "darknet_group_near_duplicates"	, false	);
 	image_width					= cfg().get_int		(cfg_prefix + "darknet_image_width"				, 448	);
 	image_height				= cfg().get_int		(cfg_prefix + "darknet_image_height"			, 256	);
 	batch_size					= cfg().get_int		(cfg_prefix + "darknet_batch_size"				, 64	);
@@ -76,6 +77,7 @@ dm::ProjectInfo::ProjectInfo(const std::string & prefix)
 	recalculate_anchors			= cfg().get_bool	(cfg_prefix + "darknet_recalculate_anchors"		, false	);
 	anchor_clusters				= cfg().get_int		(cfg_prefix + "darknet_anchor_clusters"			, 9		);
 	class_imbalance				= cfg().get_bool	(cfg_prefix + "darknet_class_imbalance"			, false	);
+	evolve_anchors				= cfg().get_bool	(cfg_prefix + "darknet_evolve_anchors"			, false	);
 	restart_training			= cfg().get_bool	(cfg_prefix + "darknet_restart_training"		, false	);
 	delete_temp_weights			= cfg().get_bool	(cfg_prefix + "darknet_delete_temp_weights"		, true	);
 	saturation					= cfg().get_double	(cfg_prefix + "darknet_saturation"				, 1.50	);
@@ -100,9 +102,11 @@ dm::ProjectInfo::ProjectInfo(const std::string & prefix)
 	if (options.count("zoom_images"				))	zoom_images				= toBool(options.at("zoom_images"				));
 	if (options.count("limit_neg_samples"		))	limit_negative_samples	= toBool(options.at("limit_neg_samples"			));
 	if (options.count("limit_validation_images"	))	limit_validation_images	= toBool(options.at("limit_validation_images"	));
+	if (options.count("group_near_duplicates"	))	group_near_duplicates	= toBool(options.at("group_near_duplicates"		));
 	if (options.count("yolo_anchors"			))	recalculate_anchors		= toBool(options.at("yolo_anchors"				));
 	if (options.count("learning_rate"			))	learning_rate			= toFloat(options.at("learning_rate"			));
 	if (options.count("class_imbalance"			))	class_imbalance			= toBool(options.at("class_imbalance"			));
+	if (options.count("evolve_anchors"			))	evolve_anchors			= toBool(options.at("evolve_anchors"			));
 	if (options.count("mosaic"					))	enable_mosaic			= toBool(options.at("mosaic"					));
 	if (options.count("cutmix"					))	enable_cutmix			= toBool(options.at("cutmix"					));
 	if (options.count("mixup"					))	enable_mixup			= toBool(options.at("mixup"						));
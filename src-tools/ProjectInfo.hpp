@@ -27,6 +27,7 @@ namespace dm
 			bool		train_with_all_images;		///< should we train with *all* images, or should we use @ref training_images_percentage?
 			double		training_images_percentage;	///< between 0.0 and 1.0
 			bool		limit_validation_images;	///< truncate valid.txt to limit validation images
+			bool		group_near_duplicates;		///< keep near-duplicate images on the same side of the train/valid split
 			int			image_width;				///< must be a multiple of 32 (416, 608, 832, ...)
 			int			image_height;				///< must be a multiple of 32 (416, 608, 832, ...)
 			int			batch_size;					///< e.g., @p 64
@@ -46,6 +47,7 @@ namespace dm
 			bool		recalculate_anchors;		///< whether darknet will be called to recalculate anchors
 			int			anchor_clusters;			///< number of anchor clusters to use (default is 9)
 			bool		class_imbalance;			///< whether counters_per_class will be added to each yolo section
+			bool		evolve_anchors;				///< whether the recalculated anchors will be improved with an evolutionary search
 			bool		restart_training;			///< whether training should use the previous *_best.weights file or start new
 			bool		delete_temp_weights;		///< whether the temporary .weights files should be deleted once training has finished
 			float		saturation;
@@ -0,0 +1,191 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+
+/// Rectangles which would be stored in more cells than this are kept in the list of large rectangles.
+static const int max_cells_per_rect = 64;
+
+
+dm::SpatialIndex::SpatialIndex(const cv::Size & cell_size) :
+	cell_size(std::max(1, cell_size.width), std::max(1, cell_size.height))
+{
+	return;
+}
+
+
+dm::SpatialIndex & dm::SpatialIndex::clear()
+{
+	rects.clear();
+	cells.clear();
+	large_rects.clear();
+
+	return *this;
+}
+
+
+dm::SpatialIndex & dm::SpatialIndex::build(const std::vector<cv::Rect> & v)
+{
+	clear();
+
+	// cells twice the average size of a rectangle means most rectangles touch at most 4 cells
+	double total_width	= 0.0;
+	double total_height	= 0.0;
+	for (const auto & r : v)
+	{
+		total_width		+= r.width;
+		total_height	+= r.height;
+	}
+	if (v.empty() == false)
+	{
+		cell_size.width		= std::max(8, static_cast<int>(std::round(2.0 * total_width	/ v.size())));
+		cell_size.height	= std::max(8, static_cast<int>(std::round(2.0 * total_height	/ v.size())));
+	}
+
+	rects.reserve(v.size());
+	for (const auto & r : v)
+	{
+		insert(r);
+	}
+
+	return *this;
+}
+
+
+cv::Point dm::SpatialIndex::cell_of(const cv::Point & p) const
+{
+	return cv::Point(
+		static_cast<int>(std::floor(static_cast<double>(p.x) / cell_size.width	)),
+		static_cast<int>(std::floor(static_cast<double>(p.y) / cell_size.height	)));
+}
+
+
+uint64_t dm::SpatialIndex::key(const int cell_x, const int cell_y) const
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(cell_x)) << 32) | static_cast<uint32_t>(cell_y);
+}
+
+
+size_t dm::SpatialIndex::insert(const cv::Rect & r)
+{
+	const size_t id = rects.size();
+	rects.push_back(r);
+
+	if (r.empty())
+	{
+		// empty rectangles never contain nor overlap anything, but they still need an ID
+		return id;
+	}
+
+	const cv::Point tl = cell_of(r.tl());
+	const cv::Point br = cell_of(r.br() - cv::Point(1, 1));
+	if ((br.x - tl.x + 1) * (br.y - tl.y + 1) > max_cells_per_rect)
+	{
+		large_rects.push_back(id);
+		return id;
+	}
+
+	for (int y = tl.y; y <= br.y; y ++)
+	{
+		for (int x = tl.x; x <= br.x; x ++)
+		{
+			cells[key(x, y)].push_back(id);
+		}
+	}
+
+	return id;
+}
+
+
+std::vector<size_t> dm::SpatialIndex::find(const cv::Point & p) const
+{
+	std::vector<size_t> results;
+
+	const cv::Point c = cell_of(p);
+	auto iter = cells.find(key(c.x, c.y));
+	if (iter != cells.end())
+	{
+		for (const auto id : iter->second)
+		{
+			if (rects[id].contains(p))
+			{
+				results.push_back(id);
+			}
+		}
+	}
+
+	for (const auto id : large_rects)
+	{
+		if (rects[id].contains(p))
+		{
+			results.push_back(id);
+		}
+	}
+
+	// a rectangle is only stored once per cell, so there cannot be any duplicates
+	std::sort(results.begin(), results.end());
+
+	return results;
+}
+
+
+std::vector<size_t> dm::SpatialIndex::find(const cv::Rect & r) const
+{
+	std::vector<size_t> results;
+	if (r.empty())
+	{
+		return results;
+	}
+
+	const cv::Point tl = cell_of(r.tl());
+	const cv::Point br = cell_of(r.br() - cv::Point(1, 1));
+	const double number_of_cells = static_cast<double>(br.x - tl.x + 1) * (br.y - tl.y + 1);
+
+	if (number_of_cells > rects.size())
+	{
+		// the area is so large compared to the number of rectangles that it is faster to look at every rectangle
+		for (size_t id = 0; id < rects.size(); id ++)
+		{
+			if ((rects[id] & r).empty() == false)
+			{
+				results.push_back(id);
+			}
+		}
+
+		return results;
+	}
+
+	for (int y = tl.y; y <= br.y; y ++)
+	{
+		for (int x = tl.x; x <= br.x; x ++)
+		{
+			auto iter = cells.find(key(x, y));
+			if (iter == cells.end())
+			{
+				continue;
+			}
+
+			for (const auto id : iter->second)
+			{
+				if ((rects[id] & r).empty() == false)
+				{
+					results.push_back(id);
+				}
+			}
+		}
+	}
+
+	for (const auto id : large_rects)
+	{
+		if ((rects[id] & r).empty() == false)
+		{
+			results.push_back(id);
+		}
+	}
+
+	// rectangles which span several cells will have been found more than once
+	std::sort(results.begin(), results.end());
+	results.erase(std::unique(results.begin(), results.end()), results.end());
+
+	return results;
+}
@@ -0,0 +1,61 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Uniform grid of rectangles, used to quickly find the marks at a given location or which overlap a given area
+	 * without having to compare against every mark in the image.  Each rectangle is stored in every grid cell it touches.
+	 * Rectangles which would touch too many cells are kept in a separate list which is always checked.
+	 *
+	 * The ID of each rectangle is the order in which it was added, starting at zero, and results are always returned in
+	 * ascending order so callers see the rectangles in the same order as a linear scan would.
+	 */
+	class SpatialIndex final
+	{
+		public:
+
+			SpatialIndex(const cv::Size & cell_size = cv::Size(64, 64));
+
+			/// Remove all rectangles.  The cell size is not modified.
+			SpatialIndex & clear();
+
+			/// Replace the content of the index with @p rects.  The cell size is determined from the size of the rectangles.
+			SpatialIndex & build(const std::vector<cv::Rect> & rects);
+
+			/// Add a rectangle.  @returns the ID of the rectangle.
+			size_t insert(const cv::Rect & r);
+
+			/// Get the IDs of all the rectangles which contain @p p.
+			std::vector<size_t> find(const cv::Point & p) const;
+
+			/// Get the IDs of all the rectangles which overlap @p r by at least 1 pixel.
+			std::vector<size_t> find(const cv::Rect & r) const;
+
+			/// Number of rectangles in the index.
+			size_t size() const { return rects.size(); }
+
+			/// Get a rectangle by ID.
+			const cv::Rect & at(const size_t id) const { return rects.at(id); }
+
+		private:
+
+			/// Cell coordinates which contain the given image coordinates.  Negative coordinates are supported.
+			cv::Point cell_of(const cv::Point & p) const;
+
+			uint64_t key(const int cell_x, const int cell_y) const;
+
+			cv::Size cell_size;
+
+			std::vector<cv::Rect> rects;
+
+			/// Key is the cell coordinates, value is the IDs of the rectangles which touch that cell.
+			std::unordered_map<uint64_t, std::vector<size_t>> cells;
+
+			/// IDs of rectangles which are too large to store in the grid.
+			std::vector<size_t> large_rects;
+	};
+}
@@ -0,0 +1,153 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+
+dm::RunningStats::RunningStats() :
+	n(0),
+	average(0.0),
+	m2(0.0),
+	minimum(0.0),
+	maximum(0.0)
+{
+	return;
+}
+
+
+dm::RunningStats & dm::RunningStats::add(const double value)
+{
+	n ++;
+	if (n == 1)
+	{
+		minimum = value;
+		maximum = value;
+	}
+	else
+	{
+		minimum = std::min(minimum, value);
+		maximum = std::max(maximum, value);
+	}
+
+	const double delta = value - average;
+	average += delta / n;
+	m2 += delta * (value - average);
+
+	return *this;
+}
+
+
+dm::RunningStats & dm::RunningStats::merge(const RunningStats & rhs)
+{
+	if (rhs.n == 0)
+	{
+		return *this;
+	}
+
+	if (n == 0)
+	{
+		*this = rhs;
+		return *this;
+	}
+
+	// see Chan et al. for combining the mean and variance of two sets
+	const double total = n + rhs.n;
+	const double delta = rhs.average - average;
+
+	average	+= delta * rhs.n / total;
+	m2		+= rhs.m2 + delta * delta * n * rhs.n / total;
+	n		+= rhs.n;
+	minimum	= std::min(minimum, rhs.minimum);
+	maximum	= std::max(maximum, rhs.maximum);
+
+	return *this;
+}
+
+
+double dm::RunningStats::variance() const
+{
+	if (n == 0)
+	{
+		return 0.0;
+	}
+
+	return m2 / n;
+}
+
+
+double dm::RunningStats::standard_deviation() const
+{
+	return std::sqrt(variance());
+}
+
+
+dm::QuantileSketch::QuantileSketch(const double relative_accuracy) :
+	gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+	log_gamma(std::log(gamma)),
+	zero_count(0),
+	total(0)
+{
+	return;
+}
+
+
+dm::QuantileSketch & dm::QuantileSketch::add(const double value, const size_t count)
+{
+	if (value <= 0.0)
+	{
+		zero_count += count;
+	}
+	else
+	{
+		const int idx = std::ceil(std::log(value) / log_gamma);
+		buckets[idx] += count;
+	}
+	total += count;
+
+	return *this;
+}
+
+
+dm::QuantileSketch & dm::QuantileSketch::merge(const QuantileSketch & rhs)
+{
+	if (gamma != rhs.gamma)
+	{
+		throw std::invalid_argument("cannot merge quantile sketches with a different relative accuracy");
+	}
+
+	for (const auto & iter : rhs.buckets)
+	{
+		buckets[iter.first] += iter.second;
+	}
+	zero_count	+= rhs.zero_count;
+	total		+= rhs.total;
+
+	return *this;
+}
+
+
+double dm::QuantileSketch::quantile(const double q) const
+{
+	if (total == 0)
+	{
+		return 0.0;
+	}
+
+	const size_t rank = std::round(std::clamp(q, 0.0, 1.0) * (total - 1));
+	if (rank < zero_count)
+	{
+		return 0.0;
+	}
+
+	size_t seen = zero_count;
+	for (const auto & iter : buckets)
+	{
+		seen += iter.second;
+		if (seen > rank)
+		{
+			// return the value in the middle of the bucket, which is within the relative accuracy of every value in the bucket
+			return 2.0 * std::pow(gamma, iter.first) / (gamma + 1.0);
+		}
+	}
+
+	return 2.0 * std::pow(gamma, buckets.rbegin()->first) / (gamma + 1.0);
+}
@@ -0,0 +1,82 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** Count, mean, and variance of a stream of values, without storing the values.  Uses Welford's algorithm so it is
+	 * numerically stable, and two instances can be merged together, such as when each thread has its own instance.
+	 */
+	class RunningStats final
+	{
+		public:
+
+			RunningStats();
+
+			/// Add a single value.
+			RunningStats & add(const double value);
+
+			/// Combine the values from @p rhs into this object.
+			RunningStats & merge(const RunningStats & rhs);
+
+			size_t count() const { return n; }
+			double mean() const { return average; }
+			double min() const { return minimum; }
+			double max() const { return maximum; }
+
+			/// Population variance, or zero when there are no values.
+			double variance() const;
+
+			/// Population standard deviation, or zero when there are no values.
+			double standard_deviation() const;
+
+		private:
+
+			size_t n;
+			double average;
+			double m2;	///< Sum of the squared differences from the mean.
+			double minimum;
+			double maximum;
+	};
+
+
+	/** Approximate quantiles (percentiles) of a stream of values, using logarithmically-sized buckets.  Any quantile is
+	 * guaranteed to be within the requested relative accuracy of the real value, and the memory used depends on the range of
+	 * values rather than the number of values.  Two sketches with the same accuracy can be merged together.
+	 */
+	class QuantileSketch final
+	{
+		public:
+
+			/// For example, @p 0.01 means quantiles are within 1% of the exact value.
+			QuantileSketch(const double relative_accuracy = 0.01);
+
+			/// Add a value.  Values <= 0 are all counted as zero.
+			QuantileSketch & add(const double value, const size_t count = 1);
+
+			/// Combine the values from @p rhs into this object.  Both sketches must use the same relative accuracy.
+			QuantileSketch & merge(const QuantileSketch & rhs);
+
+			/// The total number of values added to the sketch.
+			size_t count() const { return total; }
+
+			/** Get the value at the given quantile, such as @p 0.5 for the median or @p 0.95 for the 95th percentile.
+			 * @returns zero if the sketch is empty.
+			 */
+			double quantile(const double q) const;
+
+		private:
+
+			double gamma;
+			double log_gamma;
+
+			/// The key is the bucket index, where bucket @p i covers values in the range (gamma^(i-1), gamma^i].
+			std::map<int, size_t> buckets;
+
+			size_t zero_count;
+			size_t total;
+	};
+}
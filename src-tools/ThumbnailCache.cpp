@@ -0,0 +1,410 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#include "DarkMark.hpp"
+
+
+const std::vector<int> dm::ThumbnailCache::levels = {128, 256, 512, 1024};
+
+
+dm::ThumbnailCache::ThumbnailCache(const std::string & project_directory) :
+	Thread("thumbnail cache thread"),
+	cache_dir(File(project_directory).getChildFile("darkmark_image_cache").getChildFile("thumbnails")),
+	prune_pending(false)
+{
+	return;
+}
+
+
+dm::ThumbnailCache::~ThumbnailCache()
+{
+	if (isThreadRunning())
+	{
+		signalThreadShouldExit();
+		notify();
+
+		// never kill the thread while it is decoding an image or writing to the cache
+		waitForThreadToExit(-1);
+	}
+
+	return;
+}
+
+
+File dm::ThumbnailCache::base_file_for(const std::string & image_filename) const
+{
+	const File f(image_filename);
+
+	const std::string str =
+		f.getFullPathName().toStdString()									+ "|" +
+		std::to_string(f.getSize())											+ "|" +
+		std::to_string(f.getLastModificationTime().toMilliseconds());
+
+	const String key = MD5(str.c_str(), str.size()).toHexString();
+
+	// use a 2-character subdirectory so we don't end up with 100K+ files in a single directory
+	return cache_dir.getChildFile(key.substring(0, 2)).getChildFile(key);
+}
+
+
+/// Parse a non-negative decimal number.  @returns @p false if the string contains anything other than digits.
+static bool parse_number(const std::string & str, uint64_t & value)
+{
+	if (str.empty() or str.size() > 20 or str.find_first_not_of("0123456789") != std::string::npos)
+	{
+		return false;
+	}
+
+	try
+	{
+		value = std::stoull(str);
+	}
+	catch (...)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+bool dm::ThumbnailCache::get_info(const std::string & image_filename, Info & info)
+{
+	const File base = base_file_for(image_filename);
+	const File txt = base.getSiblingFile(base.getFileName() + ".txt");
+	if (txt.existsAsFile() == false)
+	{
+		return false;
+	}
+
+	std::ifstream ifs(txt.getFullPathName().toStdString());
+	VStr tokens;
+	std::string token;
+	while (ifs >> token)
+	{
+		tokens.push_back(token);
+	}
+
+	// the format is "width height dhash", but some older entries also have the MD5 of the pixels before the perceptual
+	// hash, while even older entries only have the MD5 and are treated as missing so they are re-created
+	if (tokens.size() == 4)
+	{
+		tokens.erase(tokens.begin() + 2);
+	}
+
+	uint64_t width	= 0;
+	uint64_t height	= 0;
+	if (tokens.size() != 3 or
+		parse_number(tokens[0], width) == false or
+		parse_number(tokens[1], height) == false or
+		parse_number(tokens[2], info.dhash) == false or
+		width == 0 or width > INT_MAX or
+		height == 0 or height > INT_MAX)
+	{
+		return false;
+	}
+	info.original_size = cv::Size(width, height);
+
+	return true;
+}
+
+
+bool dm::ThumbnailCache::get(const std::string & image_filename, const int min_long_side, cv::Mat & mat, const bool queue_if_missing)
+{
+	const File base = base_file_for(image_filename);
+
+	for (const int level : levels)
+	{
+		if (level < min_long_side)
+		{
+			continue;
+		}
+
+		const File f = base.getSiblingFile(base.getFileName() + "_" + String(level) + ".jpg");
+		if (f.existsAsFile())
+		{
+			mat = cv::imread(f.getFullPathName().toStdString());
+			if (mat.empty() == false)
+			{
+				return true;
+			}
+		}
+	}
+
+	if (queue_if_missing)
+	{
+		// only queue the image if it has never been processed; otherwise the image is simply too small for the level requested
+		Info info;
+		if (get_info(image_filename, info) == false)
+		{
+			queue({image_filename});
+		}
+	}
+
+	return false;
+}
+
+
+dm::ThumbnailCache::Info dm::ThumbnailCache::create(const std::string & image_filename, cv::Mat original_image, const cv::Size & original_size)
+{
+	const File base = base_file_for(image_filename);
+	const std::string key = base.getFileName().toStdString();
+
+	// the secondary thread, the review, and the darknet window may all try to create the same entry at the same time
+	if (true)
+	{
+		std::unique_lock<std::mutex> lock(create_lock);
+		create_done.wait(lock, [&] { return creating.count(key) == 0; });
+
+		Info info;
+		if (get_info(image_filename, info))
+		{
+			// another thread created this entry while we were waiting
+			return info;
+		}
+		creating.insert(key);
+	}
+
+	auto finished = [&]()
+	{
+		std::lock_guard<std::mutex> lock(create_lock);
+		creating.erase(key);
+		create_done.notify_all();
+	};
+
+	Info info;
+	try
+	{
+		info = write_entry(base, original_image, original_size);
+	}
+	catch (...)
+	{
+		finished();
+		throw;
+	}
+	finished();
+
+	return info;
+}
+
+
+dm::ThumbnailCache::Info dm::ThumbnailCache::write_entry(const File & base, cv::Mat original_image, const cv::Size & original_size)
+{
+	Info info;
+	info.original_size	= original_image.size();
+	info.dhash			= dhash(original_image);
+
+	if (original_size.area() > 0)
+	{
+		// the size comes from the file header which ignores EXIF orientation, so match the orientation of the decoded image
+		info.original_size = original_size;
+		if ((original_size.width > original_size.height) != (original_image.cols > original_image.rows))
+		{
+			std::swap(info.original_size.width, info.original_size.height);
+		}
+	}
+
+	base.getParentDirectory().createDirectory();
+
+	const int long_side = std::max(info.original_size.width, info.original_size.height);
+	for (const int level : levels)
+	{
+		if (level >= long_side)
+		{
+			// no point in storing a copy which is the same size or larger than the original image
+			break;
+		}
+
+		// replaceWithData() writes to a temporary file and renames it, so get() never sees a partially-written image
+		const File f = base.getSiblingFile(base.getFileName() + "_" + String(level) + ".jpg");
+		cv::Mat mat = DarkHelp::resize_keeping_aspect_ratio(original_image, cv::Size(level, level));
+		std::vector<unsigned char> jpg;
+		if (cv::imencode(".jpg", mat, jpg, {cv::IMWRITE_JPEG_QUALITY, 90}) == false or f.replaceWithData(jpg.data(), jpg.size()) == false)
+		{
+			throw std::runtime_error("failed to write thumbnail " + f.getFullPathName().toStdString());
+		}
+	}
+
+	// the .txt file is written last since it is used to know if the cache entry exists
+	std::stringstream ss;
+	ss << info.original_size.width << " " << info.original_size.height << " " << info.dhash << std::endl;
+	const std::string str = ss.str();
+	const File txt = base.getSiblingFile(base.getFileName() + ".txt");
+	if (txt.replaceWithData(str.c_str(), str.size()) == false)
+	{
+		throw std::runtime_error("failed to write " + txt.getFullPathName().toStdString());
+	}
+
+	return info;
+}
+
+
+dm::ThumbnailCache & dm::ThumbnailCache::queue(const VStr & image_filenames)
+{
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(queue_lock);
+		for (const auto & fn : image_filenames)
+		{
+			if (pending_set.count(fn) == 0)
+			{
+				pending_set.insert(fn);
+				pending.push_back(fn);
+			}
+		}
+	}
+
+	if (isThreadRunning() == false)
+	{
+		startThread(2); // low priority, this is background work
+	}
+	notify();
+
+	return *this;
+}
+
+
+dm::ThumbnailCache & dm::ThumbnailCache::prune(const VStr & image_filenames)
+{
+	if (true)
+	{
+		std::lock_guard<std::mutex> lock(queue_lock);
+		prune_filenames	= image_filenames;
+		prune_requested	= Time::getCurrentTime();
+		prune_pending	= true;
+	}
+
+	if (isThreadRunning() == false)
+	{
+		startThread(2); // low priority, this is background work
+	}
+	notify();
+
+	return *this;
+}
+
+
+void dm::ThumbnailCache::prune_now(const VStr & image_filenames, const Time & requested)
+{
+	if (cache_dir.isDirectory() == false)
+	{
+		return;
+	}
+
+	SStr keys;
+	for (const auto & fn : image_filenames)
+	{
+		if (threadShouldExit())
+		{
+			return;
+		}
+		keys.insert(base_file_for(fn).getFileName().toStdString());
+	}
+
+	size_t files_deleted = 0;
+	for (auto dir_entry : RangedDirectoryIterator(cache_dir, true, "*", File::findFiles))
+	{
+		if (threadShouldExit())
+		{
+			break;
+		}
+
+		// the files are named "<key>.txt" and "<key>_<level>.jpg"
+		const File f = dir_entry.getFile();
+		const std::string key = f.getFileNameWithoutExtension().upToFirstOccurrenceOf("_", false, false).toStdString();
+		if (keys.count(key) or f.getLastModificationTime() >= requested)
+		{
+			// either the image still exists, or this is a new entry created after the list of images was made
+			continue;
+		}
+
+		if (true)
+		{
+			std::lock_guard<std::mutex> lock(create_lock);
+			if (creating.count(key))
+			{
+				continue;
+			}
+		}
+
+		if (f.deleteFile())
+		{
+			files_deleted ++;
+		}
+	}
+
+	Log("thumbnail cache: deleted " + std::to_string(files_deleted) + " files which no longer belong to any image");
+
+	return;
+}
+
+
+void dm::ThumbnailCache::run()
+{
+	DarkMarkApplication::setup_signal_handling();
+
+	while (threadShouldExit() == false)
+	{
+		std::string filename;
+		if (true)
+		{
+			std::lock_guard<std::mutex> lock(queue_lock);
+			if (pending.empty() == false)
+			{
+				filename = pending.front();
+				pending.pop_front();
+				pending_set.erase(filename);
+			}
+		}
+
+		if (filename.empty())
+		{
+			VStr filenames;
+			Time requested;
+			if (true)
+			{
+				std::lock_guard<std::mutex> lock(queue_lock);
+				if (prune_pending)
+				{
+					filenames.swap(prune_filenames);
+					requested		= prune_requested;
+					prune_pending	= false;
+				}
+			}
+
+			if (filenames.empty() == false)
+			{
+				prune_now(filenames, requested);
+			}
+			else
+			{
+				wait(500);
+			}
+			continue;
+		}
+
+		Info info;
+		if (get_info(filename, info))
+		{
+			// this image was already added to the cache
+			continue;
+		}
+
+		try
+		{
+			// the thumbnails are never larger than the last level, so large images don't need to be decoded at full size
+			const cv::Size original_size = probe_image_size(filename);
+			const int level = levels.back();
+			cv::Mat mat = imread_reduced(filename, cv::Size(level, level), original_size);
+			if (mat.empty() == false)
+			{
+				create(filename, mat, original_size);
+			}
+		}
+		catch (const std::exception & e)
+		{
+			Log("failed to create thumbnails for " + filename + ": " + e.what());
+		}
+	}
+
+	return;
+}
@@ -0,0 +1,95 @@
+// DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
+
+#pragma once
+
+#include "DarkMark.hpp"
+
+
+namespace dm
+{
+	/** On-disk cache of downsized copies of each image, stored in @p darkmark_image_cache/thumbnails within the project.
+	 * Each image is stored at several fixed sizes (see @ref levels) so callers can pick the smallest copy which is large
+	 * enough for what they need to display, without having to decode the original full-size image.
+	 *
+	 * Cache entries are named using a hash of the image filename, size, and modification time, so an image which is
+	 * modified (rotated, re-saved, etc.) automatically gets a new entry.  A small text file is stored alongside each
+	 * entry with the original dimensions and the perceptual hash (see @ref dhash()) which is used to find near-duplicate
+	 * images.
+	 *
+	 * When an image is requested but not yet in the cache, it can be queued so the secondary thread creates the entry.
+	 * Entries which no longer belong to any image are deleted by @ref prune().  All methods are thread-safe, and files are
+	 * written to a temporary file and then renamed so a partially-written file is never seen.
+	 */
+	class ThumbnailCache final : public Thread
+	{
+		public:
+
+			/// Everything we know about an image in the cache, other than the pixels.
+			struct Info
+			{
+				cv::Size original_size;
+				uint64_t dhash;
+			};
+
+			ThumbnailCache(const std::string & project_directory);
+
+			virtual ~ThumbnailCache();
+
+			/// The size of the long side of each thumbnail level, in ascending order.
+			static const std::vector<int> levels;
+
+			/// Get the original image size and perceptual hash.  @returns @p false if the image is not in the cache.
+			bool get_info(const std::string & image_filename, Info & info);
+
+			/** Get the smallest cached copy of the image where the long side is at least @p min_long_side.  @returns
+			 * @p false if there is no such copy, in which case the image is queued so it can be created on the secondary
+			 * thread (unless @p queue_if_missing is @p false).
+			 */
+			bool get(const std::string & image_filename, const int min_long_side, cv::Mat & mat, const bool queue_if_missing = true);
+
+			/** Create all of the cache entries for an image which the caller has already decoded.  If the image was decoded at
+			 * a reduced resolution (see @ref reduced_imread_flags()) then @p original_size must be set to the full size of the
+			 * image, in which case the perceptual hash is of the reduced image.  If another thread is already creating
+			 * the entries for this image, then this waits for that thread to finish and nothing is written.  @returns the
+			 * information stored in the cache.
+			 */
+			Info create(const std::string & image_filename, cv::Mat original_image, const cv::Size & original_size = cv::Size());
+
+			/// Queue images so they are added to the cache by the secondary thread.
+			ThumbnailCache & queue(const VStr & image_filenames);
+
+			/** Delete the cache entries which don't belong to any of these images, such as the entries of images which have
+			 * since been modified or deleted.  This is done by the secondary thread once the queue is empty.
+			 */
+			ThumbnailCache & prune(const VStr & image_filenames);
+
+			/// Create the cache entries for the images which have been queued.
+			virtual void run() override;
+
+		private:
+
+			/// Get the base filename (without the level or extension) of the cache entry for the given image.
+			File base_file_for(const std::string & image_filename) const;
+
+			/// Write the thumbnails and the .txt file.  Called by @ref create().
+			Info write_entry(const File & base, cv::Mat original_image, const cv::Size & original_size);
+
+			/// Called on the secondary thread to do the work requested by @ref prune().
+			void prune_now(const VStr & image_filenames, const Time & requested);
+
+			File cache_dir;
+
+			std::mutex queue_lock;
+			std::deque<std::string> pending;
+			SStr pending_set;
+			VStr prune_filenames;
+			Time prune_requested;
+			bool prune_pending;
+
+			/// The keys of the entries which are being created.  @see @ref create()  @{
+			std::mutex create_lock;
+			std::condition_variable create_done;
+			SStr creating;
+			/// @}
+	};
+}
@@ -1,6 +1,7 @@
 // DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
 
 #include "DarkMark.hpp"
+#include <filesystem>
 
 
 void dm::find_files(File dir, VStr & image_filenames, VStr & json_filenames, VStr & images_without_json, std::atomic<bool> & done)
@@ -86,3 +87,327 @@ std::default_random_engine & dm::get_random_engine()
 
 	return engine;
 }
+
+
+/// Read a big-endian 16-bit value.
+static inline int be16(const uint8_t * p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+
+/// Read a big-endian 32-bit value.
+static inline int be32(const uint8_t * p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+/// Read a little-endian 16-bit value.
+static inline int le16(const uint8_t * p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+
+/// Read a little-endian 32-bit value.
+static inline int le32(const uint8_t * p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+
+/// Get the width and height from the first IFD (image file directory) of a TIFF file.
+static cv::Size probe_tiff_size(std::ifstream & ifs, const uint8_t * header)
+{
+	cv::Size size;
+
+	// TIFF files can be either little-endian ("II") or big-endian ("MM")
+	const bool little_endian = (header[0] == 'I');
+	auto u16 = [&](const uint8_t * p) { return little_endian ? le16(p) : be16(p); };
+	auto u32 = [&](const uint8_t * p) { return little_endian ? le32(p) : be32(p); };
+
+	const int ifd_offset = u32(header + 4);
+	if (ifd_offset < 8)
+	{
+		return size;
+	}
+
+	ifs.clear();
+	ifs.seekg(ifd_offset);
+	uint8_t count[2] = {0};
+	ifs.read(reinterpret_cast<char *>(count), sizeof(count));
+	if (ifs.gcount() != sizeof(count))
+	{
+		return size;
+	}
+
+	const int number_of_entries = u16(count);
+	for (int idx = 0; idx < number_of_entries and (size.width == 0 or size.height == 0); idx ++)
+	{
+		// each entry is:  2-byte tag, 2-byte type, 4-byte count, and 4-byte value
+		uint8_t entry[12] = {0};
+		ifs.read(reinterpret_cast<char *>(entry), sizeof(entry));
+		if (ifs.gcount() != sizeof(entry))
+		{
+			break;
+		}
+
+		const int tag	= u16(entry + 0);
+		const int type	= u16(entry + 2);
+		if (tag != 256 and tag != 257) // ImageWidth and ImageLength
+		{
+			continue;
+		}
+
+		// the value is either a SHORT (type 3) or a LONG (type 4), and is stored left-justified in the 4-byte field
+		const int value = (type == 3 ? u16(entry + 8) : type == 4 ? u32(entry + 8) : 0);
+		if (tag == 256)
+		{
+			size.width = value;
+		}
+		else
+		{
+			size.height = value;
+		}
+	}
+
+	return size;
+}
+
+
+cv::Size dm::probe_image_size(const std::string & filename)
+{
+	cv::Size size;
+
+	std::ifstream ifs(filename, std::ifstream::binary);
+	uint8_t header[32] = {0};
+	ifs.read(reinterpret_cast<char *>(header), sizeof(header));
+	if (ifs.gcount() < 26)
+	{
+		return size;
+	}
+
+	if (header[0] == 0x89 and header[1] == 'P' and header[2] == 'N' and header[3] == 'G')
+	{
+		// PNG:  the IHDR chunk must be the first chunk in the file
+		size.width	= be32(header + 16);
+		size.height	= be32(header + 20);
+	}
+	else if (header[0] == 'B' and header[1] == 'M')
+	{
+		// BMP:  height is negative for top-down bitmaps
+		size.width	= le32(header + 18);
+		size.height	= std::abs(le32(header + 22));
+	}
+	else if ((header[0] == 'I' and header[1] == 'I' and header[2] == 42 and header[3] == 0) or
+			 (header[0] == 'M' and header[1] == 'M' and header[2] == 0 and header[3] == 42))
+	{
+		// TIFF:  the dimensions are tags in the first IFD, which can be anywhere in the file
+		size = probe_tiff_size(ifs, header);
+	}
+	else if (header[0] == 0xFF and header[1] == 0xD8)
+	{
+		// JPEG:  skip through the markers until we find the start-of-frame which contains the dimensions
+		ifs.clear();
+		ifs.seekg(2);
+		while (ifs.good())
+		{
+			// markers may be preceded by any number of 0xFF fill bytes
+			int c = ifs.get();
+			if (c != 0xFF)
+			{
+				break;
+			}
+			while (c == 0xFF)
+			{
+				c = ifs.get();
+			}
+			if (c == std::char_traits<char>::eof())
+			{
+				break;
+			}
+
+			const uint8_t type = c;
+			if (type == 0x01 or type == 0xD8 or (type >= 0xD0 and type <= 0xD7))
+			{
+				// TEM, SOI, and RSTn are standalone markers without a length
+				continue;
+			}
+			if (type == 0x00 or type == 0xD9 or type == 0xDA)
+			{
+				// stuffed byte, end-of-image, or start-of-scan:  the start-of-frame must come before any of these
+				break;
+			}
+
+			uint8_t length_bytes[2] = {0};
+			ifs.read(reinterpret_cast<char *>(length_bytes), sizeof(length_bytes));
+			const int length = be16(length_bytes);
+			if (ifs.gcount() != sizeof(length_bytes) or length < 2)
+			{
+				break;
+			}
+
+			const bool is_sof = (type >= 0xC0 and type <= 0xCF and type != 0xC4 and type != 0xC8 and type != 0xCC);
+			if (is_sof)
+			{
+				uint8_t sof[5] = {0};
+				ifs.read(reinterpret_cast<char *>(sof), sizeof(sof));
+				if (ifs.gcount() == sizeof(sof))
+				{
+					size.height	= be16(sof + 1);
+					size.width	= be16(sof + 3);
+				}
+				break;
+			}
+			ifs.seekg(length - 2, std::ios_base::cur);
+		}
+	}
+
+	if (size.width <= 0 or size.height <= 0)
+	{
+		size = cv::Size();
+	}
+
+	return size;
+}
+
+
+int dm::reduced_imread_flags(const cv::Size & source_size, const cv::Size & desired_size)
+{
+	int flags = cv::IMREAD_COLOR;
+	if (source_size.area() > 0 and desired_size.area() > 0)
+	{
+		// compare the long and short sides so it doesn't matter if EXIF orientation swaps width and height
+		const int source_long	= std::max(source_size.width	, source_size.height	);
+		const int source_short	= std::min(source_size.width	, source_size.height	);
+		const int desired_long	= std::max(desired_size.width	, desired_size.height	);
+		const int desired_short	= std::min(desired_size.width	, desired_size.height	);
+
+		for (const auto & [factor, reduced_flags] : {	std::make_pair(8, cv::IMREAD_REDUCED_COLOR_8),
+														std::make_pair(4, cv::IMREAD_REDUCED_COLOR_4),
+														std::make_pair(2, cv::IMREAD_REDUCED_COLOR_2)})
+		{
+			if (source_long / factor >= desired_long and source_short / factor >= desired_short)
+			{
+				flags = reduced_flags;
+				break;
+			}
+		}
+	}
+
+	return flags;
+}
+
+
+cv::Mat dm::imread_reduced(const std::string & filename, const cv::Size & desired_size, cv::Size source_size)
+{
+	if (source_size.area() <= 0)
+	{
+		source_size = probe_image_size(filename);
+	}
+
+	return cv::imread(filename, reduced_imread_flags(source_size, desired_size));
+}
+
+
+bool dm::link_or_copy_file(const std::string & source, const std::string & destination)
+{
+	std::error_code ec;
+	std::filesystem::remove(destination, ec);
+
+	std::filesystem::create_hard_link(source, destination, ec);
+	if (ec)
+	{
+		// copy_file() will use the kernel to copy the data (and clone it on filesystems which support it) when possible
+		ec.clear();
+		std::filesystem::copy_file(source, destination, std::filesystem::copy_options::overwrite_existing, ec);
+	}
+
+	return not ec;
+}
+
+
+double dm::iou(const cv::Rect & lhs, const cv::Rect & rhs)
+{
+	const double intersection	= (lhs & rhs).area();
+	const double total			= lhs.area() + rhs.area() - intersection;
+
+	return (total > 0.0 ? intersection / total : 0.0);
+}
+
+
+DarkHelp::PredictionResults dm::filter_predictions(const DarkHelp::PredictionResults & raw_predictions, const float threshold, const float nms_threshold)
+{
+	DarkHelp::PredictionResults predictions;
+
+	for (auto prediction : raw_predictions)
+	{
+		DarkHelp::MClassProbabilities probabilities;
+		for (const auto & iter : prediction.all_probabilities)
+		{
+			if (iter.second >= threshold)
+			{
+				probabilities[iter.first] = iter.second;
+			}
+		}
+		if (probabilities.empty())
+		{
+			if (prediction.best_probability < threshold)
+			{
+				continue;
+			}
+			probabilities[prediction.best_class] = prediction.best_probability;
+		}
+
+		prediction.all_probabilities	= probabilities;
+		prediction.best_class			= probabilities.begin()->first;
+		prediction.best_probability		= probabilities.begin()->second;
+		for (const auto & iter : probabilities)
+		{
+			if (iter.second > prediction.best_probability)
+			{
+				prediction.best_class		= iter.first;
+				prediction.best_probability	= iter.second;
+			}
+		}
+		predictions.push_back(prediction);
+	}
+
+	// of all the overlapping predictions for the same class, only keep the most confident one
+	std::sort(predictions.begin(), predictions.end(),
+			[](const auto & lhs, const auto & rhs)
+			{
+				return lhs.best_probability > rhs.best_probability;
+			});
+
+	std::vector<bool> suppressed(predictions.size(), false);
+	for (size_t i = 0; i < predictions.size(); i ++)
+	{
+		if (suppressed[i])
+		{
+			continue;
+		}
+
+		for (size_t j = i + 1; j < predictions.size(); j ++)
+		{
+			if (suppressed[j] == false and
+				predictions[i].best_class == predictions[j].best_class and
+				iou(predictions[i].rect, predictions[j].rect) > nms_threshold)
+			{
+				suppressed[j] = true;
+			}
+		}
+	}
+
+	DarkHelp::PredictionResults results;
+	for (size_t idx = 0; idx < predictions.size(); idx ++)
+	{
+		if (suppressed[idx] == false)
+		{
+			results.push_back(predictions[idx]);
+		}
+	}
+
+	return results;
+}
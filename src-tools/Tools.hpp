@@ -12,4 +12,37 @@ namespace dm
 
 	/// Used to generate random numbers.
 	std::default_random_engine & get_random_engine();
+
+	/** Get the dimensions of an image by reading the file header instead of decoding the entire image.  This supports
+	 * JPEG, PNG, BMP, and TIFF files.  Also see @ref AnnotationIndex::get_image_size() which caches the results.  Note
+	 * that EXIF orientation is not taken into account, so the width and height might be swapped compared to what
+	 * @p cv::imread() returns.  @returns an empty size if the dimensions cannot be determined.
+	 */
+	cv::Size probe_image_size(const std::string & filename);
+
+	/** Get the flags to pass to @p cv::imread() or @p cv::imdecode() to decode an image at the smallest reduced resolution
+	 * (1/2, 1/4, or 1/8) which is still at least as large as @p desired_size.  @returns @p cv::IMREAD_COLOR if the image
+	 * cannot be reduced or if either size is unknown.
+	 */
+	int reduced_imread_flags(const cv::Size & source_size, const cv::Size & desired_size);
+
+	/** Decode an image at a reduced resolution when it is much larger than the size at which it will be displayed.  JPEG
+	 * images are decoded using DCT scaling (@p cv::IMREAD_REDUCED_COLOR_2, 4, or 8) which is considerably faster than
+	 * decoding the full image and then resizing it.  If @p source_size is empty, then @ref probe_image_size() is called.
+	 * The image returned is never smaller than @p desired_size unless the original image is smaller.
+	 */
+	cv::Mat imread_reduced(const std::string & filename, const cv::Size & desired_size, cv::Size source_size = cv::Size());
+
+	/** Create @p destination as a hard link to @p source, or a copy of it if hard links are not supported, such as when the
+	 * files are on different filesystems.  An existing @p destination is replaced.  @returns @p false if both failed.
+	 */
+	bool link_or_copy_file(const std::string & source, const std::string & destination);
+
+	/// Intersection over union of two rectangles.
+	double iou(const cv::Rect & lhs, const cv::Rect & rhs);
+
+	/** Apply a confidence threshold and per-class non-maximal suppression to raw DarkHelp predictions, similar to what
+	 * darknet would have done had it been given these thresholds.  The results are sorted by descending probability.
+	 */
+	DarkHelp::PredictionResults filter_predictions(const DarkHelp::PredictionResults & raw_predictions, const float threshold, const float nms_threshold);
 }
@@ -3,9 +3,11 @@
 #include "DarkMark.hpp"
 
 
-dm::DMReviewCanvas::DMReviewCanvas(const MReviewInfo & m, const MStrSize & md5s) :
-	mri(m),
-	md5s(md5s)
+dm::DMReviewCanvas::DMReviewCanvas(DMReviewWnd & w, const VReviewInfo & v) :
+	wnd(w),
+	vri(v),
+	images(w.images),
+	md5s(w.md5s)
 {
 	const int h = cfg().get_int("review_table_row_height");
 	if (h > getRowHeight())
@@ -25,6 +27,7 @@ dm::DMReviewCanvas::DMReviewCanvas(const MReviewInfo & m, const MStrSize & md5s)
 	getHeader().addColumn("md5"			, 10, 100, 30, -1, TableHeaderComponent::defaultFlags);
 	getHeader().addColumn("duplicates"	, 11, 100, 30, -1, TableHeaderComponent::defaultFlags);
 	getHeader().addColumn("message"		, 12, 100, 30, -1, TableHeaderComponent::defaultFlags);
+	getHeader().addColumn("similar"		, 13, 100, 30, -1, TableHeaderComponent::defaultFlags);
 	// if changing columns, also update paintCell() below
 
 	if (cfg().containsKey("review_columns"))
@@ -37,8 +40,8 @@ dm::DMReviewCanvas::DMReviewCanvas(const MReviewInfo & m, const MStrSize & md5s)
 	}
 
 	sort_idx.clear();
-	sort_idx.reserve(mri.size());
-	for (size_t i = 0; i < mri.size(); i ++)
+	sort_idx.reserve(vri.size());
+	for (size_t i = 0; i < vri.size(); i ++)
 	{
 		sort_idx.push_back(i);
 	}
@@ -59,17 +62,17 @@ dm::DMReviewCanvas::~DMReviewCanvas()
 
 int dm::DMReviewCanvas::getNumRows()
 {
-	return mri.size();
+	return vri.size();
 }
 
 
 void dm::DMReviewCanvas::cellDoubleClicked(int rowNumber, int columnId, const MouseEvent & event)
 {
 	// rows are 0-based, columns are 1-based
-	if (rowNumber >= 0 and rowNumber < (int)mri.size())
+	if (rowNumber >= 0 and rowNumber < (int)vri.size())
 	{
-		const auto & review_info = mri.at(sort_idx[rowNumber]);
-		const std::string & fn = review_info.filename;
+		const auto & review_info = vri.at(sort_idx[rowNumber]);
+		const std::string & fn = images.at(review_info.image_idx).filename;
 
 		// we know which image we want to load, but we need the index of that image within the vector of image filenames
 
@@ -119,10 +122,10 @@ void dm::DMReviewCanvas::cellDoubleClicked(int rowNumber, int columnId, const Mo
 String dm::DMReviewCanvas::getCellTooltip(int rowNumber, int columnId)
 {
 	// rows are 0-based, columns are 1-based
-	if (rowNumber >= 0 and rowNumber < (int)mri.size())
+	if (rowNumber >= 0 and rowNumber < (int)vri.size())
 	{
-		const auto & review_info = mri.at(sort_idx[rowNumber]);
-		const std::string & fn = review_info.filename;
+		const auto & review_info = vri.at(sort_idx[rowNumber]);
+		const std::string & fn = images.at(review_info.image_idx).filename;
 
 		return "double click to open " + fn;
 	}
@@ -134,33 +137,34 @@ String dm::DMReviewCanvas::getCellTooltip(int rowNumber, int columnId)
 void dm::DMReviewCanvas::paintRowBackground(Graphics & g, int rowNumber, int width, int height, bool rowIsSelected)
 {
 	if (rowNumber < 0					or
-		rowNumber >= (int)mri.size()	)
+		rowNumber >= (int)vri.size()	)
 	{
 		// how did we ever get an invalid row?
-		Log("invalid row detected: " + std::to_string(rowNumber) + "/" + std::to_string(mri.size()));
+		Log("invalid row detected: " + std::to_string(rowNumber) + "/" + std::to_string(vri.size()));
 		return;
 	}
 
 	Colour colour = Colours::white;
 
 	if (rowNumber >= 0 and
-		rowNumber < (int)mri.size())
+		rowNumber < (int)vri.size())
 	{
-		const auto & review_info = mri.at(sort_idx[rowNumber]);
+		const auto & review_info = vri.at(sort_idx[rowNumber]);
+		const auto & md5 = images.at(review_info.image_idx).md5;
 
 		if (rowIsSelected)
 		{
 			colour = Colours::lightblue; // selected rows will have a blue background
 		}
-		else if (review_info.warnings.size() > 0)
+		else if (review_info.number_of_warnings() > 0)
 		{
 			colour = Colours::lightyellow;
 		}
-		else if (review_info.errors.size() > 0)
+		else if (review_info.number_of_errors() > 0)
 		{
 			colour = Colours::lightpink;
 		}
-		else if (md5s.at(review_info.md5) > 1)
+		else if (md5s.count(md5) and md5s.at(md5) > 1)
 		{
 			colour = Colours::lightcoral;
 		}
@@ -179,9 +183,9 @@ void dm::DMReviewCanvas::paintRowBackground(Graphics & g, int rowNumber, int wid
 void dm::DMReviewCanvas::paintCell(Graphics & g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
 {
 	if (rowNumber < 0					or
-		rowNumber >= (int)mri.size()	or
+		rowNumber >= (int)vri.size()	or
 		columnId < 1					or
-		columnId > 12					)
+		columnId > 13					)
 	{
 		// rows are 0-based, columns are 1-based
 		return;
@@ -191,7 +195,8 @@ void dm::DMReviewCanvas::paintCell(Graphics & g, int rowNumber, int columnId, in
 
 	g.setOpacity(1.0);
 
-	const auto & review_info = mri.at(sort_idx[rowNumber]);
+	const auto & review_info = vri.at(sort_idx[rowNumber]);
+	const auto & image = images.at(review_info.image_idx);
 
 	/* columns:
 	 *		1: row number
@@ -206,39 +211,68 @@ void dm::DMReviewCanvas::paintCell(Graphics & g, int rowNumber, int columnId, in
 	 *		10: md5
 	 *		11: duplicates
 	 *		12: warning + error messages
+	 *		13: similar (near-duplicate) images
 	 */
 
 	if (columnId == 2)
 	{
-		if (review_info.mat.empty() == false)
+		auto iter = thumbnails.find(rowNumber);
+		if (iter == thumbnails.end() or iter->second.width != width or iter->second.height != height)
 		{
-			// draw a thumbnail of the image
-			auto image = convert_opencv_mat_to_juce_image(review_info.mat);
-			g.drawImageWithin(image, 0, 0, width, height,
-					RectanglePlacement::xLeft				|
-					RectanglePlacement::yMid				|
-					RectanglePlacement::onlyReduceInSize	);
+			// the thumbnail is only created now that the row is visible
+			cv::Mat mat = wnd.get_thumbnail(review_info.class_idx, sort_idx[rowNumber]);
+
+			CachedThumbnail cached;
+			cached.width	= width;
+			cached.height	= height;
+			if (mat.empty() == false)
+			{
+				// resize the image once to fit within the cell so it can be drawn as-is every time the row is painted
+				const double factor = std::min({1.0, static_cast<double>(width) / mat.cols, static_cast<double>(height) / mat.rows});
+				if (factor < 1.0)
+				{
+					cv::Mat resized;
+					cv::resize(mat, resized, cv::Size(std::max(1, static_cast<int>(std::round(factor * mat.cols))), std::max(1, static_cast<int>(std::round(factor * mat.rows)))), 0, 0, cv::INTER_AREA);
+					mat = resized;
+				}
+				cached.image = convert_opencv_mat_to_juce_image(mat);
+			}
+
+			evict_thumbnails();
+			iter = thumbnails.insert_or_assign(rowNumber, cached).first;
+		}
+
+		const Image & thumbnail = iter->second.image;
+		if (thumbnail.isValid())
+		{
+			// draw a thumbnail of the image, left-justified and vertically centered
+			g.drawImageAt(thumbnail, 0, (height - thumbnail.getHeight()) / 2);
 		}
 	}
 	else
 	{
 		std::string str;
 		if (columnId == 1)	str = std::to_string(sort_idx[rowNumber] + 1);
-		if (columnId == 3)	str = std::to_string((int)std::round(100.0 * static_cast<double>(review_info.mat.cols) / std::max(1.0, static_cast<double>(review_info.r.width)))) + "%";
+		if (columnId == 3)	str = std::to_string((int)std::round(100.0 * static_cast<double>(wnd.get_thumbnail_size(review_info).width) / std::max(1.0, static_cast<double>(review_info.r.width)))) + "%";
 		if (columnId == 4)	str = std::to_string(review_info.r.width) + " x " + std::to_string(review_info.r.height);
 		if (columnId == 5)	str = std::to_string(static_cast<double>(review_info.r.width) / static_cast<double>(review_info.r.height));
-		if (columnId == 9)	str = review_info.mime_type;
-		if (columnId == 10)	str = review_info.md5;
+		if (columnId == 9)	str = image.mime_type;
+		if (columnId == 10)	str = image.md5;
 
-		if (columnId == 11)
+		if (columnId == 11 and md5s.count(image.md5))
 		{
-			const auto count = md5s.at(review_info.md5);
+			const auto count = md5s.at(image.md5);
 			if (count > 1)
 			{
 				str = std::to_string(count);
 			}
 		}
 
+		if (columnId == 13 and image.similar_count > 0)
+		{
+			str = std::to_string(image.similar_count);
+		}
+
 		if (columnId == 6)
 		{
 			if (review_info.r.area() > 0)
@@ -265,12 +299,12 @@ void dm::DMReviewCanvas::paintCell(Graphics & g, int rowNumber, int columnId, in
 
 		if (columnId == 8)
 		{
-			str = review_info.filename;
+			str = image.filename;
 
 			// see if this string will fit in the cell, and if not attempt to shorten it
 			const int max_len = 1.05 * width;
 			auto font = g.getCurrentFont();
-			String fn = review_info.filename;
+			String fn = image.filename;
 			while (true)
 			{
 				const auto len = font.getStringWidth(fn);
@@ -290,7 +324,7 @@ void dm::DMReviewCanvas::paintCell(Graphics & g, int rowNumber, int columnId, in
 				fn = fn.substring(pos);
 			}
 
-			if (fn.toStdString() != review_info.filename)
+			if (fn.toStdString() != image.filename)
 			{
 				str = "..." + fn.toStdString();
 			}
@@ -298,16 +332,7 @@ void dm::DMReviewCanvas::paintCell(Graphics & g, int rowNumber, int columnId, in
 
 		if (columnId == 12)
 		{
-			for (const auto & msg : review_info.warnings)
-			{
-				if (str.empty() == false)
-				{
-					str += "; ";
-				}
-				str += msg;
-			}
-
-			for (const auto & msg : review_info.errors)
+			for (const auto & msg : wnd.get_messages(review_info))
 			{
 				if (str.empty() == false)
 				{
@@ -336,6 +361,36 @@ void dm::DMReviewCanvas::paintCell(Graphics & g, int rowNumber, int columnId, in
 }
 
 
+void dm::DMReviewCanvas::evict_thumbnails()
+{
+	const int row_height = std::max(1, getRowHeight());
+	const Viewport * viewport = getViewport();
+	if (viewport == nullptr)
+	{
+		return;
+	}
+
+	// keep an extra screen of rows above and below what is currently visible so scrolling back and forth is smooth
+	const int visible_rows	= viewport->getViewHeight() / row_height + 1;
+	const int first_row		= viewport->getViewPositionY() / row_height - visible_rows;
+	const int last_row		= first_row + 3 * visible_rows;
+
+	for (auto iter = thumbnails.begin(); iter != thumbnails.end(); )
+	{
+		if (iter->first < first_row or iter->first > last_row)
+		{
+			iter = thumbnails.erase(iter);
+		}
+		else
+		{
+			iter ++;
+		}
+	}
+
+	return;
+}
+
+
 void dm::DMReviewCanvas::sortOrderChanged(int newSortColumnId, bool isForwards)
 {
 	/* note the sort column is 1-based:
@@ -351,22 +406,26 @@ void dm::DMReviewCanvas::sortOrderChanged(int newSortColumnId, bool isForwards)
 	 *		10: md5
 	 *		11: duplicates
 	 *		12: warning + error messages
+	 *		13: similar (near-duplicate) images
 	 */
 
-	if (newSortColumnId < 1 or newSortColumnId > 12)
+	if (newSortColumnId < 1 or newSortColumnId > 13)
 	{
 		Log("cannot sort table on invalid column=" + std::to_string(newSortColumnId));
 		return;
 	}
 
-	if (mri.size() == 0 or sort_idx.size() == 0 or mri.size() != sort_idx.size())
+	if (vri.size() == 0 or sort_idx.size() == 0 or vri.size() != sort_idx.size())
 	{
 		// nothing to sort!?
-		Log("cannot sort table -- invalid number of rows...!?  (mri=" + std::to_string(mri.size()) + ", sort=" + std::to_string(sort_idx.size()) + ")");
+		Log("cannot sort table -- invalid number of rows...!?  (vri=" + std::to_string(vri.size()) + ", sort=" + std::to_string(sort_idx.size()) + ")");
 		return;
 	}
 
-	const size_t class_idx = mri.at(0).class_idx;
+	// rows are about to move around, so the cached thumbnails no longer match the row numbers
+	thumbnails.clear();
+
+	const size_t class_idx = vri.at(0).class_idx;
 	Log("sorting " + std::to_string(sort_idx.size()) + " rows of data for class #" + std::to_string(class_idx) + " using column #" + std::to_string(newSortColumnId));
 
 	std::sort(sort_idx.begin(), sort_idx.end(),
@@ -377,15 +436,15 @@ void dm::DMReviewCanvas::sortOrderChanged(int newSortColumnId, bool isForwards)
 					std::swap(lhs_idx, rhs_idx);
 				}
 
-				const auto & lhs_info = mri.at(lhs_idx);
-				const auto & rhs_info = mri.at(rhs_idx);
+				const auto & lhs_info = vri.at(lhs_idx);
+				const auto & rhs_info = vri.at(rhs_idx);
 
 				switch (newSortColumnId)
 				{
 					case 3:
 					{
-						const auto lhs_zoom = static_cast<double>(lhs_info.mat.cols) / std::max(1.0, static_cast<double>(lhs_info.r.width));
-						const auto rhs_zoom = static_cast<double>(rhs_info.mat.cols) / std::max(1.0, static_cast<double>(rhs_info.r.width));
+						const auto lhs_zoom = static_cast<double>(wnd.get_thumbnail_size(lhs_info).width) / std::max(1.0, static_cast<double>(lhs_info.r.width));
+						const auto rhs_zoom = static_cast<double>(wnd.get_thumbnail_size(rhs_info).width) / std::max(1.0, static_cast<double>(rhs_info.r.width));
 
 						if (lhs_zoom != rhs_zoom)
 						{
@@ -432,54 +491,80 @@ void dm::DMReviewCanvas::sortOrderChanged(int newSortColumnId, bool isForwards)
 					}
 					case 8:
 					{
-						if (lhs_info.filename != rhs_info.filename)
+						if (lhs_info.image_idx != rhs_info.image_idx)
 						{
-							return lhs_idx < rhs_idx;
+							// images are stored in the same order as the filenames in the project
+							return lhs_info.image_idx < rhs_info.image_idx;
 						}
 						// if the mime-type is the same, then sort by index
 						return lhs_idx < rhs_idx;
 					}
 					case 9:
 					{
-						if (lhs_info.mime_type != rhs_info.mime_type)
+						const auto & lhs_mime_type = images.at(lhs_info.image_idx).mime_type;
+						const auto & rhs_mime_type = images.at(rhs_info.image_idx).mime_type;
+						if (lhs_mime_type != rhs_mime_type)
 						{
-							return lhs_info.mime_type < rhs_info.mime_type;
+							return lhs_mime_type < rhs_mime_type;
 						}
 						// if the mime-type is the same, then sort by index
 						return lhs_idx < rhs_idx;
 					}
 					case 10:
 					{
-						if (lhs_info.md5 != rhs_info.md5)
+						const auto & lhs_md5 = images.at(lhs_info.image_idx).md5;
+						const auto & rhs_md5 = images.at(rhs_info.image_idx).md5;
+						if (lhs_md5 != rhs_md5)
 						{
-							return lhs_info.md5 < rhs_info.md5;
+							return lhs_md5 < rhs_md5;
 						}
 						// if the mime-type is the same, then sort by index
 						return lhs_idx < rhs_idx;
 					}
 					case 11:
 					{
-						const auto & lhs_count = md5s.at(lhs_info.md5);
-						const auto & rhs_count = md5s.at(rhs_info.md5);
+						const auto & lhs_md5 = images.at(lhs_info.image_idx).md5;
+						const auto & rhs_md5 = images.at(rhs_info.image_idx).md5;
+						const auto lhs_count = (md5s.count(lhs_md5) ? md5s.at(lhs_md5) : 0);
+						const auto rhs_count = (md5s.count(rhs_md5) ? md5s.at(rhs_md5) : 0);
 						if (lhs_count != rhs_count)
 						{
 							return lhs_count < rhs_count;
 						}
-						if (lhs_info.md5 != rhs_info.md5)
+						if (lhs_md5 != rhs_md5)
 						{
-							return lhs_info.md5 < rhs_info.md5;
+							return lhs_md5 < rhs_md5;
 						}
 						// if the mime-type is the same, then sort by index
 						return lhs_idx < rhs_idx;
 					}
 					case 12:
 					{
-						if (lhs_info.errors.size()		!= rhs_info.errors.size())		return lhs_info.errors.size()	< rhs_info.errors.size();
-						if (lhs_info.warnings.size()	!= rhs_info.warnings.size())	return lhs_info.warnings.size()	< rhs_info.warnings.size();
+						const auto lhs_errors	= lhs_info.number_of_errors();
+						const auto rhs_errors	= rhs_info.number_of_errors();
+						const auto lhs_warnings	= lhs_info.number_of_warnings();
+						const auto rhs_warnings	= rhs_info.number_of_warnings();
+						if (lhs_errors		!= rhs_errors)		return lhs_errors	< rhs_errors;
+						if (lhs_warnings	!= rhs_warnings)	return lhs_warnings	< rhs_warnings;
 
 						// otherwise if there are the same number of errors and warning, sort by mark index
 						return lhs_idx < rhs_idx;
 					}
+					case 13:
+					{
+						// sort by the size of the group, and then keep the images from the same group together
+						const auto & lhs_image = images.at(lhs_info.image_idx);
+						const auto & rhs_image = images.at(rhs_info.image_idx);
+						if (lhs_image.similar_count != rhs_image.similar_count)
+						{
+							return lhs_image.similar_count < rhs_image.similar_count;
+						}
+						if (lhs_image.similar_group != rhs_image.similar_group)
+						{
+							return lhs_image.similar_group < rhs_image.similar_group;
+						}
+						return lhs_idx < rhs_idx;
+					}
 					default:
 					{
 						return lhs_idx < rhs_idx;
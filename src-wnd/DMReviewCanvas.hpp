@@ -15,7 +15,7 @@ namespace dm
 		public:
 
 			/// Constructor.
-			DMReviewCanvas(const MReviewInfo & m, const MStrSize & md5s);
+			DMReviewCanvas(DMReviewWnd & w, const VReviewInfo & v);
 
 			/// Destructor.
 			virtual ~DMReviewCanvas();
@@ -28,12 +28,33 @@ namespace dm
 			virtual void sortOrderChanged(int newSortColumnId, bool isForwards) override;
 
 			/** This determines the order in which rows will appear.
-			 * E.g., sort_idx[0] is the map index of the review info that must appear as the first row in the table.
+			 * E.g., sort_idx[0] is the vector index of the review info that must appear as the first row in the table.
 			 */
 			std::vector<size_t> sort_idx;
 
-			/// Map of review info, where each map record has everything needed to represent a single row in the table.
-			const MReviewInfo & mri;
+			/// The review window owns the per-image information and the thumbnails.
+			DMReviewWnd & wnd;
+
+			/// Vector of review info, where each record together with @ref DMReviewWnd::images describes a single row in the table.
+			const VReviewInfo & vri;
+			const VReviewImages & images;
 			const MStrSize & md5s;
+
+		private:
+
+			/// Remove the cached thumbnails of rows which are no longer near the visible portion of the table.
+			void evict_thumbnails();
+
+			struct CachedThumbnail
+			{
+				Image image;
+				int width;	///< Width of the cell when the thumbnail was created.
+				int height;	///< Height of the cell when the thumbnail was created.
+			};
+
+			/** Thumbnails which have already been resized to fit in their cell and converted to JUCE images.  The key is the
+			 * row number, so this must be cleared whenever the rows are sorted.
+			 */
+			std::map<int, CachedThumbnail> thumbnails;
 	};
 }
@@ -2,10 +2,15 @@
 
 #include "DarkMark.hpp"
 
+#include <bitset>
+
 
 dm::DMReviewWnd::DMReviewWnd(DMContent & c) :
 	DocumentWindow("DarkMark v" DARKMARK_VERSION " Review", Colours::darkgrey, TitleBarButtons::allButtons),
-	content(c)
+	content(c),
+	row_height(cfg().get_int("review_table_row_height")),
+	resize_thumbnails(cfg().get_bool("review_resize_thumbnails")),
+	max_thumbnails(1000)
 {
 	setContentNonOwned		(&notebook, true);
 	setUsingNativeTitleBar	(true			);
@@ -69,10 +74,17 @@ void dm::DMReviewWnd::rebuild_notebook()
 		notebook.removeTab(0);
 	}
 
+	// the marks have changed, so none of the existing thumbnails can be used
+	thumbnails.clear();
+	lru.clear();
+	recent_images.clear();
+	row_height			= cfg().get_int("review_table_row_height");
+	resize_thumbnails	= cfg().get_bool("review_resize_thumbnails");
+
 	for (auto iter : m)
 	{
 		const size_t class_idx = iter.first;
-		const MReviewInfo & mri = m.at(class_idx);
+		const VReviewInfo & vri = m.at(class_idx);
 
 		std::string name = "#" + std::to_string(class_idx);
 		if (content.names.size() > class_idx)
@@ -85,10 +97,201 @@ void dm::DMReviewWnd::rebuild_notebook()
 			name = "* errors *";
 		}
 
-		Log("creating a notebook tab for class \"" + name + "\", mri has " + std::to_string(mri.size()) + " entries");
+		Log("creating a notebook tab for class \"" + name + "\", vri has " + std::to_string(vri.size()) + " entries");
 
-		notebook.addTab(name, Colours::darkgrey, new DMReviewCanvas(mri, md5s), true);
+		notebook.addTab(name, Colours::darkgrey, new DMReviewCanvas(*this, vri), true);
 	}
 
 	return;
 }
+
+
+size_t dm::ReviewInfo::number_of_errors() const
+{
+	return std::bitset<16>(flags & kReviewErrorMask).count();
+}
+
+
+size_t dm::ReviewInfo::number_of_warnings() const
+{
+	return std::bitset<16>(flags & kReviewWarningMask).count();
+}
+
+
+dm::VStr dm::DMReviewWnd::get_messages(const ReviewInfo & review_info) const
+{
+	VStr v;
+
+	const auto & image = images.at(review_info.image_idx);
+
+	if (review_info.flags & kReviewWarningUnusualType)
+	{
+		v.push_back("unusual image type");
+	}
+	if (review_info.flags & kReviewWarningOverlap)
+	{
+		v.push_back("overlap (intersection over union) seems high");
+	}
+	if ((review_info.flags & kReviewWarningTooSmall) and image.original_size.area() > 0)
+	{
+		const int scaled_width	= static_cast<double>(content.project_info.image_width)	* review_info.r.width	/ image.original_size.width;
+		const int scaled_height	= static_cast<double>(content.project_info.image_height)	* review_info.r.height	/ image.original_size.height;
+		v.push_back("scaled mark measuring " + std::to_string(scaled_width) + "x" + std::to_string(scaled_height) + " may be too small to detect");
+	}
+
+	if (image.error.empty() == false)
+	{
+		v.push_back(image.error);
+	}
+	if (review_info.flags & kReviewErrorJson)
+	{
+		v.push_back("error reading json file " + File(image.filename).withFileExtension(".json").getFullPathName().toStdString());
+	}
+	if (review_info.flags & kReviewErrorImage)
+	{
+		v.push_back("error reading image file " + image.filename);
+	}
+	if (review_info.flags & kReviewErrorNoMarks)
+	{
+		v.push_back("no marks defined, yet image is not marked as empty");
+	}
+	if (review_info.flags & kReviewErrorNotAnImage)
+	{
+		v.push_back("not an image");
+	}
+	if (review_info.flags & kReviewErrorROI)
+	{
+		v.push_back("error reading image or region of interest; maybe try to delete and re-create the mark?");
+	}
+
+	return v;
+}
+
+
+cv::Size dm::DMReviewWnd::get_thumbnail_size(const ReviewInfo & review_info) const
+{
+	const cv::Rect & r = review_info.r;
+
+	if ((review_info.flags & kReviewErrorNoThumbnail) or r.area() <= 0)
+	{
+		return cv::Size(32, 32);
+	}
+
+	if ((review_info.flags & kReviewEmptyImage) or resize_thumbnails or r.height > row_height)
+	{
+		// same as DarkHelp::resize_keeping_aspect_ratio() with a desired size of 9999 x row_height
+		return cv::Size(std::max(1, static_cast<int>(std::round(static_cast<double>(r.width) * row_height / r.height))), row_height);
+	}
+
+	return r.size();
+}
+
+
+cv::Mat dm::DMReviewWnd::load_image(const ReviewInfo & review_info)
+{
+	const auto & image = images.at(review_info.image_idx);
+	const cv::Size & original_size = image.original_size;
+
+	// figure out how large the image needs to be so the thumbnail isn't created by enlarging a smaller copy of the image
+	const int long_side = std::max(original_size.width, original_size.height);
+	int min_long_side = long_side;
+	if (review_info.flags & kReviewEmptyImage)
+	{
+		min_long_side = std::ceil(static_cast<double>(long_side) * row_height / std::max(1, original_size.height));
+	}
+	else if (review_info.r.height >= 1 and (resize_thumbnails or review_info.r.height > row_height))
+	{
+		min_long_side = std::ceil(static_cast<double>(long_side) * row_height / review_info.r.height);
+	}
+
+	for (auto iter = recent_images.begin(); iter != recent_images.end(); iter ++)
+	{
+		if (iter->first == review_info.image_idx and std::max(iter->second.cols, iter->second.rows) >= std::min(min_long_side, long_side))
+		{
+			recent_images.splice(recent_images.begin(), recent_images, iter);
+			return iter->second;
+		}
+	}
+
+	cv::Mat mat;
+	if (min_long_side >= long_side or content.thumbnail_cache.get(image.filename, min_long_side, mat, false) == false)
+	{
+		mat = cv::imread(image.filename);
+	}
+
+	if (mat.empty() == false)
+	{
+		recent_images.push_front(std::make_pair(review_info.image_idx, mat));
+		while (recent_images.size() > 4)
+		{
+			recent_images.pop_back();
+		}
+	}
+
+	return mat;
+}
+
+
+cv::Mat dm::DMReviewWnd::get_thumbnail(const size_t class_idx, const size_t idx)
+{
+	const auto key = std::make_pair(class_idx, idx);
+	auto iter = thumbnails.find(key);
+	if (iter != thumbnails.end())
+	{
+		lru.splice(lru.begin(), lru, iter->second.lru);
+		return iter->second.mat;
+	}
+
+	const auto & review_info = m.at(class_idx).at(idx);
+	const auto & image = images.at(review_info.image_idx);
+
+	cv::Mat thumbnail;
+	if ((review_info.flags & kReviewErrorNoThumbnail) == 0)
+	{
+		try
+		{
+			cv::Mat mat = load_image(review_info);
+			if (mat.empty() == false and image.original_size.area() > 0)
+			{
+				// the image might be a smaller copy from the thumbnail cache, in which case the mark needs to be scaled
+				const double mat_scale_x = static_cast<double>(mat.cols) / image.original_size.width;
+				const double mat_scale_y = static_cast<double>(mat.rows) / image.original_size.height;
+				const cv::Rect & r = review_info.r;
+				const cv::Rect r_mat(
+					std::round(mat_scale_x * r.x		),
+					std::round(mat_scale_y * r.y		),
+					std::round(mat_scale_x * r.width	),
+					std::round(mat_scale_y * r.height	));
+				cv::Mat roi = mat(r_mat & cv::Rect(0, 0, mat.cols, mat.rows));
+				if ((review_info.flags & kReviewEmptyImage) or resize_thumbnails or roi.rows > row_height)
+				{
+					thumbnail = DarkHelp::resize_keeping_aspect_ratio(roi, cv::Size(9999, row_height)).clone();
+				}
+				else
+				{
+					thumbnail = roi.clone();
+				}
+			}
+		}
+		catch (const std::exception & e)
+		{
+			Log("failed to create a review thumbnail for " + image.filename + ": " + e.what());
+		}
+	}
+
+	if (thumbnail.empty())
+	{
+		thumbnail = cv::Mat(32, 32, CV_8UC3, cv::Scalar(0, 0, 255)); // use a red square to indicate a problem
+	}
+
+	lru.push_front(key);
+	thumbnails[key] = {thumbnail, lru.begin()};
+
+	while (thumbnails.size() > max_thumbnails)
+	{
+		thumbnails.erase(lru.back());
+		lru.pop_back();
+	}
+
+	return thumbnail;
+}
@@ -7,31 +7,63 @@
 
 namespace dm
 {
-	struct ReviewInfo
+	/// Problems detected with a mark or an image.  These are combined together in @ref ReviewInfo::flags.
+	enum EReviewFlags : uint16_t
+	{
+		kReviewNone					= 0x0000,
+		kReviewErrorJson			= 0x0001,	///< Error reading the .json file.
+		kReviewErrorImage			= 0x0002,	///< Error reading the image file.
+		kReviewErrorNoMarks			= 0x0004,	///< No marks defined, yet the image is not marked as empty.
+		kReviewErrorROI				= 0x0008,	///< The mark is outside the image.
+		kReviewErrorNotAnImage		= 0x0010,	///< The MIME type is not an image.
+		kReviewWarningUnusualType	= 0x0100,	///< The image is neither JPEG nor PNG.
+		kReviewWarningOverlap		= 0x0200,	///< The sum of the overlap with other marks is >= 10%.
+		kReviewWarningTooSmall		= 0x0400,	///< The mark may be too small to detect once resized to the network dimensions.
+		kReviewEmptyImage			= 0x1000,	///< The mark is an entire image which was marked as empty.
+		kReviewErrorMask			= 0x00FF,
+		kReviewWarningMask			= 0x0F00,
+		/// Errors which mean there is no mark to show, in which case a red square is shown instead.
+		kReviewErrorNoThumbnail		= kReviewErrorJson | kReviewErrorImage | kReviewErrorNoMarks | kReviewErrorROI,
+	};
+
+	/// Information shared by all the marks in an image.  Stored once per image in @ref DMReviewWnd::images.
+	struct ReviewImage
 	{
-		cv::Mat mat;
 		std::string filename;
-		size_t class_idx;
-		cv::Rect r;
-		double overlap_sum; // the total amount of overlap between this mark and all other marks in this image
 		std::string mime_type;
 		std::string md5;
-		VStr warnings;
-		VStr errors;
+		cv::Size original_size;
+		std::string error; ///< Exception message, if something went wrong while reading the image or the .json file.
+		uint64_t dhash; ///< Perceptual hash, only valid when the original size is known.  See @ref dhash().
+		size_t similar_group; ///< Index of the first image in the group of near-duplicates.  See @ref group_near_duplicates().
+		size_t similar_count; ///< Number of other images which are near-duplicates of this one.
+	};
+	typedef std::vector<ReviewImage> VReviewImages;
+
+	/** Compact description of a single row in the review table.  This does not contain the thumbnail of the mark, which
+	 * is only created when the row is drawn.  See @ref DMReviewWnd::get_thumbnail().
+	 */
+	struct ReviewInfo
+	{
+		uint32_t image_idx; ///< Index into @ref DMReviewWnd::images.
+		uint32_t class_idx;
+		cv::Rect r;
+		float overlap_sum; // the total amount of overlap between this mark and all other marks in this image
+		uint16_t flags; ///< Combination of @ref EReviewFlags.
+
+		size_t number_of_errors() const;
+		size_t number_of_warnings() const;
 	};
 
-	/** Key is a sequential counter that starts at zero, value is the review info structure.  Was done this way instead of
-	 * std::vector because there is no reason why the entries need to be in a single large block of memory, yet we need to
-	 * easily retrieve an object with operator[] when we draw the table in the review.
-	 *
-	 * 2021-05-12: ...and yet here I am two years later trying to shoehorn sorting into the tables!
+	/** All of the marks for a single class.  The index into the vector is also the row number shown in the first column
+	 * of the review table.
 	 */
-	typedef std::map<size_t, ReviewInfo> MReviewInfo;
+	typedef std::vector<ReviewInfo> VReviewInfo;
 
-	/** Multiple MReviewInfo objects, typically one for each class defined.  The key is the class index, the value is the
-	 * review info map.
+	/** Multiple VReviewInfo objects, typically one for each class defined.  The key is the class index, the value is the
+	 * vector of review info.
 	 */
-	typedef std::map<size_t, MReviewInfo> MMReviewInfo;
+	typedef std::map<size_t, VReviewInfo> MMReviewInfo;
 
 	/// Also see the class @ref DMReviewCanvas which is the content shown in the notebook.
 	class DMReviewWnd : public DocumentWindow
@@ -47,9 +79,47 @@ namespace dm
 
 			void rebuild_notebook();
 
+			/** Get the thumbnail to show for the given mark.  Thumbnails are only created when they are needed to draw a row,
+			 * and are kept in a bounded LRU cache.  Must only be called from the message thread.
+			 */
+			cv::Mat get_thumbnail(const size_t class_idx, const size_t idx);
+
+			/// Get the size of the thumbnail @ref get_thumbnail() would return, without having to load the image.
+			cv::Size get_thumbnail_size(const ReviewInfo & review_info) const;
+
+			/// Get all of the warning and error messages for the given mark.
+			VStr get_messages(const ReviewInfo & review_info) const;
+
 			DMContent & content;
 			Notebook notebook;
 			MMReviewInfo m;
+			VReviewImages images;
 			MStrSize md5s;
+
+		private:
+
+			/// Get the image to use when creating the thumbnail for the given mark.
+			cv::Mat load_image(const ReviewInfo & review_info);
+
+			int row_height;
+			bool resize_thumbnails;
+
+			/// Maximum number of thumbnails to keep in @ref thumbnails.
+			size_t max_thumbnails;
+
+			struct Thumbnail
+			{
+				cv::Mat mat;
+				std::list<std::pair<size_t, size_t>>::iterator lru;
+			};
+
+			/// Thumbnails indexed by class and row index.
+			std::map<std::pair<size_t, size_t>, Thumbnail> thumbnails;
+
+			/// Most recently used thumbnails are at the front of the list.
+			std::list<std::pair<size_t, size_t>> lru;
+
+			/// The last few images loaded, since consecutive rows are often marks from the same image.
+			std::list<std::pair<size_t, cv::Mat>> recent_images;
 	};
 }
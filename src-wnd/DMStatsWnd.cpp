@@ -3,6 +3,65 @@
 #include "DarkMark.hpp"
 
 
+dm::Stats & dm::Stats::merge(const Stats & rhs)
+{
+	count				+= rhs.count;
+	number_of_images	+= rhs.number_of_images;
+
+	width			.merge(rhs.width);
+	height			.merge(rhs.height);
+	area			.merge(rhs.area);
+	width_sketch	.merge(rhs.width_sketch);
+	height_sketch	.merge(rhs.height_sketch);
+
+	if (rhs.min_area < min_area)
+	{
+		min_area		= rhs.min_area;
+		min_size		= rhs.min_size;
+		min_filename	= rhs.min_filename;
+	}
+	if (rhs.max_area > max_area)
+	{
+		max_area		= rhs.max_area;
+		max_size		= rhs.max_size;
+		max_filename	= rhs.max_filename;
+	}
+
+	if (rhs.min_number_of_marks_per_image > 0 and (min_number_of_marks_per_image == 0 or rhs.min_number_of_marks_per_image < min_number_of_marks_per_image))
+	{
+		min_number_of_marks_per_image	= rhs.min_number_of_marks_per_image;
+		min_number_of_marks_filename	= rhs.min_number_of_marks_filename;
+	}
+	if (rhs.max_number_of_marks_per_image > max_number_of_marks_per_image)
+	{
+		max_number_of_marks_per_image	= rhs.max_number_of_marks_per_image;
+		max_number_of_marks_filename	= rhs.max_number_of_marks_filename;
+	}
+
+	return *this;
+}
+
+
+dm::Stats & dm::Stats::finalize()
+{
+	if (count > 0)
+	{
+		avg_w = width	.mean();
+		avg_h = height	.mean();
+		avg_a = area	.mean();
+
+		standard_deviation_width	= width	.standard_deviation();
+		standard_deviation_height	= height.standard_deviation();
+
+		p5_size		= cv::Size(std::round(width_sketch.quantile(0.05)), std::round(height_sketch.quantile(0.05)));
+		p50_size	= cv::Size(std::round(width_sketch.quantile(0.50)), std::round(height_sketch.quantile(0.50)));
+		p95_size	= cv::Size(std::round(width_sketch.quantile(0.95)), std::round(height_sketch.quantile(0.95)));
+	}
+
+	return *this;
+}
+
+
 dm::DMStatsWnd::DMStatsWnd(DMContent & c) :
 		DocumentWindow("DarkMark v" DARKMARK_VERSION " Statistics", Colours::lightgrey, TitleBarButtons::closeButton),
 		content(c)
@@ -18,6 +77,9 @@ dm::DMStatsWnd::DMStatsWnd(DMContent & c) :
 	tlb.getHeader().addColumn("SD height"	, 9, 100, 30, -1, TableHeaderComponent::notSortable);
 	tlb.getHeader().addColumn("min marks"	, 10, 100, 30, -1, TableHeaderComponent::notSortable);
 	tlb.getHeader().addColumn("max marks"	, 11, 100, 30, -1, TableHeaderComponent::notSortable);
+	tlb.getHeader().addColumn("5% size"		, 12, 100, 30, -1, TableHeaderComponent::notSortable);
+	tlb.getHeader().addColumn("median size"	, 13, 100, 30, -1, TableHeaderComponent::notSortable);
+	tlb.getHeader().addColumn("95% size"	, 14, 100, 30, -1, TableHeaderComponent::notSortable);
 	// if changing columns, also update paintCell() below
 
 	tlb.getHeader().setStretchToFitActive(true);
@@ -126,6 +188,9 @@ String dm::DMStatsWnd::getCellTooltip(int rowNumber, int columnId)
 	// 7 is maximum size
 	if (columnId == 8) return "standard deviation of the object's width (in pixels)";
 	if (columnId == 9) return "standard deviation of the object's height (in pixels)";
+	if (columnId == 12) return "5% of the objects have a width and height smaller than this (approximate)";
+	if (columnId == 13) return "the median width and height of this object (approximate)";
+	if (columnId == 14) return "95% of the objects have a width and height smaller than this (approximate)";
 
 	// rows are 0-based, columns are 1-based
 	if (rowNumber >= 0 and rowNumber < (int)m.size())
@@ -177,7 +242,7 @@ void dm::DMStatsWnd::paintCell(Graphics & g, int rowNumber, int columnId, int wi
 	if (rowNumber < 0				or
 		rowNumber >= (int)m.size()	or
 		columnId < 1				or
-		columnId > 11				)
+		columnId > 14				)
 	{
 		// rows are 0-based, columns are 1-based
 		return;
@@ -197,6 +262,9 @@ void dm::DMStatsWnd::paintCell(Graphics & g, int rowNumber, int columnId, int wi
 	 *		9: SD height
 	 *		10: minimum number of marks per image
 	 *		11: maximum number of marks per image
+	 *		12: 5th percentile size
+	 *		13: median size
+	 *		14: 95th percentile size
 	 */
 	std::stringstream ss;
 	ss << std::fixed << std::setprecision(2);
@@ -206,7 +274,7 @@ void dm::DMStatsWnd::paintCell(Graphics & g, int rowNumber, int columnId, int wi
 		case 1: ss << rowNumber;										break;
 		case 2: ss << content.names.at(rowNumber);						break;
 		case 3: ss << s.count;											break;
-		case 4: ss << s.filenames.size();								break;
+		case 4: ss << s.number_of_images;								break;
 		case 5: ss << s.min_size.width << " x " << s.min_size.height;	break;
 		case 6: ss << s.avg_w << " x " << s.avg_h;						break;
 		case 7: ss << s.max_size.width << " x " << s.max_size.height;	break;
@@ -214,6 +282,9 @@ void dm::DMStatsWnd::paintCell(Graphics & g, int rowNumber, int columnId, int wi
 		case 9: ss << s.standard_deviation_height;						break;
 		case 10: ss << s.min_number_of_marks_per_image;					break;
 		case 11: ss << s.max_number_of_marks_per_image;					break;
+		case 12: ss << s.p5_size.width << " x " << s.p5_size.height;	break;
+		case 13: ss << s.p50_size.width << " x " << s.p50_size.height;	break;
+		case 14: ss << s.p95_size.width << " x " << s.p95_size.height;	break;
 	}
 
 	// draw the text and the right-hand-side dividing line between cells
@@ -7,6 +7,9 @@
 
 namespace dm
 {
+	/** Statistics for a single class.  Each thread in @ref DMContentStatistics gathers its own instance, and they are then
+	 * combined with @ref merge().
+	 */
 	struct Stats
 	{
 		size_t class_idx;
@@ -15,8 +18,8 @@ namespace dm
 		/// The total number of times this class shows up across all images.
 		size_t count;
 
-		/// The set of all filenames where this class shows up.
-		dm::SStr filenames;
+		/// The number of images where this class shows up.
+		size_t number_of_images;
 
 		/// The smallest area, in pixels.  @see @ref min_size
 		int min_area;
@@ -30,12 +33,18 @@ namespace dm
 		/// The size that corresponds to the largest area.  @see @ref max_area
 		cv::Size max_size;
 
-		/// The sum of widths, heights, and area which is then used to calculate the averages.
-		int sum_w;
-		int sum_h;
-		int sum_a;
+		/// Mean and variance of the widths, heights, and area.  @{
+		RunningStats width;
+		RunningStats height;
+		RunningStats area;
+		/// @}
+
+		/// Approximate distribution of the widths and heights, used to calculate the percentiles.  @{
+		QuantileSketch width_sketch;
+		QuantileSketch height_sketch;
+		/// @}
 
-		/// The averages of widths, heights and area as calculated from @ref sum_w, @ref sum_h, and @ref sum_a.
+		/// The averages of widths, heights and area as calculated from @ref width, @ref height, and @ref area.
 		double avg_w;
 		double avg_h;
 		double avg_a;
@@ -43,14 +52,15 @@ namespace dm
 		double standard_deviation_width;
 		double standard_deviation_height;
 
+		/// The 5th percentile, median, and 95th percentile of widths and heights (approximate).  @{
+		cv::Size p5_size;
+		cv::Size p50_size;
+		cv::Size p95_size;
+		/// @}
+
 		size_t min_number_of_marks_per_image;
 		size_t max_number_of_marks_per_image;
 
-		/// Keep track of all widths and all heights so we can calculate standard deviations.  @{
-		std::map<int, size_t> width_counts;
-		std::map<int, size_t> height_counts;
-		/// @}
-
 		std::string min_filename;
 		std::string max_filename;
 
@@ -62,16 +72,13 @@ namespace dm
 			name						= "?";
 			class_idx					= 0;
 			count						= 0;
+			number_of_images			= 0;
 			standard_deviation_width	= 0.0;
 			standard_deviation_height	= 0.0;
 
 			min_area = INT_MAX;
 			max_area = INT_MIN;
 
-			sum_w = 0;
-			sum_h = 0;
-			sum_a = 0;
-
 			avg_w = 0.0;
 			avg_h = 0.0;
 			avg_a = 0.0;
@@ -79,6 +86,12 @@ namespace dm
 			min_number_of_marks_per_image = 0.0;
 			max_number_of_marks_per_image = 0.0;
 		}
+
+		/// Combine the stats gathered from a different set of images into this object.
+		Stats & merge(const Stats & rhs);
+
+		/// Calculate the averages, standard deviations, and percentiles once all the marks have been added.
+		Stats & finalize();
 	};
 
 	/// Map where the key is the class id and the value is the full stats for that key.
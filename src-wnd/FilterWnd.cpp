@@ -1,8 +1,6 @@
 // DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
 
 #include "DarkMark.hpp"
-#include "json.hpp"
-using json = nlohmann::json;
 
 
 class ButtonSelection : public ButtonPropertyComponent
@@ -252,7 +250,7 @@ void dm::FilterWnd::buttonClicked(Button * button)
 
 	if (button == &ok_button or button == &apply_button)
 	{
-		content.scrollfield.field = cv::Mat(); // force the scrollfield to be recalculated
+		// the sort order is reset below which causes the scrollfield to be rebuilt using the existing rows
 		content.image_filenames = filtered_image_filenames;
 		content.load_image(0);
 		content.sort_order = ESort::kInvalid; // force the full sort logic to run
@@ -472,7 +470,9 @@ void dm::FilterWnd::apply_filters_on_thread()
 
 				// if this is not annotated, then keep it and move to the next image
 				const auto json_file = File(fn).withFileExtension(".json");
-				if (json_file.existsAsFile() == false)
+				last_accessed_filename = json_file.getFullPathName().toStdString();
+				const AnnotationSummary summary = content.annotation_index.get(json_file);
+				if (summary.exists == false)
 				{
 					v.push_back(fn);
 					continue;
@@ -480,10 +480,12 @@ void dm::FilterWnd::apply_filters_on_thread()
 
 				// if we get here then we know we have some sort of annotation
 
-				last_accessed_filename = json_file.getFullPathName().toStdString();
-				auto root = json::parse(json_file.loadFileAsString().toStdString());
+				if (summary.is_valid == false)
+				{
+					throw std::runtime_error(summary.error);
+				}
 
-				const time_t timestamp = root.value("timestamp", 0);
+				const time_t timestamp = summary.timestamp;
 				if (timestamp >= timestamp_limit)
 				{
 					v.push_back(fn);
@@ -521,32 +523,30 @@ void dm::FilterWnd::apply_filters_on_thread()
 
 				// if this is not annotated, then keep it and move to the next image
 				const auto json_file = File(fn).withFileExtension(".json");
-				if (json_file.existsAsFile() == false)
+				last_accessed_filename = json_file.getFullPathName().toStdString();
+				const AnnotationSummary summary = content.annotation_index.get(json_file);
+				if (summary.exists == false)
 				{
 					v.push_back(fn);
 					continue;
 				}
 
-				last_accessed_filename = json_file.getFullPathName().toStdString();
-				auto root = json::parse(json_file.loadFileAsString().toStdString());
+				if (summary.is_valid == false)
+				{
+					throw std::runtime_error(summary.error);
+				}
 
 				// if this is a negative sample, then keep it and move to the next image
-				if (root.value("completely_empty", false))
+				if (summary.completely_empty)
 				{
 					v.push_back(fn);
 					continue;
 				}
 
 				// otherwise, look through the annotations to see if it includes any of the classes we want
-				for (const auto & j : root["mark"])
+				for (const auto & m : summary.marks)
 				{
-					if (worker_thread_needs_to_end)
-					{
-						Log("cancelling out of worker thread while filtering classes (reading marks)");
-						return;
-					}
-
-					if (class_ids.count(j["class_idx"]) > 0)
+					if (class_ids.count(m.class_idx) > 0)
 					{
 						v.push_back(fn);
 						break;
@@ -558,6 +558,8 @@ void dm::FilterWnd::apply_filters_on_thread()
 			v.swap(image_filenames);
 		}
 
+		content.annotation_index.save();
+
 		if (worker_thread_needs_to_end)
 		{
 			Log("cancelling out of worker thread (bottom of function)");
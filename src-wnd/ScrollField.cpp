@@ -1,15 +1,15 @@
 // DarkMark (C) 2019-2023 Stephane Charette <stephanecharette@gmail.com>
 
 #include "DarkMark.hpp"
-#include "json.hpp"
-using json = nlohmann::json;
+#include <numeric>
 
 
 dm::ScrollField::ScrollField(DMContent & c) :
 	CrosshairComponent(c),
 	Thread("scrollfield loading thread"),
 	content(c),
-	line_width(0),
+	words_per_row(0),
+	field_number_of_classes(0),
 	triangle_size(cfg().get_int("scrollfield_marker_size"))
 {
 	setName("ScrollField");
@@ -34,11 +34,16 @@ dm::ScrollField::~ScrollField()
 }
 
 
-void dm::ScrollField::rebuild_entire_field_on_thread()
+void dm::ScrollField::rebuild_entire_field_on_thread(const bool reuse_existing_rows)
 {
 	if (content.images_are_loading == false and content.scrollfield_width > 0 and isThreadRunning() == false)
 	{
-		field			= cv::Mat();
+		if (reuse_existing_rows == false)
+		{
+			rows.clear();
+			row_classes.clear();
+			field_filenames.clear();
+		}
 		resized_image	= cv::Mat();
 		cached_image	= juce::Image();
 		map_idx_imagesets.clear();
@@ -56,7 +61,15 @@ void dm::ScrollField::run()
 {
 	Log("ScrollField: running thread");
 
-	field			= cv::Mat();
+	// remember the previous field so the rows can be re-used
+	std::vector<ERow> previous_rows;
+	std::vector<uint64_t> previous_row_classes;
+	VStr previous_filenames;
+	const size_t previous_words_per_row = words_per_row;
+	previous_rows.swap(rows);
+	previous_row_classes.swap(row_classes);
+	previous_filenames.swap(field_filenames);
+
 	resized_image	= cv::Mat();
 	cached_image	= juce::Image();
 	map_idx_imagesets.clear();
@@ -90,22 +103,82 @@ void dm::ScrollField::run()
 		return;
 	}
 
-	Log("Scrollfield: creating a new image, 200x" + std::to_string(number_of_images) + ", for " + std::to_string(number_of_classes) + " classes");
-	field = cv::Mat(number_of_images, 200, CV_8UC3, {0.0, 0.0, 0.0});
-	line_width = static_cast<double>(field.cols) / static_cast<double>(number_of_classes);
-	Log("Scrollfield: size of field is " + std::to_string(field.cols) + "x" + std::to_string(field.rows) + ", and the width of each line is " + std::to_string(line_width) + " pixels");
+	// each row is a bitset of the classes in that image, so the memory needed is proportional to the number of classes
+	words_per_row = (number_of_classes + 63) / 64;
+	rows.assign(number_of_images, ERow::kMissing);
+	row_classes.assign(number_of_images * words_per_row, 0);
+	Log("Scrollfield: creating " + std::to_string(number_of_images) + " rows for " + std::to_string(number_of_classes) + " classes (" + std::to_string(words_per_row * sizeof(uint64_t) + sizeof(ERow)) + " bytes per row)");
 
-	for (size_t idx = 0; idx < number_of_images; idx ++)
+	// images which were in the previous field only need to have their row copied to the new location
+	std::vector<size_t> rows_to_build;
+	if (previous_rows.empty() == false and field_number_of_classes == number_of_classes and previous_words_per_row == words_per_row and previous_rows.size() == previous_filenames.size())
 	{
-		if (threadShouldExit() or content.scrollfield_width < 1)
+		std::unordered_map<std::string, size_t> previous_idx;
+		previous_idx.reserve(previous_filenames.size());
+		for (size_t idx = 0; idx < previous_filenames.size(); idx ++)
 		{
-			Log("ScrollField: 1: thread has been cancelled (idx=" + std::to_string(idx) + ")");
-			field = cv::Mat();
-			break;
+			previous_idx[previous_filenames[idx]] = idx;
 		}
 
-		update_index(idx);
+		for (size_t idx = 0; idx < number_of_images; idx ++)
+		{
+			auto iter = previous_idx.find(content.image_filenames.at(idx));
+			if (iter == previous_idx.end())
+			{
+				rows_to_build.push_back(idx);
+			}
+			else
+			{
+				rows[idx] = previous_rows[iter->second];
+				std::copy_n(previous_row_classes.begin() + iter->second * words_per_row, words_per_row, row_classes.begin() + idx * words_per_row);
+			}
+		}
 	}
+	else
+	{
+		rows_to_build.resize(number_of_images);
+		std::iota(rows_to_build.begin(), rows_to_build.end(), 0);
+	}
+	previous_rows.clear();
+	previous_row_classes.clear();
+	previous_filenames.clear();
+	Log("ScrollField: re-used " + std::to_string(number_of_images - rows_to_build.size()) + " rows, need to create " + std::to_string(rows_to_build.size()) + " rows");
+
+	// each row is independent of the others, so the remaining rows can be created in parallel
+	std::atomic<size_t> next_row(0);
+	auto worker = [&]()
+	{
+		while (threadShouldExit() == false and content.scrollfield_width > 0)
+		{
+			const size_t idx = next_row ++;
+			if (idx >= rows_to_build.size())
+			{
+				break;
+			}
+
+			update_index(rows_to_build[idx]);
+		}
+	};
+
+	const size_t number_of_threads = std::min(rows_to_build.size(), static_cast<size_t>(std::max(1U, std::thread::hardware_concurrency())));
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < number_of_threads; idx ++)
+	{
+		threads.emplace_back(worker);
+	}
+	for (auto & t : threads)
+	{
+		t.join();
+	}
+
+	if (threadShouldExit() or content.scrollfield_width < 1)
+	{
+		Log("ScrollField: 1: thread has been cancelled (row=" + std::to_string(next_row) + ")");
+		rows.clear();
+		row_classes.clear();
+	}
+
+	content.annotation_index.save();
 
 	if (content.sort_order == dm::ESort::kAlphabetical)
 	{
@@ -119,7 +192,8 @@ void dm::ScrollField::run()
 			if (threadShouldExit() or content.scrollfield_width < 1)
 			{
 				Log("ScrollField: 2: thread has been cancelled (idx=" + std::to_string(idx) + ")");
-				field = cv::Mat();
+				rows.clear();
+				row_classes.clear();
 				break;
 			}
 
@@ -141,6 +215,12 @@ void dm::ScrollField::run()
 		}
 	}
 
+	if (rows.empty() == false)
+	{
+		field_filenames			= content.image_filenames;
+		field_number_of_classes	= number_of_classes;
+	}
+
 	need_to_rebuild_cache_image = true;
 	repaint();
 	content.resized();
@@ -151,9 +231,9 @@ void dm::ScrollField::run()
 
 void dm::ScrollField::update_index(const size_t idx)
 {
-	if (field.empty())
+	if (rows.empty())
 	{
-		// if we don't have an image to draw into, then return immediately
+		// if we don't have a field to update, then return immediately
 		return;
 	}
 
@@ -164,9 +244,9 @@ void dm::ScrollField::update_index(const size_t idx)
 		return;
 	}
 
-	if (static_cast<size_t>(field.rows) != content.image_filenames.size())
+	if (rows.size() != content.image_filenames.size())
 	{
-		Log("Scrollfield: height=" + std::to_string(field.rows) + " but we have " + std::to_string(content.image_filenames.size()) + " images");
+		Log("Scrollfield: height=" + std::to_string(rows.size()) + " but we have " + std::to_string(content.image_filenames.size()) + " images");
 		return;
 	}
 
@@ -178,66 +258,134 @@ void dm::ScrollField::update_index(const size_t idx)
 	const std::string & filename = content.image_filenames.at(idx);
 //	Log("ScrollField: updating for idx=" + std::to_string(idx));
 
-	File f = File(filename).withFileExtension(".json");
-	if (f.existsAsFile() == false)
+	uint64_t * classes = &row_classes[idx * words_per_row];
+	std::fill(classes, classes + words_per_row, 0);
+
+	const AnnotationSummary summary = content.annotation_index.get_for_image(filename);
+	if (summary.exists == false)
 	{
 		// nothing to show for this index, draw a blank line
-		cv::line(field, cv::Point(0, idx), cv::Point(field.cols, idx), {32.0, 32.0, 32.0}, 1, cv::LINE_4);
+		rows[idx] = ERow::kMissing;
 		return;
 	}
 
-	std::string msg;
-	try
+	if (summary.is_valid == false)
 	{
-		const std::string fn = f.getFullPathName().toStdString();
-		msg = "loading " + fn;
-		json root = json::parse(f.loadFileAsString().toStdString());
-		msg = "done " + msg;
+		// the .json file is broken somehow, so use a pure red line
+		Log("ScrollField: error detected at idx #" + std::to_string(idx) + " (" + filename + "): " + summary.error);
+		rows[idx] = ERow::kError;
+		return;
+	}
 
-		if (root.value("completely_empty", false) == true)
-		{
-			// create a fake entry so "empty" images show up as marked
-			root["mark"][0]["class_idx"] = content.empty_image_name_index;
-		}
+	const size_t number_of_classes = words_per_row * 64;
 
-		msg = "checking marks in " + fn;
-		if (root["mark"].size() == 0)
+	if (summary.completely_empty)
+	{
+		// create a fake entry so "empty" images show up as marked
+		rows[idx] = ERow::kMarks;
+		if (content.empty_image_name_index < number_of_classes)
 		{
-			// What is going on here?  Why do we have a JSON, but it isn't marked "empty" and doesn't have any marks?
-			Log("ScrollField: error detected while processing " + filename + " (no marks, but non-empty image?)");
-			cv::line(field, cv::Point(0, idx), cv::Point(field.cols, idx), {0.0, 0.0, 255.0}, 1, cv::LINE_4);
+			classes[content.empty_image_name_index / 64] |= (uint64_t(1) << (content.empty_image_name_index % 64));
 		}
-		else
+	}
+	else if (summary.marks.empty())
+	{
+		// What is going on here?  Why do we have a JSON, but it isn't marked "empty" and doesn't have any marks?
+		Log("ScrollField: error detected while processing " + filename + " (no marks, but non-empty image?)");
+		rows[idx] = ERow::kError;
+	}
+	else
+	{
+		rows[idx] = ERow::kMarks;
+		for (const auto & m : summary.marks)
 		{
-			msg = "drawing scrollfield line for " + fn;
-			cv::line(field, cv::Point(0, idx), cv::Point(field.cols, idx), {0.0, 0.0, 0.0}, 1, cv::LINE_4); // start with a black background
-			for (auto m : root["mark"])
+			const size_t class_idx = m.class_idx;
+			if (class_idx < number_of_classes)
 			{
-				const int class_idx = m["class_idx"];
-				const cv::Point p1(line_width * class_idx, idx);
-				const cv::Point p2 = p1 + cv::Point(line_width, 0);
-				msg = "drawing scrollfield line (class #" + std::to_string(class_idx) + ") for " + fn;
-				cv::line(field, p1, p2, content.annotation_colours.at(class_idx % content.annotation_colours.size()), 1, cv::LINE_4);
+				classes[class_idx / 64] |= (uint64_t(1) << (class_idx % 64));
 			}
-			msg = "done " + msg;
 		}
 	}
-	catch (const std::exception & e)
+
+	return;
+}
+
+
+cv::Mat dm::ScrollField::rasterize(const cv::Size & size) const
+{
+	//						blue   green red
+	const cv::Scalar grey	(32.0, 32.0, 32.0);
+	const cv::Scalar red	(0.0, 0.0, 255.0);
+
+	cv::Mat mat(size, CV_8UC3, {0.0, 0.0, 0.0});
+
+	const size_t number_of_rows		= rows.size();
+	const size_t number_of_classes	= field_number_of_classes;
+	if (number_of_rows == 0 or number_of_classes == 0 or words_per_row == 0 or size.area() == 0)
 	{
-		// the .json file is broken somehow, so use a pure red line
-		Log("Scrollfield: msg: " + msg);
-		Log("ScrollField: error detected at idx #" + std::to_string(idx) + " (" + filename + "): " + e.what());
-		cv::line(field, cv::Point(0, idx), cv::Point(field.cols, idx), {0.0, 0.0, 255.0}, 1, cv::LINE_4);
+		return mat;
 	}
-	catch (...)
+
+	// the horizontal position where each class starts
+	std::vector<int> class_x(number_of_classes + 1);
+	for (size_t class_idx = 0; class_idx <= number_of_classes; class_idx ++)
 	{
-		// the .json file is broken somehow, so use a pure red line
-		Log("Scrollfield: msg: " + msg);
-		Log("ScrollField: error detected at idx #" + std::to_string(idx) + " (" + filename + ")");
-		cv::line(field, cv::Point(0, idx), cv::Point(field.cols, idx), {0.0, 0.0, 255.0}, 1, cv::LINE_4);
+		class_x[class_idx] = std::floor(static_cast<double>(class_idx) * size.width / number_of_classes);
 	}
 
-	return;
+	std::vector<uint64_t> classes(words_per_row);
+	for (int y = 0; y < size.height; y ++)
+	{
+		// determine which rows are covered by this line of pixels -- at least 1 row, and possibly many rows
+		const size_t first_row	= std::min(number_of_rows - 1, static_cast<size_t>(static_cast<double>(y) * number_of_rows / size.height));
+		const size_t last_row	= std::max(first_row + 1, std::min(number_of_rows, static_cast<size_t>(static_cast<double>(y + 1) * number_of_rows / size.height)));
+
+		// combine all the rows -- errors take precedence so they are never hidden by neighbouring images
+		bool has_error			= false;
+		bool has_annotations	= false;
+		std::fill(classes.begin(), classes.end(), 0);
+		for (size_t row_idx = first_row; row_idx < last_row; row_idx ++)
+		{
+			if (rows[row_idx] == ERow::kError)
+			{
+				has_error = true;
+				break;
+			}
+			if (rows[row_idx] == ERow::kMarks)
+			{
+				has_annotations = true;
+				const uint64_t * row_ptr = &row_classes[row_idx * words_per_row];
+				for (size_t word_idx = 0; word_idx < words_per_row; word_idx ++)
+				{
+					classes[word_idx] |= row_ptr[word_idx];
+				}
+			}
+		}
+
+		cv::Mat line = mat.row(y);
+		if (has_error)
+		{
+			line.setTo(red);
+		}
+		else if (has_annotations == false)
+		{
+			line.setTo(grey);
+		}
+		else
+		{
+			for (size_t class_idx = 0; class_idx < number_of_classes; class_idx ++)
+			{
+				if (classes[class_idx / 64] & (uint64_t(1) << (class_idx % 64)))
+				{
+					const int x1 = std::min(class_x[class_idx], size.width - 1);
+					const int x2 = std::max(x1 + 1, class_x[class_idx + 1]);
+					line.colRange(x1, x2).setTo(content.annotation_colours.at(class_idx % content.annotation_colours.size()));
+				}
+			}
+		}
+	}
+
+	return mat;
 }
 
 
@@ -367,7 +515,7 @@ void dm::ScrollField::rebuild_cache_image()
 	resized_image	= cv::Mat();
 	cached_image	= juce::Image();
 
-	if (field.empty())
+	if (rows.empty())
 	{
 		Log("ScrollField: starting thread to rebuild the image");
 		rebuild_entire_field_on_thread();
@@ -379,7 +527,7 @@ void dm::ScrollField::rebuild_cache_image()
 		const int w = getWidth();
 		const int h = getHeight();
 
-		cv::resize(field, resized_image, cv::Size(w, h));
+		resized_image = rasterize(cv::Size(w, h));
 
 		draw_triangles_at_image_sets();
 		draw_marker_at_current_image();
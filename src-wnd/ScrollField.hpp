@@ -7,15 +7,30 @@
 
 namespace dm
 {
+	/** The narrow vertical field on the right-hand side of the editor, showing which classes are used in each image.
+	 * The field is stored as one bitset of classes per image, and rasterized directly at the size of the window.
+	 */
 	class ScrollField final : public CrosshairComponent, public Thread
 	{
 		public:
 
+			/// What needs to be shown for a single image.
+			enum class ERow : uint8_t
+			{
+				kMissing,	///< The image doesn't have a .json file.
+				kError,		///< The .json file is invalid.
+				kMarks		///< The image is annotated, see @ref row_classes.
+			};
+
 			ScrollField(DMContent & c);
 
 			virtual ~ScrollField();
 
-			virtual void rebuild_entire_field_on_thread();
+			/** Start the secondary thread which creates the scrollfield.  When @p reuse_existing_rows is set, the rows from
+			 * the existing field are copied for images which haven't changed, such as when the images have only been sorted
+			 * or filtered.  Otherwise, every row is created again from the annotation index.
+			 */
+			virtual void rebuild_entire_field_on_thread(const bool reuse_existing_rows = false);
 
 			virtual void run() override;
 
@@ -29,19 +44,33 @@ namespace dm
 			virtual void jump_to_location(const MouseEvent & event, const bool full_load = false);
 
 			virtual void rebuild_cache_image();
+
+			/** Draw the field at the given size.  Each horizontal line of pixels combines all of the images it covers, so
+			 * this works the same way regardless of the number of images.
+			 */
+			cv::Mat rasterize(const cv::Size & size) const;
 			virtual void draw_triangles_at_image_sets();
 			virtual void draw_marker_at_current_image();
 
 			/// Link to the parent which manages the content.
 			DMContent & content;
 
-			/// The width of a single class "line" in the field.
-			double line_width;
+			/// One entry per image.  This is empty when the field needs to be rebuilt.
+			std::vector<ERow> rows;
+
+			/// The classes used in each image, with @ref words_per_row consecutive bits for each entry in @ref rows.
+			std::vector<uint64_t> row_classes;
+
+			/// The number of 64-bit words used for each row in @ref row_classes.
+			size_t words_per_row;
+
+			/// The image filename for each entry in @ref rows.  @see @ref rebuild_entire_field_on_thread()
+			VStr field_filenames;
 
-			/// The full-size scrollfield with all the markup from the .json files.
-			cv::Mat field;
+			/// The number of classes used to create @ref rows.
+			size_t field_number_of_classes;
 
-			/// The @ref field image resized to fit exactly within the window.
+			/// The field rasterized to fit exactly within the window.
 			cv::Mat resized_image;
 
 			/// Track at which index the image sets can be found so we can draw our little triangles.
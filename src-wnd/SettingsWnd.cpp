@@ -67,12 +67,26 @@ dm::SettingsWnd::SettingsWnd(dm::DMContent & c) :
 		peer->setIcon(DarkMarkLogo());
 	}
 
-	if (dmapp().darkhelp_nn)
+	bool darkhelp_loaded		= false;
+	float hierarchy_threshold	= 0.0f;
+	bool enable_tiles			= false;
+	if (true)
 	{
-		v_darkhelp_threshold							= std::round(100.0f * dmapp().darkhelp_nn->config.threshold);
-		v_darkhelp_hierchy_threshold					= std::round(100.0f * dmapp().darkhelp_nn->config.hierarchy_threshold);
-		v_darkhelp_non_maximal_suppression_threshold	= std::round(100.0f * dmapp().darkhelp_nn->config.non_maximal_suppression_threshold);
-		v_image_tiling									= dmapp().darkhelp_nn->config.enable_tiles;
+		std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
+		if (dmapp().darkhelp_nn)
+		{
+			darkhelp_loaded		= true;
+			hierarchy_threshold	= dmapp().darkhelp_nn->config.hierarchy_threshold;
+			enable_tiles		= dmapp().darkhelp_nn->config.enable_tiles;
+		}
+	}
+
+	if (darkhelp_loaded)
+	{
+		v_darkhelp_threshold							= std::round(100.0f * content.darknet_threshold);
+		v_darkhelp_hierchy_threshold					= std::round(100.0f * hierarchy_threshold);
+		v_darkhelp_non_maximal_suppression_threshold	= std::round(100.0f * content.darknet_nms_threshold);
+		v_image_tiling									= enable_tiles;
 	}
 	else
 	{
@@ -96,6 +110,9 @@ dm::SettingsWnd::SettingsWnd(dm::DMContent & c) :
 	v_snapping_enabled						= content.snapping_enabled;
 	v_snap_horizontal_tolerance				= content.snap_horizontal_tolerance;
 	v_snap_vertical_tolerance				= content.snap_vertical_tolerance;
+	v_prefetch_image_count					= content.prefetch_image_count;
+	v_prefetch_memory_budget_mb				= cfg().get_int("prefetch_memory_budget_mb");
+	v_predict_all_threads					= cfg().get_int("predict_all_threads");
 
 	v_darkhelp_threshold						.addListener(this);
 	v_darkhelp_hierchy_threshold				.addListener(this);
@@ -113,6 +130,9 @@ dm::SettingsWnd::SettingsWnd(dm::DMContent & c) :
 	v_snapping_enabled							.addListener(this);
 	v_snap_horizontal_tolerance					.addListener(this);
 	v_snap_vertical_tolerance					.addListener(this);
+	v_prefetch_image_count						.addListener(this);
+	v_prefetch_memory_budget_mb					.addListener(this);
+	v_predict_all_threads						.addListener(this);
 
 	Array<PropertyComponent*> properties;
 //	TextPropertyComponent		* t = nullptr;
@@ -197,8 +217,23 @@ dm::SettingsWnd::SettingsWnd(dm::DMContent & c) :
 	pp.addSection("black-and-white mode", properties);
 	properties.clear();
 
+	s = new SliderPropertyComponent(v_prefetch_image_count, "images to prefetch", 0.0, 10.0, 1.0);
+	s->setTooltip("The number of images before and after the current image which are loaded ahead of time on a secondary thread. Set to zero to disable prefetching. The default value is 3.");
+	properties.add(s);
+
+	s = new SliderPropertyComponent(v_prefetch_memory_budget_mb, "prefetch memory (MiB)", 0.0, 4096.0, 64.0);
+	s->setTooltip("The maximum amount of memory used to store prefetched images. Large images can use a lot of memory once they have been decoded. The default value is 512 MiB.");
+	properties.add(s);
+
+	s = new SliderPropertyComponent(v_predict_all_threads, "predict all threads", 0.0, 64.0, 1.0);
+	s->setTooltip("The number of worker threads used when predicting all images. Each thread loads a copy of the neural network, so this may need to be reduced when using a GPU with limited memory. Set to zero to use one thread per CPU core. The default value is zero.");
+	properties.add(s);
+
+	pp.addSection("performance", properties);
+	properties.clear();
+
 	auto r = dmapp().wnd->getBounds();
-	r = r.withSizeKeepingCentre(400, 520);
+	r = r.withSizeKeepingCentre(400, 580);
 	setBounds(r);
 
 	setVisible(true);
@@ -234,6 +269,9 @@ void dm::SettingsWnd::closeButtonPressed()
 	cfg().setValue("snapping_enabled"					, v_snapping_enabled							.getValue());
 	cfg().setValue("snap_horizontal_tolerance"			, v_snap_horizontal_tolerance					.getValue());
 	cfg().setValue("snap_vertical_tolerance"			, v_snap_vertical_tolerance						.getValue());
+	cfg().setValue("prefetch_image_count"				, v_prefetch_image_count						.getValue());
+	cfg().setValue("prefetch_memory_budget_mb"			, v_prefetch_memory_budget_mb					.getValue());
+	cfg().setValue("predict_all_threads"				, v_predict_all_threads							.getValue());
 
 	dmapp().settings_wnd.reset(nullptr);
 
@@ -286,13 +324,18 @@ void dm::SettingsWnd::buttonClicked(Button * button)
 
 void dm::SettingsWnd::valueChanged(Value & value)
 {
-	if (dmapp().darkhelp_nn)
+	if (true)
 	{
-		dmapp().darkhelp_nn->config.hierarchy_threshold					= static_cast<float>(v_darkhelp_hierchy_threshold					.getValue()) / 100.0f;
-		dmapp().darkhelp_nn->config.non_maximal_suppression_threshold	= static_cast<float>(v_darkhelp_non_maximal_suppression_threshold	.getValue()) / 100.0f;
-		dmapp().darkhelp_nn->config.threshold							= static_cast<float>(v_darkhelp_threshold							.getValue()) / 100.0f;
-		dmapp().darkhelp_nn->config.enable_tiles						= static_cast<bool>(v_image_tiling.getValue());
+		// this waits for any inference which is currently running on the prediction thread
+		std::lock_guard<std::mutex> lock(dmapp().darkhelp_nn_lock);
+		if (dmapp().darkhelp_nn)
+		{
+			dmapp().darkhelp_nn->config.hierarchy_threshold	= static_cast<float>(v_darkhelp_hierchy_threshold.getValue()) / 100.0f;
+			dmapp().darkhelp_nn->config.enable_tiles		= static_cast<bool>(v_image_tiling.getValue());
+		}
 	}
+	content.darknet_threshold					= static_cast<float>(v_darkhelp_threshold							.getValue()) / 100.0f;
+	content.darknet_nms_threshold				= static_cast<float>(v_darkhelp_non_maximal_suppression_threshold	.getValue()) / 100.0f;
 	content.scrollfield_width					= v_scrollfield_width					.getValue();
 	content.scrollfield.triangle_size			= v_scrollfield_marker_size				.getValue();
 	content.show_mouse_pointer					= v_show_mouse_pointer					.getValue();
@@ -303,6 +346,8 @@ void dm::SettingsWnd::valueChanged(Value & value)
 	content.snapping_enabled					= v_snapping_enabled					.getValue();
 	content.snap_horizontal_tolerance			= v_snap_horizontal_tolerance			.getValue();
 	content.snap_vertical_tolerance				= v_snap_vertical_tolerance				.getValue();
+	content.prefetch_image_count				= v_prefetch_image_count				.getValue();
+	content.image_prefetcher.set_memory_budget(static_cast<size_t>(static_cast<int>(v_prefetch_memory_budget_mb.getValue())) * 1024 * 1024);
 
 	startTimer(250); // request a callback -- in milliseconds -- at which point in time we'll fully reload the current image
 
@@ -38,6 +38,9 @@ namespace dm
 			Value v_snapping_enabled;
 			Value v_snap_horizontal_tolerance;
 			Value v_snap_vertical_tolerance;
+			Value v_prefetch_image_count;
+			Value v_prefetch_memory_budget_mb;
+			Value v_predict_all_threads;
 
 			DMContent & content;
 			Component canvas;